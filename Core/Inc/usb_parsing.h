@@ -11,6 +11,17 @@
 #ifndef USB_PARSING_H_
 #define USB_PARSING_H_
 
+#define USB_RX_BUFFER_SIZE	256	// Power of 2
+#define USB_TX_BUFFER_SIZE	256	// Power of 2
+#define USB_PARSING_CYCLES	0	// 1 - count CPU cycles of each command with the DWT cycle counter
+
 void USB_Parsing(void);
+void USB_ParsingReceive(const uint8_t *Buf, uint32_t Len);
+uint16_t USB_ParsingRxFree(void);
+uint8_t USB_ParsingRxInLine(void);
+uint32_t USB_ParsingGetOverflows(void);
+uint8_t USB_ParsingTransmit(const uint8_t *Buf, uint16_t Len);
+uint32_t USB_ParsingGetTxOverflows(void);
+uint32_t USB_ParsingGetCycles(uint32_t *Max);
 
 #endif /* USB_PARSING_H_ */
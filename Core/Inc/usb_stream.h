@@ -0,0 +1,60 @@
+/*
+ * usb_stream.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#ifndef USB_STREAM_H_
+#define USB_STREAM_H_
+
+//
+//	Binary frame streaming over USB CDC
+//
+//	Adalight:	'A' 'd' 'a' CountHi CountLo Checksum RGB...
+//				Count = number of LEDs - 1, Checksum = CountHi ^ CountLo ^ 0x55
+//	TPM2:		0xC9 0xDA SizeHi SizeLo RGB... 0x36
+//				Size = number of payload bytes
+//
+//	Delta:		0xC9 0xDE SizeHi SizeLo Records... 0x36
+//				TPM2 framing with own packet type. Records update the current pixel buffer
+//				from LED 0, one header byte each: TTnnnnnn, n + 1 = 1..64 pixels
+//				TT = 00 skip n + 1 unchanged pixels
+//				TT = 01 literal, n + 1 RGB triplets follow
+//				TT = 10 run, one RGB triplet follows, repeated n + 1 times
+//				TT = 11 reserved, frame is dropped
+//
+//	Payload goes into a queue slot, LEDs over WS2812B_LEDS are dropped.
+//	Bytes 'A' and 0xC9 start a frame between command lines.
+//
+//	Flow control:
+//	Every complete frame gets the next 16-bit sequence number. When notifications
+//	are on ('F1'), the device answers each frame put on the strip with
+//		0xC9 0xAA 0x00 0x02 SeqHi SeqLo 0x36
+//	once DMA has clocked out the last LED. A host keeping at most
+//	USB_STREAM_QUEUE_DEPTH frames unacknowledged never loses one.
+//	Frames received with a full queue are dropped and counted.
+//
+//	Direct pixel writes ('W' command) go to an edit frame taken from the newest
+//	frame. USB_StreamLatch ('W...,L') queues it behind the frames received so far,
+//	it then holds FX for USB_STREAM_TIMEOUT and is notified like a streamed frame.
+//	Writes without a latch are not shown.
+//
+#define USB_STREAM_TIMEOUT		1000	// ms without frames after which FX takes the strip back
+#ifndef USB_STREAM_QUEUE_DEPTH
+#define USB_STREAM_QUEUE_DEPTH	2		// 1 - lowest latency, 2 - next frame received during refresh
+#endif
+
+uint32_t USB_StreamReceive(const uint8_t *Buf, uint32_t Len);
+void USB_StreamTask(void);
+uint8_t* USB_StreamEdit(void);
+void USB_StreamLatch(void);
+void USB_StreamSetNotify(uint8_t Enable);
+uint8_t USB_StreamIsActive(void);
+uint32_t USB_StreamGetFrames(void);
+uint32_t USB_StreamGetErrors(void);
+uint32_t USB_StreamGetDropped(void);
+
+#endif /* USB_STREAM_H_ */
@@ -13,12 +13,46 @@
 
 // For 6 MHz SPI + DMA
 
-#define WS2812B_LEDS 35
+#ifndef WS2812B_LEDS
+#define WS2812B_LEDS 35	// Host tools may build for another strip length
+#endif
+
+// Virtual strip - logical diodes above are mapped to physical outputs
+#define WS2812B_OUTPUTS		1				// SPI outputs, only one is wired and encoded here
+#define WS2812B_OUTPUT_LEDS	WS2812B_LEDS	// Diodes chained on one output
+#define WS2812B_MAP_SIZE	4				// Ranges in the output map
+
+#define WS2812B_SPAN_CYCLES	0	// 1 - count CPU cycles of the HSV span setters with the DWT cycle counter
 
 typedef struct ws2812b_color {
 	uint8_t red, green, blue;
 } ws2812b_color;
 
+// Layer blend modes for WS2812B_CompositeSpan
+typedef enum {
+	WS2812B_BLEND_NORMAL,		// layer
+	WS2812B_BLEND_ADD,			// under + layer, saturated
+	WS2812B_BLEND_MAX,			// max(under, layer)
+	WS2812B_BLEND_MULTIPLY,		// under * layer / 256
+	WS2812B_BLEND_COUNT
+} ws2812b_blend;
+
+// Count logical diodes from Start sent on Output from its diode Offset, Reverse - wired end first
+typedef struct ws2812b_map {
+	uint16_t Start, Count;
+	uint8_t Output;
+	uint16_t Offset;
+	uint8_t Reverse;
+} ws2812b_map;
+
+// Output correction LUTs, generated into ws2812b_correction.c by Tools/gamma_gen
+typedef struct ws2812b_correction {
+	uint8_t red[256], green[256], blue[256];
+} ws2812b_correction;
+
+extern const uint8_t WS2812B_CorrectionProfiles;
+extern const ws2812b_correction WS2812B_Correction[];
+
 void WS2812B_Init(SPI_HandleTypeDef * spi_handler);
 void WS2812B_SetDiodeColor(int16_t diode_id, uint32_t color);
 void WS2812B_SetDiodeColorStruct(int16_t diode_id, ws2812b_color color);
@@ -27,6 +61,34 @@ void WS2812B_SetDiodeHSV(int16_t diode_id, uint16_t Hue, uint8_t Saturation, uin
 uint32_t WS2812B_GetColor(int16_t diode_id);
 uint8_t* WS2812B_GetPixels(void);
 void WS2812B_Refresh();
+void WS2812B_RefreshCpltCallback(void);
+
+// output map, returns 0 and keeps the old one if a range doesn't fit
+uint8_t WS2812B_SetMap(const ws2812b_map *Map, uint8_t Ranges);
+
+// output correction, 0 - none, 1..WS2812B_CorrectionProfiles - generated tables
+void WS2812B_SetCorrection(uint8_t Profile);
+uint8_t WS2812B_GetCorrection(void);
+
+// span functions
+void WS2812B_FillSpan(int16_t diode_id, uint16_t count, uint32_t color);
+void WS2812B_FillSpanGradient(int16_t diode_id, uint16_t count, uint32_t color1, uint32_t color2);
+void WS2812B_CopySpan(int16_t dst_id, int16_t src_id, uint16_t count);
+void WS2812B_CopySpanReverse(int16_t dst_id, int16_t src_id, uint16_t count);
+void WS2812B_FadeSpan(int16_t diode_id, uint16_t count, uint32_t target, uint8_t rateH, uint8_t rateL);
+void WS2812B_ScaleSpan(int16_t diode_id, uint16_t count, uint16_t scale);
+void WS2812B_BlurSpan(int16_t diode_id, uint16_t count);
+void WS2812B_GetSpan(int16_t diode_id, uint16_t count, ws2812b_color *dst);
+void WS2812B_SetSpan(int16_t diode_id, uint16_t count, const ws2812b_color *src);
+void WS2812B_BlendSpan(int16_t diode_id, uint16_t count, const ws2812b_color *a, const ws2812b_color *b, uint16_t amount);
+void WS2812B_CompositeSpan(int16_t diode_id, uint16_t count, const ws2812b_color *under, const ws2812b_color *layer, uint16_t scale, uint16_t alpha, ws2812b_blend blend);
+
+// color space conversion
+void WS2812B_HSVtoRGB(uint16_t Hue, uint8_t Saturation, uint8_t Brightness, uint8_t *R, uint8_t *G, uint8_t *B);
+void WS2812B_RGBtoHSV(uint8_t R, uint8_t G, uint8_t B, uint16_t *Hue, uint8_t *Saturation, uint8_t *Brightness);
+void WS2812B_SetSpanHSV(int16_t diode_id, uint16_t count, const uint16_t *Hue, const uint8_t *Saturation, const uint8_t *Brightness);
+void WS2812B_SetSpanHSVGradient(int16_t diode_id, uint16_t count, uint16_t HueStart, uint16_t HueStop, uint8_t Saturation, uint8_t Brightness);
+uint32_t WS2812B_GetSpanCycles(uint32_t *Max);
 
 // color correction
 uint8_t sine8(uint8_t x);
@@ -21,11 +21,24 @@
 #define DEFAULT_SPEED 	150
 #define SPEED_MAX 		65535
 
-#define MODE_COUNT 		58
-#define DEFAULT_MODE 	0
+#define DEFAULT_MODE 	0		// Index in ws2812b_fx_modes.h list
 
 #define FADE_RATE	2
 
+#define SYNC_PERIOD		1000	// ms, segments restart on this boundary of shared time
+#define SYNC_SLEW_MAX	100		// ms, smaller time corrections only shift schedules
+
+#define TRANSITION_SLOTS		2		// Segments which can crossfade at the same time
+#define TRANSITION_MAX_LEDS		WS2812B_LEDS	// Longest segment which can crossfade
+#define TRANSITION_FRAME		20		// ms between blended frames
+
+#define LAYER_SLOTS			2		// Segments with brightness, alpha or blend mode at the same time
+#define LAYER_MAX_LEDS		WS2812B_LEDS	// Longest layered segment
+
+#define PALETTE_SIZE	16
+#define PALETTE_COUNT	7		// Flash palettes + one user palette in RAM
+#define PALETTE_USER	(PALETTE_COUNT - 1)
+
 // some common colors
 #define RED        (uint32_t)0xFF0000
 #define GREEN      (uint32_t)0x00FF00
@@ -45,66 +58,29 @@ typedef enum {
 } FX_STATUS;
 
 typedef enum {
-FX_MODE_STATIC,
-FX_MODE_WHITE_TO_COLOR,
-FX_MODE_BLACK_TO_COLOR,
-FX_MODE_BLINK,
-FX_MODE_BLINK_RAINBOW,
-FX_MODE_STROBE,
-FX_MODE_STROBE_RAINBOW,
-FX_MODE_BREATH,
-FX_MODE_COLOR_WIPE,
-FX_MODE_COLOR_WIPE_INV,
-FX_MODE_COLOR_WIPE_REV,
-FX_MODE_COLOR_WIPE_REV_INV,
-FX_MODE_COLOR_WIPE_RANDOM,
-FX_MODE_COLOR_SWEEP_RANDOM,
-FX_MODE_RANDOM_COLOR,
-FX_MODE_SINGLE_DYNAMIC,
-FX_MODE_MULTI_DYNAMIC,
-FX_MODE_RAINBOW,
-FX_MODE_RAINBOW_CYCLE,
-FX_MODE_FADE,
-FX_MODE_SCAN,
-FX_MODE_DUAL_SCAN,
-FX_MODE_THEATER_CHASE,
-FX_MODE_THEATER_CHASE_RAINBOW,
-FX_MODE_RUNNING_LIGHTS,
-FX_MODE_TWINKLE,
-FX_MODE_TWINKLE_RANDOM,
-FX_MODE_TWINKLE_FADE,
-FX_MODE_TWINKLE_FADE_RANDOM,
-FX_MODE_SPARKLE,
-FX_MODE_FLASH_SPARKLE,
-FX_MODE_HYPER_SPARKLE,
-FX_MODE_MULTI_STROBE,
-FX_MODE_CHASE_WHITE,
-FX_MODE_CHASE_COLOR,
-FX_MODE_CHASE_RANDOM,
-FX_MODE_CHASE_RAINBOW,
-FX_MODE_CHASE_FLASH,
-FX_MODE_CHASE_FLASH_RANDOM,
-FX_MODE_CHASE_RAINBOW_WHITE,
-FX_MODE_CHASE_BLACKOUT,
-FX_MODE_CHASE_BLACKOUT_RAINBOW,
-FX_MODE_RUNNING_COLOR,
-FX_MODE_RUNNING_RED_BLUE,
-FX_MODE_RUNNING_RANDOM,
-FX_MODE_LARSON_SCANNER,
-FX_MODE_COMET,
-FX_MODE_FIREWORKS,
-FX_MODE_FIREWORKS_RANDOM,
-FX_MODE_MERRY_CHRISTMAS,
-FX_MODE_FIRE_FLICKER,
-FX_MODE_FIRE_FLICKER_SOFT,
-FX_MODE_FIRE_FLICKER_INTENSE,
-FX_MODE_CIRCUS_COMBUSTUS,
-FX_MODE_HALLOWEEN,
-FX_MODE_BICOLOR_CHASE,
-FX_MODE_TRICOLOR_CHASE,
-FX_MODE_ICU,
+#define FX_MODE(Name, Function) Name,
+#include "ws2812b_fx_modes.h"
+#undef FX_MODE
+MODE_COUNT
 } fx_mode;
 
+typedef enum {
+PALETTE_RAINBOW,
+PALETTE_HEAT,
+PALETTE_OCEAN,
+PALETTE_FOREST,
+PALETTE_LAVA,
+PALETTE_PARTY,
+} fx_palette;
+
+typedef enum {
+FX_LINK_NONE,		// Segment runs its own mode
+FX_LINK_COPY,		// Leader's pixels as they are
+FX_LINK_REVERSE,	// Leader's pixels end to start
+FX_LINK_MIRROR,		// Leader's start on both ends, meeting in the middle
+FX_LINK_COUNT
+} fx_link;
+
 FX_STATUS WS2812BFX_Init(uint16_t Segments);
 FX_STATUS WS2812BFX_SegmentIncrease(void);
 FX_STATUS WS2812BFX_SegmentDecrease(void);
@@ -113,6 +89,9 @@ uint8_t WS2812BFX_GetSegmentsQuantity(void);
 void WS2812BFX_SysTickCallback(void);
 void WS2812BFX_Callback(void);
 
+uint32_t WS2812BFX_GetTime(void);
+void WS2812BFX_SetTime(uint32_t Time);
+
 FX_STATUS WS2812BFX_Start(uint16_t Segment);
 FX_STATUS WS2812BFX_Stop(uint16_t Segment);
 FX_STATUS WS2812BFX_IsRunning(uint16_t Segment, uint8_t *Running);
@@ -121,6 +100,15 @@ FX_STATUS WS2812BFX_SetMode(uint16_t Segment, fx_mode Mode);
 FX_STATUS WS2812BFX_GetMode(uint16_t Segment, fx_mode *Mode);
 FX_STATUS WS2812BFX_NextMode(uint16_t Segment);
 FX_STATUS WS2812BFX_PrevMode(uint16_t Segment);
+FX_STATUS WS2812BFX_SetTransition(uint16_t Segment, uint16_t Time);
+FX_STATUS WS2812BFX_GetTransition(uint16_t Segment, uint16_t *Time);
+FX_STATUS WS2812BFX_SetLayer(uint16_t Segment, uint8_t Brightness, uint8_t Alpha, ws2812b_blend Blend);
+FX_STATUS WS2812BFX_GetLayer(uint16_t Segment, uint8_t *Brightness, uint8_t *Alpha, ws2812b_blend *Blend);
+FX_STATUS WS2812BFX_SetBrightness(uint16_t Segment, uint8_t Brightness);
+FX_STATUS WS2812BFX_SetAlpha(uint16_t Segment, uint8_t Alpha);
+FX_STATUS WS2812BFX_SetBlend(uint16_t Segment, ws2812b_blend Blend);
+FX_STATUS WS2812BFX_SetLink(uint16_t Segment, uint16_t Leader, fx_link Link);
+FX_STATUS WS2812BFX_GetLink(uint16_t Segment, uint16_t *Leader, fx_link *Link);
 FX_STATUS WS2812BFX_SetReverse(uint16_t Segment, uint8_t Reverse);
 FX_STATUS WS2812BFX_GetReverse(uint16_t Segment, uint8_t *Reverse);
 
@@ -139,9 +127,15 @@ FX_STATUS WS2812BFX_DecreaseSpeed(uint16_t Segment, uint16_t Speed);
 void WS2812BFX_SetColorStruct(uint8_t id, ws2812b_color c);
 void WS2812BFX_SetColorRGB(uint8_t id, uint8_t r, uint8_t g, uint8_t b);
 FX_STATUS WS2812BFX_GetColorRGB(uint8_t id, uint8_t *r, uint8_t *g, uint8_t *b);
+FX_STATUS WS2812BFX_GetSegmentColor(uint16_t Segment, uint8_t id, uint32_t *c);
 void WS2812BFX_SetColorHSV(uint8_t id, uint16_t h, uint8_t s, uint8_t v);
 void WS2812BFX_SetColor(uint8_t id, uint32_t c);
 
+FX_STATUS WS2812BFX_SetPalette(uint16_t Segment, uint8_t Palette);
+FX_STATUS WS2812BFX_GetPalette(uint16_t Segment, uint8_t *Palette);
+FX_STATUS WS2812BFX_SetUserPaletteEntry(uint8_t id, uint32_t c);
+uint32_t WS2812BFX_ColorFromPalette(uint8_t Palette, uint8_t index);
+
 FX_STATUS WS2812BFX_SetAll(uint16_t Segment, uint32_t c);
 FX_STATUS WS2812BFX_SetAllRGB(uint16_t Segment, uint8_t r, uint8_t g, uint8_t b);
 
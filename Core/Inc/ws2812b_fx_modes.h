@@ -0,0 +1,165 @@
+/*
+ * ws2812b_fx_modes.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Mode registry - fx_mode enum, MODE_COUNT and mMode[] table are all generated from this list.
+//	Included several times with different FX_MODE definitions, so the list has no include guard.
+//
+//	Set FX_HAS_<mode> to 0 to compile the mode out. Its function is no longer referenced and is
+//	dropped by the linker (-ffunction-sections -fdata-sections, --gc-sections as in the
+//	default project settings). Keep at least one mode. Code naming a mode which can be
+//	compiled out checks its FX_HAS_<mode> with #if.
+//
+//	Mode numbers follow the modes compiled in, so they change when one is left out. Numbers
+//	sent over USB, stored in a flash scene or in a sequence must match the firmware they are
+//	sent to.
+//
+//	Flash taken by every mode function in the built image, biggest last:
+//		Tools/mode_size/mode_size.sh Debug/WS2812B_C8.elf mode_size.txt
+//
+#ifndef WS2812B_FX_MODES_CONFIG_
+#define WS2812B_FX_MODES_CONFIG_
+
+#define FX_HAS_STATIC						1
+#define FX_HAS_WHITE_TO_COLOR				1
+#define FX_HAS_BLACK_TO_COLOR				1
+#define FX_HAS_BLINK						1
+#define FX_HAS_BLINK_RAINBOW				1
+#define FX_HAS_STROBE						1
+#define FX_HAS_STROBE_RAINBOW				1
+#define FX_HAS_BREATH						1
+#define FX_HAS_COLOR_WIPE					1
+#define FX_HAS_COLOR_WIPE_INV				1
+#define FX_HAS_COLOR_WIPE_REV				1
+#define FX_HAS_COLOR_WIPE_REV_INV			1
+#define FX_HAS_COLOR_WIPE_RANDOM			1
+#define FX_HAS_COLOR_SWEEP_RANDOM			1
+#define FX_HAS_RANDOM_COLOR					1
+#define FX_HAS_SINGLE_DYNAMIC				1
+#define FX_HAS_MULTI_DYNAMIC				1
+#define FX_HAS_RAINBOW						1
+#define FX_HAS_RAINBOW_CYCLE				1
+#define FX_HAS_FADE							1
+#define FX_HAS_SCAN							1
+#define FX_HAS_DUAL_SCAN					1
+#define FX_HAS_THEATER_CHASE				1
+#define FX_HAS_THEATER_CHASE_RAINBOW		1
+#define FX_HAS_RUNNING_LIGHTS				1
+#define FX_HAS_TWINKLE						1
+#define FX_HAS_TWINKLE_RANDOM				1
+#define FX_HAS_TWINKLE_FADE					1
+#define FX_HAS_TWINKLE_FADE_RANDOM			1
+#define FX_HAS_SPARKLE						1
+#define FX_HAS_FLASH_SPARKLE				1
+#define FX_HAS_HYPER_SPARKLE				1
+#define FX_HAS_MULTI_STROBE					1
+#define FX_HAS_CHASE_WHITE					1
+#define FX_HAS_CHASE_COLOR					1
+#define FX_HAS_CHASE_RANDOM					1
+#define FX_HAS_CHASE_RAINBOW				1
+#define FX_HAS_CHASE_FLASH					1
+#define FX_HAS_CHASE_FLASH_RANDOM			1
+#define FX_HAS_CHASE_RAINBOW_WHITE			1
+#define FX_HAS_CHASE_BLACKOUT				1
+#define FX_HAS_CHASE_BLACKOUT_RAINBOW		1
+#define FX_HAS_RUNNING_COLOR				1
+#define FX_HAS_RUNNING_RED_BLUE				1
+#define FX_HAS_RUNNING_RANDOM				1
+#define FX_HAS_LARSON_SCANNER				1
+#define FX_HAS_COMET						1
+#define FX_HAS_FIREWORKS					1
+#define FX_HAS_FIREWORKS_RANDOM				1
+#define FX_HAS_MERRY_CHRISTMAS				1
+#define FX_HAS_FIRE_FLICKER					1
+#define FX_HAS_FIRE_FLICKER_SOFT			1
+#define FX_HAS_FIRE_FLICKER_INTENSE			1
+#define FX_HAS_CIRCUS_COMBUSTUS				1
+#define FX_HAS_HALLOWEEN					1
+#define FX_HAS_BICOLOR_CHASE				1
+#define FX_HAS_TRICOLOR_CHASE				1
+#define FX_HAS_ICU							1
+#define FX_HAS_PALETTE_CYCLE				1
+#define FX_HAS_PALETTE_SOLID				1
+#define FX_HAS_PALETTE_TWINKLE				1
+#define FX_HAS_MATRIX_RAINBOW				1
+#define FX_HAS_MATRIX_RAIN					1
+#define FX_HAS_MATRIX_PLASMA				1
+
+#define FX_MODE_IF(Has, Name, Function)			FX_MODE_IF_(Has, Name, Function)	// Has expanded to 0 or 1 first
+#define FX_MODE_IF_(Has, Name, Function)		FX_MODE_IF_##Has(Name, Function)
+#define FX_MODE_IF_1(Name, Function)			FX_MODE(Name, Function)
+#define FX_MODE_IF_0(Name, Function)
+
+#endif /* WS2812B_FX_MODES_CONFIG_ */
+
+FX_MODE_IF(FX_HAS_STATIC,					FX_MODE_STATIC,						mode_static)
+FX_MODE_IF(FX_HAS_WHITE_TO_COLOR,			FX_MODE_WHITE_TO_COLOR,				mode_white_to_color)
+FX_MODE_IF(FX_HAS_BLACK_TO_COLOR,			FX_MODE_BLACK_TO_COLOR,				mode_black_to_color)
+FX_MODE_IF(FX_HAS_BLINK,					FX_MODE_BLINK,						mode_blink)
+FX_MODE_IF(FX_HAS_BLINK_RAINBOW,			FX_MODE_BLINK_RAINBOW,				mode_blink_rainbow)
+FX_MODE_IF(FX_HAS_STROBE,					FX_MODE_STROBE,						mode_strobe)
+FX_MODE_IF(FX_HAS_STROBE_RAINBOW,			FX_MODE_STROBE_RAINBOW,				mode_strobe_rainbow)
+FX_MODE_IF(FX_HAS_BREATH,					FX_MODE_BREATH,						mode_breath)
+FX_MODE_IF(FX_HAS_COLOR_WIPE,				FX_MODE_COLOR_WIPE,					mode_color_wipe)
+FX_MODE_IF(FX_HAS_COLOR_WIPE_INV,			FX_MODE_COLOR_WIPE_INV,				mode_color_wipe_inv)
+FX_MODE_IF(FX_HAS_COLOR_WIPE_REV,			FX_MODE_COLOR_WIPE_REV,				mode_color_wipe_rev)
+FX_MODE_IF(FX_HAS_COLOR_WIPE_REV_INV,		FX_MODE_COLOR_WIPE_REV_INV,			mode_color_wipe_rev_inv)
+FX_MODE_IF(FX_HAS_COLOR_WIPE_RANDOM,		FX_MODE_COLOR_WIPE_RANDOM,			mode_color_wipe_random)
+FX_MODE_IF(FX_HAS_COLOR_SWEEP_RANDOM,		FX_MODE_COLOR_SWEEP_RANDOM,			mode_color_sweep_random)
+FX_MODE_IF(FX_HAS_RANDOM_COLOR,				FX_MODE_RANDOM_COLOR,				mode_random_color)
+FX_MODE_IF(FX_HAS_SINGLE_DYNAMIC,			FX_MODE_SINGLE_DYNAMIC,				mode_single_dynamic)
+FX_MODE_IF(FX_HAS_MULTI_DYNAMIC,			FX_MODE_MULTI_DYNAMIC,				mode_multi_dynamic)
+FX_MODE_IF(FX_HAS_RAINBOW,					FX_MODE_RAINBOW,					mode_rainbow)
+FX_MODE_IF(FX_HAS_RAINBOW_CYCLE,			FX_MODE_RAINBOW_CYCLE,				mode_rainbow_cycle)
+FX_MODE_IF(FX_HAS_FADE,						FX_MODE_FADE,						mode_fade)
+FX_MODE_IF(FX_HAS_SCAN,						FX_MODE_SCAN,						mode_scan)
+FX_MODE_IF(FX_HAS_DUAL_SCAN,				FX_MODE_DUAL_SCAN,					mode_dual_scan)
+FX_MODE_IF(FX_HAS_THEATER_CHASE,			FX_MODE_THEATER_CHASE,				mode_theater_chase)
+FX_MODE_IF(FX_HAS_THEATER_CHASE_RAINBOW,	FX_MODE_THEATER_CHASE_RAINBOW,		mode_theater_chase_rainbow)
+FX_MODE_IF(FX_HAS_RUNNING_LIGHTS,			FX_MODE_RUNNING_LIGHTS,				mode_running_lights)
+FX_MODE_IF(FX_HAS_TWINKLE,					FX_MODE_TWINKLE,					mode_twinkle)
+FX_MODE_IF(FX_HAS_TWINKLE_RANDOM,			FX_MODE_TWINKLE_RANDOM,				mode_twinkle_random)
+FX_MODE_IF(FX_HAS_TWINKLE_FADE,				FX_MODE_TWINKLE_FADE,				mode_twinkle_fade)
+FX_MODE_IF(FX_HAS_TWINKLE_FADE_RANDOM,		FX_MODE_TWINKLE_FADE_RANDOM,		mode_twinkle_fade_random)
+FX_MODE_IF(FX_HAS_SPARKLE,					FX_MODE_SPARKLE,					mode_sparkle)
+FX_MODE_IF(FX_HAS_FLASH_SPARKLE,			FX_MODE_FLASH_SPARKLE,				mode_flash_sparkle)
+FX_MODE_IF(FX_HAS_HYPER_SPARKLE,			FX_MODE_HYPER_SPARKLE,				mode_hyper_sparkle)
+FX_MODE_IF(FX_HAS_MULTI_STROBE,				FX_MODE_MULTI_STROBE,				mode_multi_strobe)
+FX_MODE_IF(FX_HAS_CHASE_WHITE,				FX_MODE_CHASE_WHITE,				mode_chase_white)
+FX_MODE_IF(FX_HAS_CHASE_COLOR,				FX_MODE_CHASE_COLOR,				mode_chase_color)
+FX_MODE_IF(FX_HAS_CHASE_RANDOM,				FX_MODE_CHASE_RANDOM,				mode_chase_random)
+FX_MODE_IF(FX_HAS_CHASE_RAINBOW,			FX_MODE_CHASE_RAINBOW,				mode_chase_rainbow)
+FX_MODE_IF(FX_HAS_CHASE_FLASH,				FX_MODE_CHASE_FLASH,				mode_chase_flash)
+FX_MODE_IF(FX_HAS_CHASE_FLASH_RANDOM,		FX_MODE_CHASE_FLASH_RANDOM,			mode_chase_flash_random)
+FX_MODE_IF(FX_HAS_CHASE_RAINBOW_WHITE,		FX_MODE_CHASE_RAINBOW_WHITE,		mode_chase_rainbow_white)
+FX_MODE_IF(FX_HAS_CHASE_BLACKOUT,			FX_MODE_CHASE_BLACKOUT,				mode_chase_blackout)
+FX_MODE_IF(FX_HAS_CHASE_BLACKOUT_RAINBOW,	FX_MODE_CHASE_BLACKOUT_RAINBOW,		mode_chase_blackout_rainbow)
+FX_MODE_IF(FX_HAS_RUNNING_COLOR,			FX_MODE_RUNNING_COLOR,				mode_running_color)
+FX_MODE_IF(FX_HAS_RUNNING_RED_BLUE,			FX_MODE_RUNNING_RED_BLUE,			mode_running_red_blue)
+FX_MODE_IF(FX_HAS_RUNNING_RANDOM,			FX_MODE_RUNNING_RANDOM,				mode_running_random)
+FX_MODE_IF(FX_HAS_LARSON_SCANNER,			FX_MODE_LARSON_SCANNER,				mode_larson_scanner)
+FX_MODE_IF(FX_HAS_COMET,					FX_MODE_COMET,						mode_comet)
+FX_MODE_IF(FX_HAS_FIREWORKS,				FX_MODE_FIREWORKS,					mode_fireworks)
+FX_MODE_IF(FX_HAS_FIREWORKS_RANDOM,			FX_MODE_FIREWORKS_RANDOM,			mode_fireworks_random)
+FX_MODE_IF(FX_HAS_MERRY_CHRISTMAS,			FX_MODE_MERRY_CHRISTMAS,			mode_merry_christmas)
+FX_MODE_IF(FX_HAS_FIRE_FLICKER,				FX_MODE_FIRE_FLICKER,				mode_fire_flicker)
+FX_MODE_IF(FX_HAS_FIRE_FLICKER_SOFT,		FX_MODE_FIRE_FLICKER_SOFT,			mode_fire_flicker_soft)
+FX_MODE_IF(FX_HAS_FIRE_FLICKER_INTENSE,		FX_MODE_FIRE_FLICKER_INTENSE,		mode_fire_flicker_intense)
+FX_MODE_IF(FX_HAS_CIRCUS_COMBUSTUS,			FX_MODE_CIRCUS_COMBUSTUS,			mode_circus_combustus)
+FX_MODE_IF(FX_HAS_HALLOWEEN,				FX_MODE_HALLOWEEN,					mode_halloween)
+FX_MODE_IF(FX_HAS_BICOLOR_CHASE,			FX_MODE_BICOLOR_CHASE,				mode_bicolor_chase)
+FX_MODE_IF(FX_HAS_TRICOLOR_CHASE,			FX_MODE_TRICOLOR_CHASE,				mode_tricolor_chase)
+FX_MODE_IF(FX_HAS_ICU,						FX_MODE_ICU,						mode_icu)
+FX_MODE_IF(FX_HAS_PALETTE_CYCLE,			FX_MODE_PALETTE_CYCLE,				mode_palette_cycle)
+FX_MODE_IF(FX_HAS_PALETTE_SOLID,			FX_MODE_PALETTE_SOLID,				mode_palette_solid)
+FX_MODE_IF(FX_HAS_PALETTE_TWINKLE,			FX_MODE_PALETTE_TWINKLE,			mode_palette_twinkle)
+// Matrix modes draw on the whole 2D matrix area
+FX_MODE_IF(FX_HAS_MATRIX_RAINBOW,			FX_MODE_MATRIX_RAINBOW,				mode_matrix_rainbow)
+FX_MODE_IF(FX_HAS_MATRIX_RAIN,				FX_MODE_MATRIX_RAIN,				mode_matrix_rain)
+FX_MODE_IF(FX_HAS_MATRIX_PLASMA,			FX_MODE_MATRIX_PLASMA,				mode_matrix_plasma)
@@ -0,0 +1,59 @@
+/*
+ * ws2812b_matrix.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#ifndef WS2812B_MATRIX_H_
+#define WS2812B_MATRIX_H_
+
+//
+//	Physical matrix layout - as the strip is mounted
+//
+#define MATRIX_PHYS_WIDTH	7		// Diodes in one physical row
+#define MATRIX_PHYS_HEIGHT	5		// Physical rows
+#define MATRIX_OFFSET		0		// Index of the first matrix diode on the strip
+#define MATRIX_SERPENTINE	1		// Every odd row goes backwards
+
+//
+//	Logical view
+//
+#define MATRIX_ROTATION		0		// 0 - 0, 1 - 90, 2 - 180, 3 - 270 degrees clockwise
+#define MATRIX_MIRROR_X		0		// Mirror logical X axis
+#define MATRIX_MIRROR_Y		0		// Mirror logical Y axis
+
+#define MATRIX_MAX_SIZE		16		// Lookup table dimension limit
+#define MATRIX_NONE			0xFFFF	// No diode under (x, y)
+
+#if (MATRIX_ROTATION == 0) || (MATRIX_ROTATION == 2)
+#define MATRIX_WIDTH		MATRIX_PHYS_WIDTH
+#define MATRIX_HEIGHT		MATRIX_PHYS_HEIGHT
+#else
+#define MATRIX_WIDTH		MATRIX_PHYS_HEIGHT
+#define MATRIX_HEIGHT		MATRIX_PHYS_WIDTH
+#endif
+
+#if (MATRIX_PHYS_WIDTH > MATRIX_MAX_SIZE) || (MATRIX_PHYS_HEIGHT > MATRIX_MAX_SIZE)
+#error "Matrix is bigger than MATRIX_MAX_SIZE"
+#endif
+
+#if (MATRIX_OFFSET + (MATRIX_PHYS_WIDTH * MATRIX_PHYS_HEIGHT)) > WS2812B_LEDS
+#error "Matrix doesn't fit in WS2812B_LEDS"
+#endif
+
+uint16_t WS2812B_MatrixXY(uint8_t x, uint8_t y);
+void WS2812B_MatrixClip(uint16_t first, uint16_t last);
+void WS2812B_MatrixSetPixel(uint8_t x, uint8_t y, uint32_t color);
+uint32_t WS2812B_MatrixGetPixel(uint8_t x, uint8_t y);
+
+// 2D span functions
+void WS2812B_MatrixFillRow(uint8_t y, uint8_t x, uint8_t count, uint32_t color);
+void WS2812B_MatrixFillColumn(uint8_t x, uint8_t y, uint8_t count, uint32_t color);
+void WS2812B_MatrixFillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint32_t color);
+void WS2812B_MatrixCopyRow(uint8_t dst_y, uint8_t src_y);
+void WS2812B_MatrixCopyColumn(uint8_t dst_x, uint8_t src_x);
+
+#endif /* WS2812B_MATRIX_H_ */
@@ -0,0 +1,35 @@
+/*
+ * ws2812b_scene.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#ifndef WS2812B_SCENE_H_
+#define WS2812B_SCENE_H_
+
+//
+//	Scene - segments layout, modes, speeds, colors, flags - kept in internal flash.
+//
+//	Records are appended to a log over SCENE_FLASH_PAGES last pages, so a page is
+//	erased once per (page size / record size) saves. Newest valid record wins at boot.
+//	Keep the linker script FLASH length below SCENE_FLASH_START.
+//
+#define SCENE_FLASH_PAGES	2
+#define SCENE_FLASH_END		(FLASH_BASE + 64 * 1024)
+#define SCENE_FLASH_START	(SCENE_FLASH_END - SCENE_FLASH_PAGES * FLASH_PAGE_SIZE)
+
+#define SCENE_HEADER_SIZE	8
+#define SCENE_SEGMENT_SIZE	20
+#define SCENE_MAX_SIZE		(SCENE_HEADER_SIZE + 2 + WS2812B_LEDS * SCENE_SEGMENT_SIZE)
+
+uint16_t WS2812BFX_SceneSerialize(uint8_t *Buf, uint16_t Sequence);
+FX_STATUS WS2812BFX_SceneDeserialize(const uint8_t *Buf, uint16_t Length);
+
+FX_STATUS WS2812BFX_SceneSave(void);
+FX_STATUS WS2812BFX_SceneLoad(void);
+FX_STATUS WS2812BFX_SceneClear(void);
+
+#endif /* WS2812B_SCENE_H_ */
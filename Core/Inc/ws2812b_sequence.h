@@ -0,0 +1,58 @@
+/*
+ * ws2812b_sequence.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#ifndef WS2812B_SEQUENCE_H_
+#define WS2812B_SEQUENCE_H_
+
+//
+//	Timed show sequences run on the device
+//
+//	Program is a byte code, multi-byte operands little endian:
+//
+//	0x00	END								stop sequence
+//	0x01	MODE		seg mode			WS2812BFX_SetMode
+//	0x02	COLOR		id r g b			WS2812BFX_SetColorRGB, taken by next MODE/XFADE
+//	0x03	SPEED		seg speed16			WS2812BFX_SetSpeed
+//	0x04	WAIT		ms16				wait, counted from previous WAIT end - no drift
+//	0x05	REPEAT		count				repeat up to ENDREPEAT count times, 0 - forever
+//	0x06	ENDREPEAT
+//	0x07	XFADE		seg mode time16		crossfade to mode in time ms
+//	0x08	START		seg
+//	0x09	STOP		seg
+//
+//	Program is verified before start, so a running sequence never reads out of the slot.
+//
+#define SEQUENCE_SIZE		256		// Program slot in RAM
+#define SEQUENCE_DEPTH		4		// Nested REPEATs
+#define SEQUENCE_STEPS		32		// Max instructions per callback without WAIT
+
+typedef enum
+{
+	SEQ_END = 0,
+	SEQ_MODE,
+	SEQ_COLOR,
+	SEQ_SPEED,
+	SEQ_WAIT,
+	SEQ_REPEAT,
+	SEQ_ENDREPEAT,
+	SEQ_XFADE,
+	SEQ_START,
+	SEQ_STOP,
+	SEQ_OPCODE_COUNT
+} seq_opcode;
+
+FX_STATUS WS2812BFX_SequenceWrite(uint16_t Offset, const uint8_t *Code, uint16_t Length);
+FX_STATUS WS2812BFX_SequenceClear(void);
+FX_STATUS WS2812BFX_SequenceStart(void);
+void WS2812BFX_SequenceStop(void);
+uint8_t WS2812BFX_SequenceIsRunning(void);
+uint16_t WS2812BFX_SequenceGetLength(void);
+void WS2812BFX_SequenceCallback(void);
+
+#endif /* WS2812B_SEQUENCE_H_ */
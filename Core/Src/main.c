@@ -30,7 +30,10 @@
 #include <stdlib.h>
 #include "ws2812b.h"
 #include "ws2812b_fx.h"
+#include "ws2812b_scene.h"
+#include "ws2812b_sequence.h"
 #include "usb_parsing.h"
+#include "usb_stream.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -98,37 +101,56 @@ int main(void)
   /* USER CODE BEGIN 2 */
   WS2812B_Init(&hspi1);
 
-  WS2812BFX_Init(3);	// Start 3 segments
-
-  WS2812BFX_SetSpeed(0, 5000);	// Speed of segment 0
-  WS2812BFX_SetSpeed(1, 2000);	// Speed of segment 1
-  WS2812BFX_SetSpeed(2, 500);	// Speed of segment 2
-  WS2812BFX_SetColorRGB(0, 32,0,64);	// Set color 0
-  WS2812BFX_SetColorRGB(1, 32,0,0);		// Set color 1
-  WS2812BFX_SetColorRGB(2, 0,64,0);		// Set color 2
-  WS2812BFX_SetMode(0, FX_MODE_WHITE_TO_COLOR);	// Set mode segment 0
-
-  WS2812BFX_SetColorRGB(0, 16,64,0);
-  WS2812BFX_SetColorRGB(1, 0,32,64);
-  WS2812BFX_SetColorRGB(2, 64,0,0);
-  WS2812BFX_SetMode(1, FX_MODE_BLACK_TO_COLOR);	// Set mode segment 1
-
-  WS2812BFX_SetColorRGB(0, 16,64,0);
-  WS2812BFX_SetColorRGB(1, 0,32,64);
-  WS2812BFX_SetColorRGB(2, 64,0,0);
-  WS2812BFX_SetMode(2, FX_MODE_COLOR_WIPE); 	// Set mode segment 2
-
-  WS2812BFX_Start(0);	// Start segment 0
-  WS2812BFX_Start(1);	// Start segment 1
-  WS2812BFX_Start(2);	// Start segment 2
-  HAL_Delay(200);
+  if(WS2812BFX_SceneLoad() != FX_OK)	// Saved scene, defaults if there is none
+  {
+    WS2812BFX_Init(3);	// Start 3 segments
+
+    WS2812BFX_SetSpeed(0, 5000);	// Speed of segment 0
+    WS2812BFX_SetSpeed(1, 2000);	// Speed of segment 1
+    WS2812BFX_SetSpeed(2, 500);	// Speed of segment 2
+    WS2812BFX_SetColorRGB(0, 32,0,64);	// Set color 0
+    WS2812BFX_SetColorRGB(1, 32,0,0);		// Set color 1
+    WS2812BFX_SetColorRGB(2, 0,64,0);		// Set color 2
+#if FX_HAS_WHITE_TO_COLOR
+    WS2812BFX_SetMode(0, FX_MODE_WHITE_TO_COLOR);	// Set mode segment 0
+#else
+    WS2812BFX_SetMode(0, DEFAULT_MODE);	// Mode compiled out, first one in the list
+#endif
+
+    WS2812BFX_SetColorRGB(0, 16,64,0);
+    WS2812BFX_SetColorRGB(1, 0,32,64);
+    WS2812BFX_SetColorRGB(2, 64,0,0);
+#if FX_HAS_BLACK_TO_COLOR
+    WS2812BFX_SetMode(1, FX_MODE_BLACK_TO_COLOR);	// Set mode segment 1
+#else
+    WS2812BFX_SetMode(1, DEFAULT_MODE);
+#endif
+
+    WS2812BFX_SetColorRGB(0, 16,64,0);
+    WS2812BFX_SetColorRGB(1, 0,32,64);
+    WS2812BFX_SetColorRGB(2, 64,0,0);
+#if FX_HAS_COLOR_WIPE
+    WS2812BFX_SetMode(2, FX_MODE_COLOR_WIPE); 	// Set mode segment 2
+#else
+    WS2812BFX_SetMode(2, DEFAULT_MODE);
+#endif
+
+    WS2812BFX_Start(0);	// Start segment 0
+    WS2812BFX_Start(1);	// Start segment 1
+    WS2812BFX_Start(2);	// Start segment 2
+  }
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
   while (1)
   {
-	  WS2812BFX_Callback();	// FX effects calllback
+	  WS2812BFX_SequenceCallback();	// Show sequence steps
+
+	  if(!USB_StreamIsActive())
+		  WS2812BFX_Callback();	// FX effects calllback
+
+	  USB_StreamTask();	// Latch frames streamed over USB
 
 	  USB_Parsing();	// USB communication parsing
     /* USER CODE END WHILE */
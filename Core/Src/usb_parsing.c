@@ -10,304 +10,871 @@
 
 #include "stm32f1xx_hal.h"
 #include "usbd_cdc_if.h"
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "ws2812b.h"
 #include "ws2812b_fx.h"
 #include "usb_parsing.h"
+#include "usb_stream.h"
+#include "ws2812b_scene.h"
+#include "ws2812b_sequence.h"
 
-uint8_t USBDataRX[50];			// Array for receive USB messages
-uint8_t USBReceivedDataFlag;	// Received USB data flag
+#define USB_LINE_LENGTH	(WS2812B_LEDS * 6 + 16)	// Fits 'W' command with the whole strip in hex
+
+uint8_t USBDataRX[USB_LINE_LENGTH];	// Array for receive USB messages
 uint8_t USBDataTX[50]; 			// Array for transmission USB messages
 uint8_t USBDataLength; 			// USB message length
 
-void UnknownCommand(void)
+//
+//	RX ring buffer - single producer (CDC OUT ISR), single consumer (USB_Parsing)
+//	Indexes run free and are masked on access, so Head - Tail is the fill level.
+//
+static uint8_t RxBuffer[USB_RX_BUFFER_SIZE];
+static volatile uint16_t RxHead;
+static volatile uint16_t RxTail;
+static volatile uint32_t RxOverflows;
+static volatile uint8_t RxInLine;	// Last received byte was not a newline
+
+static uint16_t RxLineLength;	// Bytes collected in USBDataRX
+static uint8_t RxLineDiscard;	// Current line is too long - skip to the next newline
+
+uint16_t USB_ParsingRxFree(void)
 {
-	USBDataLength = sprintf((char*)USBDataTX, "Unknown command\n\r");
+	return USB_RX_BUFFER_SIZE - (uint16_t)(RxHead - RxTail);
 }
 
-void ColorControl(void)
+void USB_ParsingReceive(const uint8_t *Buf, uint32_t Len)
 {
-	char *buf;
-	int16_t Seg;
-	uint8_t Color[3];
+	uint16_t Head = RxHead;
 
-	if((buf = strtok((char*)USBDataRX+1, ","))) // Segment number
+	while(Len--)
 	{
-		Seg = atoi(buf);
-
-		for(uint8_t i = 0; i < 3; i++)
+		if((uint16_t)(Head - RxTail) >= USB_RX_BUFFER_SIZE)
 		{
-		  if((buf = strtok(NULL, ","))) // Speed
-		  {
-			  Color[i] = atoi(buf);
-		  }
-		  else
-		  {
-			  USBDataLength = sprintf((char*)USBDataTX, "Color command error\n\r");
-		  	  return;
-		  }
+			RxOverflows++;
+			continue;
 		}
-
-		WS2812BFX_SetColorRGB(Seg, Color[0], Color[1], Color[2]);
-		USBDataLength = sprintf((char*)USBDataTX, "ColorID:%d Value:%dR, %dG, %dB\n\r", Seg, Color[0], Color[1], Color[2]);
-		return;
+		RxInLine = (*Buf != '\n' && *Buf != '\r');
+		RxBuffer[Head & (USB_RX_BUFFER_SIZE - 1)] = *Buf++;
+		Head++;
 	}
-	USBDataLength = sprintf((char*)USBDataTX, "Color command error\n\r");
+	RxHead = Head;
 }
 
-void SpeedControl(void)
+//
+//	Binary frames may only start between command lines - hex payload of 'W' contains 'A'
+//
+uint8_t USB_ParsingRxInLine(void)
 {
-	char *buf;
-	int16_t Seg;
-	uint16_t Speed;
+	return RxInLine;
+}
 
-	if((buf = strtok((char*)USBDataRX+1, ","))) // Segment number
+uint32_t USB_ParsingGetOverflows(void)
+{
+	return RxOverflows;
+}
+
+//
+//	TX ring buffer, main loop only. The chunk in flight stays in the buffer until
+//	the IN endpoint is idle again, then the next one goes out from USB_Parsing.
+//
+static uint8_t TxBuffer[USB_TX_BUFFER_SIZE];
+static uint16_t TxHead;
+static uint16_t TxTail;
+static uint16_t TxInFlight;	// Bytes handed to CDC_Transmit_FS, 0 - nothing sent
+static volatile uint32_t TxOverflows;
+
+static void TxKick(void)
+{
+	if(TxInFlight)
 	{
-	  Seg = atoi(buf);
-
-	  if((buf = strtok(NULL, ","))) // Speed
-	  {
-		  if((Speed = atoi(buf)) > 0)
-		  {
-			  WS2812BFX_SetSpeed(Seg, Speed);
-			  USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Speed:%d\n\r", Seg, Speed);
-			  return;
-		  }
-	  }
+		if(CDC_TransmitBusy_FS())
+			return;
+		TxTail += TxInFlight;	// Host took the chunk
+		TxInFlight = 0;
 	}
-	USBDataLength = sprintf((char*)USBDataTX, "Speed command error\n\r");
+
+	uint16_t Tail = TxTail;
+	uint16_t Length = TxHead - Tail;
+	uint16_t Offset = Tail & (USB_TX_BUFFER_SIZE - 1);
+
+	if(!Length)
+		return;
+
+	if(Length > USB_TX_BUFFER_SIZE - Offset)	// Send up to the wrap, rest goes next time
+		Length = USB_TX_BUFFER_SIZE - Offset;
+
+	TxInFlight = Length;
+	if(USBD_OK != CDC_Transmit_FS(&TxBuffer[Offset], Length))
+		TxInFlight = 0;	// Retried on next USB_Parsing pass
 }
 
-void ModeControl(void)
+//
+//	Queues whole message or nothing. Returns 0 when there is no room.
+//
+uint8_t USB_ParsingTransmit(const uint8_t *Buf, uint16_t Len)
 {
-	char *buf;
-	int16_t Seg;
-	int16_t Mode;
+	uint16_t Head = TxHead;
 
-	buf = strtok((char*)USBDataRX+1, ","); // Segment number
-	Seg = atoi(buf);
+	if(Len > USB_TX_BUFFER_SIZE - (uint16_t)(Head - TxTail))
+		return 0;
 
-	if((buf = strtok(NULL, ",")))
+	while(Len--)
 	{
-	  if(buf[0] == 'S')
-	  {
-		  WS2812BFX_Start(Seg);
-		  USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Start\n\r", Seg);
-		  return;
-	  }
-	  else if(buf[0] == 'T')
-	  {
-		  WS2812BFX_Stop(Seg);
-		  USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Stop\n\r", Seg);
-		  return;
-	  }
-	  else  // Mode
-	  {
-		  if((Mode = atoi(buf)) > 0)
-		  {
-			  WS2812BFX_SetMode(Seg, Mode);
-
-			  USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Mode:%d\n\r", Seg, Mode);
-			  return;
-		  }
-	  }
+		TxBuffer[Head & (USB_TX_BUFFER_SIZE - 1)] = *Buf++;
+		Head++;
 	}
-	USBDataLength = sprintf((char*)USBDataTX, "mode command error\n\r");
+	TxHead = Head;
+
+	TxKick();
+	return 1;
+}
+
+uint32_t USB_ParsingGetTxOverflows(void)
+{
+	return TxOverflows;
+}
+
+//
+//	Command arguments
+//
+//	Tokens point into USBDataRX, nothing is copied or terminated.
+//	Cursor is NULL after the last token.
+//
+typedef struct {
+	const char *Start;
+	uint16_t Length;
+} usb_token;
+
+static uint8_t NextToken(const char **Cursor, usb_token *Token)
+{
+	const char *p = *Cursor;
+
+	if(!p) return 0;
+
+	Token->Start = p;
+	while(*p && *p != ',')
+		p++;
+	Token->Length = p - Token->Start;
+	*Cursor = (*p == ',') ? p + 1 : NULL;
+	return 1;
+}
+
+static uint8_t TokenIs(const usb_token *Token, const char *Text)
+{
+	return (Token->Length == strlen(Text)) && !memcmp(Token->Start, Text, Token->Length);
 }
 
-void SegmentsControl(void)
+//
+//	Decimal integer, optional '-'. Fails on empty token, any other character or value out of Min..Max.
+//
+static uint8_t TokenToInt(const usb_token *Token, int32_t Min, int32_t Max, int32_t *Value)
 {
-	int16_t Seg;
-	uint8_t mode_tmp;
-	if(USBDataRX[1] == '-')
+	const char *p = Token->Start;
+	const char *End = p + Token->Length;
+	uint8_t Negative = 0;
+	int32_t Result = 0;
+
+	if(p < End && *p == '-')
 	{
-		WS2812BFX_SegmentDecrease();
+		Negative = 1;
+		p++;
 	}
-	else if(USBDataRX[1] == '+')
+	if(p == End) return 0;
+
+	while(p < End)
 	{
-		WS2812BFX_SegmentIncrease();
-		WS2812BFX_SetMode(WS2812BFX_GetSegmentsQuantity() - 1, rand()%MODE_COUNT);
-		WS2812BFX_Start(WS2812BFX_GetSegmentsQuantity() - 1);
+		if(*p < '0' || *p > '9') return 0;
+		if(Result > (INT32_MAX - (*p - '0')) / 10) return 0;	// Would overflow
+		Result = Result * 10 + (*p++ - '0');
 	}
-	else if((Seg = atoi((char*)(USBDataRX+1))) > 0)
+	if(Negative) Result = -Result;
+	if(Result < Min || Result > Max) return 0;
+
+	*Value = Result;
+	return 1;
+}
+
+static uint8_t NextInt(const char **Cursor, int32_t Min, int32_t Max, int32_t *Value)
+{
+	usb_token Token;
+
+	return NextToken(Cursor, &Token) && TokenToInt(&Token, Min, Max, Value);
+}
+
+static uint8_t NextSegment(const char **Cursor, int32_t *Segment)
+{
+	return NextInt(Cursor, 0, WS2812BFX_GetSegmentsQuantity() - 1, Segment);
+}
+
+//
+//	Reply formatter - only %d (int) is supported, output is clipped to USBDataTX
+//
+static char* FormatInt(char *Out, char *End, int32_t Value)
+{
+	char Digits[10];
+	uint8_t Count = 0;
+	uint32_t Abs = (Value < 0) ? -(uint32_t)Value : (uint32_t)Value;
+
+	if(Value < 0 && Out < End)
+		*Out++ = '-';
+
+	do
 	{
-		WS2812BFX_Init(Seg);
+		Digits[Count++] = '0' + (Abs % 10);
+		Abs /= 10;
+	} while(Abs);
+
+	while(Count && Out < End)
+		*Out++ = Digits[--Count];
+
+	return Out;
+}
+
+static void Reply(const char *Format, ...)
+{
+	va_list Args;
+	char *Out = (char*)USBDataTX;
+	char *End = Out + sizeof(USBDataTX);
+
+	va_start(Args, Format);
+	while(*Format && Out < End)
+	{
+		if(Format[0] == '%' && Format[1] == 'd')
+		{
+			Out = FormatInt(Out, End, va_arg(Args, int));
+			Format += 2;
+		}
+		else
+			*Out++ = *Format++;
 	}
-	else
+	va_end(Args);
+
+	USBDataLength = Out - (char*)USBDataTX;
+}
+
+//
+//	Fixed reply, no formatting pass
+//
+static void ReplyText(const char *Text)
+{
+	size_t Length = strlen(Text);
+
+	if(Length > sizeof(USBDataTX))
+		Length = sizeof(USBDataTX);
+	memcpy(USBDataTX, Text, Length);
+	USBDataLength = Length;
+}
+
+void UnknownCommand(const char *Args)
+{
+	(void)Args;
+	ReplyText("Unknown command\n\r");
+}
+
+void ColorControl(const char *Args)
+{
+	int32_t Id;
+	int32_t Color[3];
+
+	if(NextInt(&Args, 0, NUM_COLORS - 1, &Id)
+		&& NextInt(&Args, 0, 255, &Color[0])
+		&& NextInt(&Args, 0, 255, &Color[1])
+		&& NextInt(&Args, 0, 255, &Color[2]))
 	{
-		USBDataLength = sprintf((char*)USBDataTX, "Segment command error\n\r");
+		WS2812BFX_SetColorRGB(Id, Color[0], Color[1], Color[2]);
+		Reply("ColorID:%d Value:%dR, %dG, %dB\n\r", Id, Color[0], Color[1], Color[2]);
 		return;
 	}
-	WS2812BFX_GetMode(WS2812BFX_GetSegmentsQuantity()-1, &mode_tmp);
-	USBDataLength = sprintf((char*)USBDataTX, "Segments:%d Last mode:%d\n\r", WS2812BFX_GetSegmentsQuantity(), mode_tmp);
+	ReplyText("Color command error\n\r");
 }
 
-void SegmentRangeControl(void)
+void SpeedControl(const char *Args)
 {
-	char *buf;
-	int16_t Seg;
-	int16_t Start;
-	int16_t End;
+	int32_t Seg;
+	int32_t Speed;
 
-	buf = strtok((char*)USBDataRX+1, ","); // Segment number
-	Seg = atoi(buf);
+	if(NextSegment(&Args, &Seg) && NextInt(&Args, 1, SPEED_MAX, &Speed))
+	{
+		WS2812BFX_SetSpeed(Seg, Speed);
+		Reply("Segment:%d Speed:%d\n\r", Seg, Speed);
+		return;
+	}
+	ReplyText("Speed command error\n\r");
+}
+
+void ModeControl(const char *Args)
+{
+	usb_token Token;
+	int32_t Seg;
+	int32_t Mode;
 
-	if((buf = strtok(NULL, ",")))
+	if(NextSegment(&Args, &Seg) && NextToken(&Args, &Token))
 	{
-		if(buf[0] == 'R')	// Range (Stanrt and Stop)
+		if(TokenIs(&Token, "S"))
+		{
+			WS2812BFX_Start(Seg);
+			Reply("Segment:%d Start\n\r", Seg);
+			return;
+		}
+		else if(TokenIs(&Token, "T"))
+		{
+			WS2812BFX_Stop(Seg);
+			Reply("Segment:%d Stop\n\r", Seg);
+			return;
+		}
+		else if(TokenToInt(&Token, 0, MODE_COUNT - 1, &Mode))
 		{
-			if((buf = strtok(NULL, ","))) // Speed
+			WS2812BFX_SetMode(Seg, Mode);
+			Reply("Segment:%d Mode:%d\n\r", Seg, Mode);
+			return;
+		}
+	}
+	ReplyText("mode command error\n\r");
+}
+
+void PaletteControl(const char *Args)
+{
+	usb_token Token;
+	int32_t Seg;
+	int32_t Palette;
+	int32_t Entry;
+	int32_t Color[3];
+
+	if(NextToken(&Args, &Token))
+	{
+		if(TokenIs(&Token, "U"))	// User palette entry
+		{
+			if(NextInt(&Args, 0, PALETTE_SIZE - 1, &Entry)
+				&& NextInt(&Args, 0, 255, &Color[0])
+				&& NextInt(&Args, 0, 255, &Color[1])
+				&& NextInt(&Args, 0, 255, &Color[2]))
 			{
-				if((Start = atoi(buf)) > 0)
-				{
-					  if((buf = strtok(NULL, ","))) // Speed
-					  {
-							if((End = atoi(buf)) > 0)
-							{
-								WS2812BFX_SetSegmentSize(Seg, Start, End);
-								USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Range:%d - %d\n\r", Seg, Start, End);
-								return;
-							}
-							else
-								USBDataLength = sprintf((char*)USBDataTX, "Segment range End error\n\r");
-							return;
-					  }
-				}
-				else
-					USBDataLength = sprintf((char*)USBDataTX, "Segment range Start error\n\r");
+				WS2812BFX_SetUserPaletteEntry(Entry, ((uint32_t)Color[0]<<16)|(Color[1]<<8)|Color[2]);
+				Reply("User palette:%d Value:%dR, %dG, %dB\n\r", Entry, Color[0], Color[1], Color[2]);
 				return;
 			}
 		}
-		else if(buf[0] == 'S')	//Start
+		else if(TokenToInt(&Token, 0, WS2812BFX_GetSegmentsQuantity() - 1, &Seg)
+			&& NextInt(&Args, 0, PALETTE_COUNT - 1, &Palette))
+		{
+			WS2812BFX_SetPalette(Seg, Palette);
+			Reply("Segment:%d Palette:%d\n\r", Seg, Palette);
+			return;
+		}
+	}
+	ReplyText("Palette command error\n\r");
+}
+
+void LayerControl(const char *Args)
+{
+	int32_t Seg;
+	int32_t Brightness, Alpha, Blend;
+	uint8_t b, a;
+	ws2812b_blend m;
+
+	if(NextSegment(&Args, &Seg))
+	{
+		if(!Args)	// Read
+		{
+			WS2812BFX_GetLayer(Seg, &b, &a, &m);
+			Reply("Segment:%d Brightness:%d Alpha:%d Blend:%d\n\r", Seg, b, a, m);
+			return;
+		}
+		if(NextInt(&Args, 0, 255, &Brightness)
+			&& NextInt(&Args, 0, 255, &Alpha)
+			&& NextInt(&Args, 0, WS2812B_BLEND_COUNT - 1, &Blend)
+			&& !Args)
 		{
-			if(buf[1] == '+')
+			if(WS2812BFX_SetLayer(Seg, Brightness, Alpha, Blend) == FX_OK)
+				Reply("Segment:%d Brightness:%d Alpha:%d Blend:%d\n\r", Seg, Brightness, Alpha, Blend);
+			else
+				ReplyText("No free layer\n\r");
+			return;
+		}
+	}
+	ReplyText("Layer command error\n\r");
+}
+
+void LinkControl(const char *Args)
+{
+	int32_t Seg;
+	int32_t Leader, Link;
+	uint16_t l;
+	fx_link k;
+
+	if(NextSegment(&Args, &Seg))
+	{
+		if(!Args)	// Read
+		{
+			WS2812BFX_GetLink(Seg, &l, &k);
+			Reply("Segment:%d Leader:%d Link:%d\n\r", Seg, l, k);
+			return;
+		}
+		if(NextSegment(&Args, &Leader)
+			&& NextInt(&Args, 0, FX_LINK_COUNT - 1, &Link)
+			&& !Args)
+		{
+			if(WS2812BFX_SetLink(Seg, Leader, Link) == FX_OK)
+				Reply("Segment:%d Leader:%d Link:%d\n\r", Seg, Leader, Link);
+			else
+				ReplyText("Leader can't follow, follower can't lead\n\r");
+			return;
+		}
+	}
+	ReplyText("Link command error\n\r");
+}
+
+static int8_t HexDigit(char c)
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+//
+//	'Wi,RRGGBB...[,L]' - pixels from index i, hex into the stream edit frame.
+//	Run is clipped to the strip. 'L' queues the frame behind streamed ones, it holds FX
+//	like a streamed frame. Without 'L' the pixels wait for a later latch.
+//
+void PixelControl(const char *Args)
+{
+	usb_token Hex;
+	usb_token Latch;
+	uint8_t DoLatch = 0;
+	int32_t Start;
+	uint16_t Count;
+	uint8_t *Pixels;
+
+	if(NextInt(&Args, 0, WS2812B_LEDS - 1, &Start) && NextToken(&Args, &Hex)
+		&& Hex.Length && !(Hex.Length % 6))
+	{
+		if(NextToken(&Args, &Latch))
+		{
+			if(Args || !TokenIs(&Latch, "L"))
 			{
-				WS2812BFX_SegmentIncreaseStart(Seg);
-				USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Start increase\n\r", Seg);
+				ReplyText("Pixel command error\n\r");
 				return;
 			}
-			if(buf[1] == '-')
+			DoLatch = 1;
+		}
+
+		Count = Hex.Length / 6;
+		if(Count > WS2812B_LEDS - Start)
+			Count = WS2812B_LEDS - Start;
+
+		for(uint16_t i = 0; i < Count * 6; i++)	// Validate whole run before touching the buffer
+		{
+			if(HexDigit(Hex.Start[i]) < 0)
 			{
-				WS2812BFX_SegmentDecreaseStart(Seg);
-				USBDataLength = sprintf((char*)USBDataTX, "Segment:%d Start decrease\n\r", Seg);
+				ReplyText("Pixel command error\n\r");
 				return;
 			}
+		}
 
+		Pixels = USB_StreamEdit() + Start * 3;
+		for(uint16_t i = 0; i < Count * 6; i += 2)
+			*Pixels++ = (HexDigit(Hex.Start[i]) << 4) | HexDigit(Hex.Start[i + 1]);
+
+		if(DoLatch)
+			USB_StreamLatch();
+
+		Reply("Pixels:%d - %d\n\r", Start, Start + Count - 1);
+		return;
+	}
+	ReplyText("Pixel command error\n\r");
+}
+
+//
+//	'Fx' - frame presented notifications for streamed frames, 1 - on, 0 - off
+//
+void FlowControl(const char *Args)
+{
+	int32_t Enable;
+
+	if(NextInt(&Args, 0, 1, &Enable))
+	{
+		USB_StreamSetNotify(Enable);
+		Reply("Frame notify:%d Queue:%d\n\r", Enable, USB_STREAM_QUEUE_DEPTH);
+		return;
+	}
+	ReplyText("Flow command error\n\r");
+}
+
+//
+//	'ES' save scene to flash, 'EL' load it back, 'EC' clear - boot defaults
+//
+void SceneControl(const char *Args)
+{
+	usb_token Token;
+
+	if(NextToken(&Args, &Token) && !Args)
+	{
+		if(TokenIs(&Token, "S") && WS2812BFX_SceneSave() == FX_OK)
+		{
+			ReplyText("Scene saved\n\r");
+			return;
 		}
-		else if(buf[0] == 'E') //END
+		if(TokenIs(&Token, "L") && WS2812BFX_SceneLoad() == FX_OK)
 		{
-			if(buf[1] == '+')
+			Reply("Scene loaded, segments:%d\n\r", WS2812BFX_GetSegmentsQuantity());
+			return;
+		}
+		if(TokenIs(&Token, "C") && WS2812BFX_SceneClear() == FX_OK)
+		{
+			ReplyText("Scene cleared\n\r");
+			return;
+		}
+	}
+	ReplyText("Scene command error\n\r");
+}
+
+//
+//	'QW,x,hex..' write sequence code from byte x, 'QR' run, 'QS' stop, 'QC' clear
+//
+void SequenceControl(const char *Args)
+{
+	usb_token Token;
+	usb_token Hex;
+	int32_t Offset;
+
+	if(NextToken(&Args, &Token))
+	{
+		if(TokenIs(&Token, "W") && NextInt(&Args, 0, SEQUENCE_SIZE - 1, &Offset)
+			&& NextToken(&Args, &Hex) && !Args && Hex.Length && !(Hex.Length & 1))
+		{
+			for(uint16_t i = 0; i < Hex.Length; i++)
+			{
+				if(HexDigit(Hex.Start[i]) < 0)
+				{
+					ReplyText("Sequence command error\n\r");
+					return;
+				}
+			}
+			for(uint16_t i = 0; i < Hex.Length; i += 2)
 			{
-				WS2812BFX_SegmentIncreaseEnd(Seg);
-				USBDataLength = sprintf((char*)USBDataTX, "Segment:%d End increase\n\r", Seg);
+				uint8_t Byte = (HexDigit(Hex.Start[i]) << 4) | HexDigit(Hex.Start[i + 1]);
+				if(WS2812BFX_SequenceWrite(Offset + i / 2, &Byte, 1) != FX_OK)
+				{
+					ReplyText("Sequence too long\n\r");
+					return;
+				}
+			}
+			Reply("Sequence length:%d\n\r", WS2812BFX_SequenceGetLength());
+			return;
+		}
+		if(!Args && TokenIs(&Token, "R"))
+		{
+			if(WS2812BFX_SequenceStart() == FX_OK)
+				ReplyText("Sequence running\n\r");
+			else
+				ReplyText("Sequence invalid\n\r");
+			return;
+		}
+		if(!Args && TokenIs(&Token, "S"))
+		{
+			WS2812BFX_SequenceStop();
+			ReplyText("Sequence stopped\n\r");
+			return;
+		}
+		if(!Args && TokenIs(&Token, "C"))
+		{
+			WS2812BFX_SequenceClear();
+			ReplyText("Sequence cleared\n\r");
+			return;
+		}
+	}
+	ReplyText("Sequence command error\n\r");
+}
+
+//
+//	'Tx' set shared time to x ms, 'T' read it
+//	Send the same time to all boards to keep their effects in phase.
+//
+void TimeControl(const char *Args)
+{
+	int32_t Time;
+
+	if(!Args[0])
+	{
+		Reply("Time:%d\n\r", (int32_t)WS2812BFX_GetTime());
+		return;
+	}
+	if(NextInt(&Args, 0, INT32_MAX, &Time) && !Args)
+	{
+		WS2812BFX_SetTime(Time);
+		Reply("Time:%d synced\n\r", Time);
+		return;
+	}
+	ReplyText("Time command error\n\r");
+}
+
+void CorrectionControl(const char *Args)
+{
+	int32_t Profile;
+
+	if(!Args[0])
+	{
+		Reply("Correction:%d of %d\n\r", WS2812B_GetCorrection(), WS2812B_CorrectionProfiles);
+		return;
+	}
+	if(NextInt(&Args, 0, WS2812B_CorrectionProfiles, &Profile) && !Args)
+	{
+		WS2812B_SetCorrection(Profile);
+		Reply("Correction:%d\n\r", Profile);
+		return;
+	}
+	ReplyText("Correction command error\n\r");
+}
+
+void SegmentsControl(const char *Args)
+{
+	int32_t Count;
+	fx_mode mode_tmp;
+
+	if(Args[0] == '-' && !Args[1])
+	{
+		WS2812BFX_SegmentDecrease();
+	}
+	else if(Args[0] == '+' && !Args[1])
+	{
+		WS2812BFX_SegmentIncrease();
+		WS2812BFX_SetMode(WS2812BFX_GetSegmentsQuantity() - 1, rand()%MODE_COUNT);
+		WS2812BFX_Start(WS2812BFX_GetSegmentsQuantity() - 1);
+	}
+	else if(NextInt(&Args, 1, WS2812B_LEDS, &Count))
+	{
+		WS2812BFX_Init(Count);
+	}
+	else
+	{
+		ReplyText("Segment command error\n\r");
+		return;
+	}
+	WS2812BFX_GetMode(WS2812BFX_GetSegmentsQuantity()-1, &mode_tmp);
+	Reply("Segments:%d Last mode:%d\n\r", WS2812BFX_GetSegmentsQuantity(), mode_tmp);
+}
+
+void SegmentRangeControl(const char *Args)
+{
+	usb_token Token;
+	int32_t Seg;
+	int32_t Start;
+	int32_t End;
+
+	if(NextSegment(&Args, &Seg) && NextToken(&Args, &Token))
+	{
+		if(TokenIs(&Token, "R"))	// Range (Start and Stop)
+		{
+			if(!NextInt(&Args, 0, WS2812B_LEDS - 1, &Start))
+			{
+				ReplyText("Segment range Start error\n\r");
 				return;
 			}
-			if(buf[1] == '-')
+			if(!NextInt(&Args, Start, WS2812B_LEDS - 1, &End))
 			{
-				WS2812BFX_SegmentDecreaseEnd(Seg);
-				USBDataLength = sprintf((char*)USBDataTX, "Segment:%d End decrease\n\r", Seg);
+				ReplyText("Segment range End error\n\r");
 				return;
 			}
+			WS2812BFX_SetSegmentSize(Seg, Start, End);
+			Reply("Segment:%d Range:%d - %d\n\r", Seg, Start, End);
+			return;
+		}
+		else if(TokenIs(&Token, "S+"))
+		{
+			WS2812BFX_SegmentIncreaseStart(Seg);
+			Reply("Segment:%d Start increase\n\r", Seg);
+			return;
+		}
+		else if(TokenIs(&Token, "S-"))
+		{
+			WS2812BFX_SegmentDecreaseStart(Seg);
+			Reply("Segment:%d Start decrease\n\r", Seg);
+			return;
+		}
+		else if(TokenIs(&Token, "E+"))
+		{
+			WS2812BFX_SegmentIncreaseEnd(Seg);
+			Reply("Segment:%d End increase\n\r", Seg);
+			return;
+		}
+		else if(TokenIs(&Token, "E-"))
+		{
+			WS2812BFX_SegmentDecreaseEnd(Seg);
+			Reply("Segment:%d End decrease\n\r", Seg);
+			return;
 		}
 	}
-	USBDataLength = sprintf((char*)USBDataTX, "Segment range command error\n\r");
-}
-
-void PrintHelp(void)
-{
-
-	USBDataLength = sprintf((char*)USBDataTX, "\033[2J\033[0;0H");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "==============HELP=============\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "Change Segments quantity:\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Sx'  Set x segments(1 - LEDs/2)\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'S+' add one segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'S-' remove one segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "Change Segments length:\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Rx,S+' Increase start point x ");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Rx,S-' Decrease start point x ");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Rx,E+' Increase end point x ");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Rx,E-' Decrease end point x ");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Rx,R,y,z' Set start(y) and stop(z) po");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "int x segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "Change segment's mode:\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Mx,S' Start segment x\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Mx,T' Stop segment x\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Mx,y' Set y mode for x segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "Change segment's speed:\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Vx,y' Set y speed for x segment\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "Set color:\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "  'Cx,r,g,b' x - ColorID, rgb values\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
-	USBDataLength = sprintf((char*)USBDataTX, "===============================\n\r");
-	while(USBD_BUSY == CDC_Transmit_FS(USBDataTX, USBDataLength));
+	ReplyText("Segment range command error\n\r");
 }
 
-void USB_Parsing(void)
+static const char * const HelpText[] =
 {
-	if(USBReceivedDataFlag == 1)
-	{
-	  USBReceivedDataFlag = 0;
+	"\033[2J\033[0;0H",
+	"==============HELP=============\n\r",
+	"Change Segments quantity:\n\r",
+	"  'Sx'  Set x segments(1 - LEDs/2)\n\r",
+	"  'S+' add one segment\n\r",
+	"  'S-' remove one segment\n\r",
+	"Change Segments length:\n\r",
+	"  'Rx,S+' Increase start point x segment\n\r",
+	"  'Rx,S-' Decrease start point x segment\n\r",
+	"  'Rx,E+' Increase end point x segment\n\r",
+	"  'Rx,E-' Decrease end point x segment\n\r",
+	"  'Rx,R,y,z' Set start(y) and stop(z) point x segment\n\r",
+	"Change segment's mode:\n\r",
+	"  'Mx,S' Start segment x\n\r",
+	"  'Mx,T' Stop segment x\n\r",
+	"  'Mx,y' Set y mode for x segment\n\r",
+	"Change segment's speed:\n\r",
+	"  'Vx,y' Set y speed for x segment\n\r",
+	"Set color:\n\r",
+	"  'Cx,r,g,b' x - ColorID, rgb values\n\r",
+	"Set palette:\n\r",
+	"  'Px,y' Set y palette for x segment\n\r",
+	"  'PU,x,r,g,b' x - user palette entry\n\r",
+	"Segment layer:\n\r",
+	"  'Lx,b,a,m' brightness b, alpha a (0-255)\n\r",
+	"    blend m: 0 normal 1 add 2 max 3 multiply\n\r",
+	"  'Lx' read x segment layer\n\r",
+	"Segment link:\n\r",
+	"  'Kx,y,m' x copies y, m: 0 off 1 copy\n\r",
+	"    2 reverse 3 mirror\n\r",
+	"  'Kx' read x segment link\n\r",
+	"Set pixels:\n\r",
+	"  'Wx,RRGGBB..' hex pixels from LED x\n\r",
+	"  'Wx,RRGGBB..,L' same and show on strip\n\r",
+	"Streamed frames:\n\r",
+	"  'F1' / 'F0' frame presented notify on/off\n\r",
+	"Scene in flash:\n\r",
+	"  'ES' save, 'EL' load, 'EC' clear\n\r",
+	"Sequence:\n\r",
+	"  'QW,x,hex..' write code from byte x\n\r",
+	"  'QR' run, 'QS' stop, 'QC' clear\n\r",
+	"Sync:\n\r",
+	"  'Tx' set shared time x ms, 'T' read\n\r",
+	"Output correction:\n\r",
+	"  'Gx' gamma/white balance profile x, 0 - off\n\r",
+	"  'G' read profile\n\r",
+	"===============================\n\r",
+};
 
-	  switch (USBDataRX[0])
-	  {
-		case 'C':
-			ColorControl();
-			break;
+static uint8_t HelpLine = sizeof(HelpText) / sizeof(HelpText[0]);	// Next help line to queue, none pending
 
-		case 'V':
-			SpeedControl();
-			break;
+void PrintHelp(const char *Args)
+{
+	(void)Args;
+	HelpLine = 0;	// Queued from USB_Parsing as TX space frees up
+}
 
-		case 'M':
-			ModeControl();
+static void HelpTask(void)
+{
+	while(HelpLine < sizeof(HelpText) / sizeof(HelpText[0]))
+	{
+		if(!USB_ParsingTransmit((const uint8_t*)HelpText[HelpLine], strlen(HelpText[HelpLine])))
 			break;
+		HelpLine++;
+	}
+}
 
-		case 'S':
-			SegmentsControl();
-			break;
+//
+//	Handlers indexed by the command letter, no entry - unknown command
+//
+static void (* const CommandTable['Z' - 'A' + 1])(const char *Args) =
+{
+	['C' - 'A'] = ColorControl,
+	['V' - 'A'] = SpeedControl,
+	['M' - 'A'] = ModeControl,
+	['S' - 'A'] = SegmentsControl,
+	['R' - 'A'] = SegmentRangeControl,
+	['P' - 'A'] = PaletteControl,
+	['L' - 'A'] = LayerControl,
+	['K' - 'A'] = LinkControl,
+	['W' - 'A'] = PixelControl,
+	['F' - 'A'] = FlowControl,
+	['E' - 'A'] = SceneControl,
+	['Q' - 'A'] = SequenceControl,
+	['T' - 'A'] = TimeControl,
+	['G' - 'A'] = CorrectionControl,
+	['H' - 'A'] = PrintHelp,
+};
 
-		case 'R':
-			SegmentRangeControl();
-			break;
+//
+//	Handler and reply formatting, without the USB transfer. Read from a debugger or
+//	with USB_ParsingGetCycles, needs USB_PARSING_CYCLES 1.
+//
+static uint32_t CyclesLast, CyclesMax;
 
-		case 'H':
-			PrintHelp();
-			break;
-		default:
-			UnknownCommand();
-			break;
-	  }
+uint32_t USB_ParsingGetCycles(uint32_t *Max)
+{
+	if(Max)
+		*Max = CyclesMax;
+	return CyclesLast;
+}
+
+static void ParseCommand(void)
+{
+	void (*Handler)(const char *Args) = UnknownCommand;
+#if USB_PARSING_CYCLES
+	if(!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk))
+	{
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+	uint32_t Start = DWT->CYCCNT;
+#endif
+
+	uint8_t Index = USBDataRX[0] - 'A';	// Below 'A' wraps past the table
+	if(Index < sizeof(CommandTable) / sizeof(CommandTable[0]) && CommandTable[Index])
+		Handler = CommandTable[Index];
+
+	USBDataLength = 0;
+	Handler((const char*)USBDataRX + 1);
+#if USB_PARSING_CYCLES
+	CyclesLast = DWT->CYCCNT - Start;
+	if(CyclesLast > CyclesMax)
+		CyclesMax = CyclesLast;
+#endif
 
-	  CDC_Transmit_FS(USBDataTX, USBDataLength); // Send confirmation message
+	if(USBDataLength && !USB_ParsingTransmit(USBDataTX, USBDataLength)) // Send confirmation message
+		TxOverflows++;
+}
+
+void USB_Parsing(void)
+{
+	uint8_t Byte;
+
+	while(RxTail != RxHead)
+	{
+		Byte = RxBuffer[RxTail & (USB_RX_BUFFER_SIZE - 1)];
+		RxTail++;
+
+		if(Byte == '\n' || Byte == '\r')	// End of command
+		{
+			if(RxLineLength && !RxLineDiscard)
+			{
+				USBDataRX[RxLineLength] = 0;
+				ParseCommand();
+			}
+			RxLineLength = 0;
+			RxLineDiscard = 0;
+		}
+		else if(RxLineLength < sizeof(USBDataRX) - 1)
+		{
+			USBDataRX[RxLineLength++] = Byte;
+		}
+		else if(!RxLineDiscard)
+		{
+			RxLineDiscard = 1;
+			RxOverflows++;
+		}
 	}
+
+	HelpTask();
+	TxKick();	// Next chunk once the endpoint is idle
+	CDC_ResumeReceive_FS();	// Endpoint might be held while the buffer was full
 }
@@ -0,0 +1,431 @@
+/*
+ * usb_stream.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#include "stm32f1xx_hal.h"
+#include <string.h>
+
+#include "ws2812b.h"
+#include "usb_stream.h"
+#include "usb_parsing.h"
+
+#define ADA_CHECKSUM_KEY	0x55
+#define TPM2_START			0xC9
+#define TPM2_DATA_FRAME		0xDA
+#define TPM2_DELTA_FRAME	0xDE	// Extension - see usb_stream.h
+#define TPM2_RESPONSE		0xAA
+#define TPM2_END			0x36
+
+#define DELTA_SKIP			0x00
+#define DELTA_LITERAL		0x01
+#define DELTA_RUN			0x02
+
+typedef enum {
+	STREAM_IDLE,
+	STREAM_ADA_D,
+	STREAM_ADA_A,
+	STREAM_ADA_HI,
+	STREAM_ADA_LO,
+	STREAM_ADA_CHECKSUM,
+	STREAM_TPM2_TYPE,
+	STREAM_TPM2_HI,
+	STREAM_TPM2_LO,
+	STREAM_PAYLOAD,
+	STREAM_TPM2_END
+} stream_state;
+
+static stream_state State = STREAM_IDLE;
+static uint8_t SizeHi, SizeLo;
+static uint8_t Tpm2;				// Current frame is TPM2 - end byte follows the payload
+static uint32_t PayloadLeft;		// Bytes of payload still expected
+static uint32_t PayloadOffset;		// Write position in the pixel buffer
+static uint8_t Delta;				// Payload is delta records, not raw RGB
+
+static uint8_t DeltaOp;				// Current record type
+static uint8_t DeltaLeft;			// Pixels left in the current record, 0 - next byte is a record header
+static uint8_t DeltaByte;			// Color byte within pixel
+static uint8_t DeltaColor[3];		// Run color
+static uint32_t DeltaPos;			// Current pixel, a payload of skips runs past 16 bits
+
+//
+//	Frame queue - receive path fills slots, main loop presents them.
+//	DMA only ever reads ws2812b_array, so a frame in reception can't tear.
+//	Head and Tail run free, Head - Tail is the number of queued frames.
+//
+static ws2812b_color Queue[USB_STREAM_QUEUE_DEPTH][WS2812B_LEDS];
+static uint16_t QueueSeq[USB_STREAM_QUEUE_DEPTH];
+static volatile uint8_t QueueHead;
+static volatile uint8_t QueueTail;
+static uint8_t *Target;						// Frame in reception, NULL - dropped, queue full
+static const uint8_t * volatile LastFrame;	// Base for delta frames, NULL - current pixel buffer
+static uint16_t RxSeq;
+
+static ws2812b_color Edit[WS2812B_LEDS];	// Frame built by 'W' commands, queued by USB_StreamLatch
+static uint8_t EditOpen;					// Edit holds a base frame, 0 - taken on the next edit
+static uint8_t LatchRequest;
+static volatile uint8_t Refreshing;
+static volatile uint8_t Presented;
+static uint16_t PresentedSeq;
+static uint8_t Notify;
+static volatile uint32_t LastFrameTick;
+static volatile uint8_t Active;
+static volatile uint32_t Frames;
+static volatile uint32_t Errors;
+static volatile uint32_t Dropped;
+
+static void FrameBegin(void)
+{
+	if((uint8_t)(QueueHead - QueueTail) >= USB_STREAM_QUEUE_DEPTH)
+	{
+		Target = NULL;	// Host ignored flow control
+		return;
+	}
+
+	Target = (uint8_t*)Queue[QueueHead % USB_STREAM_QUEUE_DEPTH];
+
+	// Frames shorter than the strip and delta frames keep the rest of the previous frame
+	const uint8_t *Base = LastFrame ? LastFrame : WS2812B_GetPixels();
+	if(Base != Target)
+		memcpy(Target, Base, sizeof(Queue[0]));
+}
+
+static void FrameEnd(void)
+{
+	State = STREAM_IDLE;
+
+	if(!Target)
+	{
+		Dropped++;
+		return;
+	}
+
+	QueueSeq[QueueHead % USB_STREAM_QUEUE_DEPTH] = ++RxSeq;
+	LastFrame = Target;
+	QueueHead++;
+}
+
+static void StartPayload(uint32_t Size)
+{
+	FrameBegin();
+	PayloadLeft = Size;
+	PayloadOffset = 0;
+	DeltaLeft = 0;
+	DeltaByte = 0;
+	DeltaPos = 0;
+	State = PayloadLeft ? STREAM_PAYLOAD : STREAM_TPM2_END;
+	if(!PayloadLeft && !Tpm2)
+		FrameEnd();
+}
+
+static void FrameError(void)
+{
+	// Depth 1 receives over the slot holding the base frame. It is on the strip already -
+	// the queue was empty to take the frame - so later frames build on the strip instead.
+	if(Target && (const uint8_t*)Target == LastFrame && (STREAM_PAYLOAD == State || STREAM_TPM2_END == State))
+		LastFrame = NULL;
+
+	Errors++;
+	State = STREAM_IDLE;
+}
+
+//
+//	One byte of delta payload. Returns 0 on a malformed record.
+//
+static uint8_t DeltaDecode(uint8_t Byte)
+{
+	if(!DeltaLeft)	// Record header
+	{
+		DeltaOp = Byte >> 6;
+		DeltaLeft = (Byte & 0x3F) + 1;
+		DeltaByte = 0;
+
+		if(DELTA_SKIP == DeltaOp)
+		{
+			DeltaPos += DeltaLeft;
+			DeltaLeft = 0;
+		}
+		return (DeltaOp <= DELTA_RUN);
+	}
+
+	if(DELTA_LITERAL == DeltaOp)
+	{
+		if(Target && DeltaPos < WS2812B_LEDS)
+			Target[DeltaPos * 3 + DeltaByte] = Byte;
+		if(++DeltaByte == 3)
+		{
+			DeltaByte = 0;
+			DeltaPos++;
+			DeltaLeft--;
+		}
+	}
+	else // DELTA_RUN
+	{
+		DeltaColor[DeltaByte] = Byte;
+		if(++DeltaByte == 3)
+		{
+			for(uint8_t k = 0; Target && k < DeltaLeft && (DeltaPos + k) < WS2812B_LEDS; k++)
+				memcpy(&Target[(DeltaPos + k) * 3], DeltaColor, 3);
+			DeltaPos += DeltaLeft;
+			DeltaLeft = 0;
+		}
+	}
+	return 1;
+}
+
+//
+//	Called from CDC_Receive_FS with each received packet.
+//	Returns the number of leading bytes eaten by the binary protocol.
+//	0 means Buf[0] does not belong to a frame and should go to the ASCII parser.
+//
+uint32_t USB_StreamReceive(const uint8_t *Buf, uint32_t Len)
+{
+	uint32_t i = 0;
+
+	while(i < Len)
+	{
+		uint8_t Byte = Buf[i];
+
+		switch(State)
+		{
+		case STREAM_IDLE:
+			if('A' == Byte)
+				State = STREAM_ADA_D;
+			else if(TPM2_START == Byte)
+				State = STREAM_TPM2_TYPE;
+			else
+				return i;
+			break;
+
+		case STREAM_ADA_D:
+			if('d' == Byte) State = STREAM_ADA_A;
+			else FrameError();
+			break;
+
+		case STREAM_ADA_A:
+			if('a' == Byte) State = STREAM_ADA_HI;
+			else FrameError();
+			break;
+
+		case STREAM_ADA_HI:
+			SizeHi = Byte;
+			State = STREAM_ADA_LO;
+			break;
+
+		case STREAM_ADA_LO:
+			SizeLo = Byte;
+			State = STREAM_ADA_CHECKSUM;
+			break;
+
+		case STREAM_ADA_CHECKSUM:
+			if(Byte != (SizeHi ^ SizeLo ^ ADA_CHECKSUM_KEY))
+			{
+				FrameError();
+				break;
+			}
+			Tpm2 = 0;
+			Delta = 0;
+			StartPayload((((uint32_t)SizeHi << 8) + SizeLo + 1) * 3);
+			break;
+
+		case STREAM_TPM2_TYPE:
+			if(TPM2_DATA_FRAME == Byte || TPM2_DELTA_FRAME == Byte)
+			{
+				Delta = (TPM2_DELTA_FRAME == Byte);
+				State = STREAM_TPM2_HI;
+			}
+			else FrameError();
+			break;
+
+		case STREAM_TPM2_HI:
+			SizeHi = Byte;
+			State = STREAM_TPM2_LO;
+			break;
+
+		case STREAM_TPM2_LO:
+			SizeLo = Byte;
+			Tpm2 = 1;
+			StartPayload(((uint32_t)SizeHi << 8) + SizeLo);
+			break;
+
+		case STREAM_PAYLOAD:
+		{
+			if(Delta)
+			{
+				if(!DeltaDecode(Byte))
+				{
+					FrameError();
+					break;
+				}
+				if(!--PayloadLeft)
+				{
+					if(DeltaLeft) FrameError();	// Payload ended inside a record
+					else State = STREAM_TPM2_END;
+				}
+				break;
+			}
+
+			// Copy the whole chunk at once, clipped to the pixel buffer
+			uint32_t Chunk = Len - i;
+			if(Chunk > PayloadLeft)
+				Chunk = PayloadLeft;
+
+			if(Target && PayloadOffset < WS2812B_LEDS * 3)
+			{
+				uint32_t Copy = WS2812B_LEDS * 3 - PayloadOffset;
+				if(Copy > Chunk)
+					Copy = Chunk;
+				memcpy(Target + PayloadOffset, &Buf[i], Copy);
+			}
+
+			PayloadOffset += Chunk;
+			PayloadLeft -= Chunk;
+			i += Chunk;
+
+			if(!PayloadLeft)
+			{
+				if(Tpm2)
+					State = STREAM_TPM2_END;
+				else
+					FrameEnd();
+			}
+			continue;
+		}
+
+		case STREAM_TPM2_END:
+			if(TPM2_END == Byte)
+				FrameEnd();
+			else
+				FrameError();
+			break;
+		}
+		i++;
+	}
+	return i;
+}
+
+//
+//	Edit frame for direct pixel writes. Starts from the newest frame - the last one
+//	received, or what is on the strip - and stays in the main loop until latched.
+//
+uint8_t* USB_StreamEdit(void)
+{
+	if(!EditOpen)
+	{
+		__disable_irq();	// Frame receive may be filling the only slot with depth 1
+		memcpy(Edit, LastFrame ? LastFrame : WS2812B_GetPixels(), sizeof(Edit));
+		__enable_irq();
+		EditOpen = 1;
+	}
+	return (uint8_t*)Edit;
+}
+
+//
+//	Queue the edit frame like a streamed one, behind the frames received so far
+//
+void USB_StreamLatch(void)
+{
+	USB_StreamEdit();
+	LatchRequest = 1;
+}
+
+//
+//	Waits for a free slot with no binary frame in reception. Interrupts are off,
+//	so the receive path can't start a frame in the same slot.
+//
+static void LatchEdit(void)
+{
+	__disable_irq();
+	if(STREAM_IDLE == State && (uint8_t)(QueueHead - QueueTail) < USB_STREAM_QUEUE_DEPTH)
+	{
+		uint8_t Slot = QueueHead % USB_STREAM_QUEUE_DEPTH;
+
+		memcpy(Queue[Slot], Edit, sizeof(Edit));
+		QueueSeq[Slot] = ++RxSeq;
+		LastFrame = (const uint8_t*)Queue[Slot];
+		QueueHead++;
+		LatchRequest = 0;
+		EditOpen = 0;
+	}
+	__enable_irq();
+}
+
+//
+//	Called from the SPI DMA complete path when the last LED is clocked out
+//
+void WS2812B_RefreshCpltCallback(void)
+{
+	if(Refreshing)
+	{
+		Refreshing = 0;
+		Presented = 1;
+	}
+}
+
+//
+//	Main loop part - presents queued frames and reports them to the host
+//
+void USB_StreamTask(void)
+{
+	if(LatchRequest)
+		LatchEdit();
+
+	if(QueueHead != QueueTail)
+	{
+		uint8_t Slot = QueueTail % USB_STREAM_QUEUE_DEPTH;
+
+		WS2812B_SetSpan(0, WS2812B_LEDS, Queue[Slot]);
+		PresentedSeq = QueueSeq[Slot];
+		QueueTail++;	// Slot free for reception from now on
+
+		Frames++;
+		LastFrameTick = HAL_GetTick();
+		Active = 1;
+		Refreshing = 1;
+		WS2812B_Refresh();
+	}
+	else if(Active && (HAL_GetTick() - LastFrameTick) > USB_STREAM_TIMEOUT)
+	{
+		Active = 0;
+		LastFrame = NULL;	// Next delta frame starts from what FX left on the strip
+	}
+
+	if(Presented)
+	{
+		Presented = 0;
+		if(Notify)
+		{
+			uint8_t Packet[7] = {TPM2_START, TPM2_RESPONSE, 0x00, 0x02, PresentedSeq >> 8, PresentedSeq & 0xFF, TPM2_END};
+			USB_ParsingTransmit(Packet, sizeof(Packet));
+		}
+	}
+}
+
+void USB_StreamSetNotify(uint8_t Enable)
+{
+	Notify = Enable;
+}
+
+uint8_t USB_StreamIsActive(void)
+{
+	return Active;
+}
+
+uint32_t USB_StreamGetFrames(void)
+{
+	return Frames;
+}
+
+uint32_t USB_StreamGetErrors(void)
+{
+	return Errors;
+}
+
+uint32_t USB_StreamGetDropped(void)
+{
+	return Dropped;
+}
@@ -13,6 +13,7 @@
 #include "dma.h"
 #include "gpio.h"
 #include "math.h"
+#include <string.h>
 
 #include "ws2812b.h"
 
@@ -20,15 +21,107 @@
 #define one 0b11111000
 
 SPI_HandleTypeDef *hspi_ws2812b;
-ws2812b_color ws2812b_array[WS2812B_LEDS];
+ws2812b_color ws2812b_array[WS2812B_LEDS] __attribute__((aligned(4))); // Word aligned for span functions
+
+typedef uint32_t __attribute__((__may_alias__)) ws2812b_word;
 
 static uint8_t buffer[48];
 static uint16_t CurrentLed;
 static uint8_t ResetSignal;
 
+static const ws2812b_correction * volatile Correction;	// NULL - colors sent as they are
+static uint8_t CorrectionProfile;
+
+#define WS2812B_UNMAPPED	0xFFFF
+#if WS2812B_OUTPUTS > 1
+#error "Only output 0 has an encoder - ranges mapped to another output would never be sent"
+#endif
+static uint16_t PhysicalMap[WS2812B_OUTPUTS][WS2812B_OUTPUT_LEDS];	// Logical diode of every physical one
+
 void WS2812B_Init(SPI_HandleTypeDef * spi_handler)
 {
+	const ws2812b_map Straight = { 0, WS2812B_LEDS, 0, 0, 0 };
+
 	hspi_ws2812b = spi_handler;
+	WS2812B_SetMap(&Straight, 1);
+}
+
+//
+//	Virtual strip
+//	Effects, spans and FX segments see one continuous strip of WS2812B_LEDS. The map says
+//	where every logical range is wired - output, first physical diode there and direction.
+//	It is turned into a physical to logical table here, so the encoder in the DMA interrupt
+//	does one lookup per diode. Physical diodes out of every range are sent black, one
+//	logical diode may be shown in more places. Two ranges can't share a physical diode.
+//	Only output 0 is encoded, a range on any other output is refused.
+//
+uint8_t WS2812B_SetMap(const ws2812b_map *Map, uint8_t Ranges)
+{
+	uint16_t Physical[WS2812B_OUTPUTS][WS2812B_OUTPUT_LEDS];
+
+	if(Ranges > WS2812B_MAP_SIZE) return 0;
+	memset(Physical, 0xFF, sizeof(Physical));	// WS2812B_UNMAPPED
+
+	for(uint8_t r = 0; r < Ranges; r++)
+	{
+		const ws2812b_map *m = &Map[r];
+
+		if(m->Output >= WS2812B_OUTPUTS) return 0;
+		if(m->Start > WS2812B_LEDS || m->Count > WS2812B_LEDS - m->Start) return 0;
+		if(m->Offset > WS2812B_OUTPUT_LEDS || m->Count > WS2812B_OUTPUT_LEDS - m->Offset) return 0;
+
+		for(uint16_t i = 0; i < m->Count; i++)
+		{
+			uint16_t *p = &Physical[m->Output][m->Offset + i];
+
+			if(*p != WS2812B_UNMAPPED) return 0;
+			*p = m->Reverse ? (m->Start + m->Count - 1 - i) : (m->Start + i);
+		}
+	}
+
+	memcpy(PhysicalMap, Physical, sizeof(PhysicalMap));	// Refresh in progress may show both maps once
+	return 1;
+}
+
+//
+//	Output correction - gamma and white balance applied while bits are clocked out,
+//	so effects keep working on linear colors. One table lookup per channel.
+//
+void WS2812B_SetCorrection(uint8_t Profile)
+{
+	if(Profile > WS2812B_CorrectionProfiles) return;
+	CorrectionProfile = Profile;
+	Correction = Profile ? &WS2812B_Correction[Profile - 1] : NULL;
+}
+
+uint8_t WS2812B_GetCorrection(void)
+{
+	return CorrectionProfile;
+}
+
+//
+//	Color of physical diode on output 0, the only one driven by SPI here
+//
+static ws2812b_color OutputColor(uint16_t physical_id)
+{
+	const ws2812b_color Black = { 0, 0, 0 };
+	const ws2812b_correction *Table = Correction;
+
+	if(physical_id >= WS2812B_OUTPUT_LEDS) return Black;	// Encoder runs one diode past the strip
+
+	uint16_t diode_id = PhysicalMap[0][physical_id];
+
+	if(diode_id == WS2812B_UNMAPPED) return Black;
+
+	ws2812b_color c = ws2812b_array[diode_id];
+
+	if(Table)
+	{
+		c.red = Table->red[c.red];
+		c.green = Table->green[c.green];
+		c.blue = Table->blue[c.blue];
+	}
+	return c;
 }
 
 void WS2812B_SetDiodeColor(int16_t diode_id, uint32_t color)
@@ -55,6 +148,7 @@ void WS2812B_SetDiodeRGB(int16_t diode_id, uint8_t R, uint8_t G, uint8_t B)
 
 uint32_t WS2812B_GetColor(int16_t diode_id)
 {
+	if(diode_id >= WS2812B_LEDS || diode_id < 0) return 0;
 	uint32_t color = 0;
 	color |= ((ws2812b_array[diode_id].red&0xFF)<<16);
 	color |= ((ws2812b_array[diode_id].green&0xFF)<<8);
@@ -66,71 +160,661 @@ uint8_t* WS2812B_GetPixels(void)
 {
 	return (uint8_t*)ws2812b_array;
 }
+
 //
-//	Set diode with HSV model
+//	Span functions
+//
+//	Range is checked once per call. Span is clipped to the end of the strip,
+//	start out of the strip does nothing.
+//
+static uint16_t SpanClip(int16_t diode_id, uint16_t count)
+{
+	if(diode_id >= WS2812B_LEDS || diode_id < 0) return 0;
+	if(count > (WS2812B_LEDS - diode_id)) count = WS2812B_LEDS - diode_id;
+	return count;
+}
+
+//
+//	Fill count diodes from diode_id with one color
+//	Every 4 diodes are 12 bytes, so aligned part is written with 3 word stores
+//
+void WS2812B_FillSpan(int16_t diode_id, uint16_t count, uint32_t color)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+
+	uint8_t r = ((color>>16)&0xFF);
+	uint8_t g = ((color>>8)&0xFF);
+	uint8_t b = (color&0xFF);
+	ws2812b_color *c = &ws2812b_array[diode_id];
+
+	while(count && (diode_id & 3)) // Head up to word boundary
+	{
+		c->red = r;
+		c->green = g;
+		c->blue = b;
+		c++;
+		diode_id++;
+		count--;
+	}
+
+	uint32_t w0 = r | (g << 8) | (b << 16) | ((uint32_t)r << 24);
+	uint32_t w1 = g | (b << 8) | (r << 16) | ((uint32_t)g << 24);
+	uint32_t w2 = b | (r << 8) | (g << 16) | ((uint32_t)b << 24);
+	ws2812b_word *w = (ws2812b_word*)c;
+
+	for(; count >= 4; count -= 4)
+	{
+		*w++ = w0;
+		*w++ = w1;
+		*w++ = w2;
+	}
+
+	c = (ws2812b_color*)w;
+	while(count--) // Tail
+	{
+		c->red = r;
+		c->green = g;
+		c->blue = b;
+		c++;
+	}
+}
+
+//
+//	Fill count diodes from diode_id with linear gradient from color1 to color2
+//	Channels are stepped in 8.16 fixed point, one division per channel per span
+//
+void WS2812B_FillSpanGradient(int16_t diode_id, uint16_t count, uint32_t color1, uint32_t color2)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+
+	int32_t r = ((color1>>16)&0xFF) << 16;
+	int32_t g = ((color1>>8)&0xFF) << 16;
+	int32_t b = (color1&0xFF) << 16;
+	int32_t dr = 0, dg = 0, db = 0;
+
+	if(count > 1)
+	{
+		dr = ((int32_t)(((color2>>16)&0xFF) << 16) - r) / (count - 1);
+		dg = ((int32_t)(((color2>>8)&0xFF) << 16) - g) / (count - 1);
+		db = ((int32_t)((color2&0xFF) << 16) - b) / (count - 1);
+	}
+
+	r += 0x8000; // Round to nearest
+	g += 0x8000;
+	b += 0x8000;
+
+	ws2812b_color *c = &ws2812b_array[diode_id];
+	while(count--)
+	{
+		c->red = r >> 16;
+		c->green = g >> 16;
+		c->blue = b >> 16;
+		c++;
+		r += dr;
+		g += dg;
+		b += db;
+	}
+}
+
+//
+//	Copy count diodes from src_id to dst_id. Spans may overlap.
+//
+void WS2812B_CopySpan(int16_t dst_id, int16_t src_id, uint16_t count)
+{
+	count = SpanClip(dst_id, SpanClip(src_id, count));
+	if(count == 0) return;
+
+	memmove(&ws2812b_array[dst_id], &ws2812b_array[src_id], count * sizeof(ws2812b_color));
+}
+
+//
+//	Copy count diodes from src_id to dst_id in reversed order
+//	Spans must not overlap unless dst_id == src_id, then span is reversed in place
+//
+void WS2812B_CopySpanReverse(int16_t dst_id, int16_t src_id, uint16_t count)
+{
+	count = SpanClip(dst_id, SpanClip(src_id, count));
+	if(count == 0) return;
+
+	ws2812b_color *d = &ws2812b_array[dst_id];
+	ws2812b_color *s = &ws2812b_array[src_id + count - 1];
+
+	if(dst_id == src_id)
+	{
+		while(d < s)
+		{
+			ws2812b_color tmp = *d;
+			*d++ = *s;
+			*s-- = tmp;
+		}
+		return;
+	}
+
+	while(count--)
+	{
+		*d++ = *s--;
+	}
+}
+//
+//	HSV to RGB conversion without division
 //
 //	Hue 0-359
 //	Saturation 0-255
 //	Birghtness(Value) 0-255
 //
-void WS2812B_SetDiodeHSV(int16_t diode_id, uint16_t Hue, uint8_t Saturation, uint8_t Brightness)
+//	x / 60 is replaced with (x * 17477) >> 20 which is exact for
+//	every x up to 255 * 59, so results are the same as with the old divisions.
+//
+static void HSVtoRGB(uint16_t Hue, uint8_t Saturation, uint8_t Brightness, ws2812b_color *c)
 {
-	if(diode_id >= WS2812B_LEDS || diode_id < 0) return;
 	uint16_t Sector, Fracts, p, q, t;
 
 	if(Saturation == 0)
 	{
-		ws2812b_array[diode_id].red = Brightness;
-		ws2812b_array[diode_id].green = Brightness;
-		ws2812b_array[diode_id]. blue = Brightness;
+		c->red = Brightness;
+		c->green = Brightness;
+		c->blue = Brightness;
+		return;
+	}
+
+	if(Hue >= 360) Hue = 359;
+
+	Sector = ((uint32_t)Hue * 17477) >> 20; // Sector 0 to 5
+	Fracts = Hue - (Sector * 60);
+	p = (Brightness * (255 - Saturation)) >> 8;
+	q = (Brightness * (255 - (((uint32_t)(Saturation * Fracts) * 17477) >> 20))) >> 8;
+	t = (Brightness * (255 - (((uint32_t)(Saturation * (59 - Fracts)) * 17477) >> 20))) >> 8;
+
+	switch(Sector)
+	{
+	case 0:
+		c->red = Brightness;
+		c->green = (uint8_t)t;
+		c->blue = (uint8_t)p;
+		break;
+	case 1:
+		c->red = (uint8_t)q;
+		c->green = Brightness;
+		c->blue = (uint8_t)p;
+		break;
+	case 2:
+		c->red = (uint8_t)p;
+		c->green = Brightness;
+		c->blue = (uint8_t)t;
+		break;
+	case 3:
+		c->red = (uint8_t)p;
+		c->green = (uint8_t)q;
+		c->blue = Brightness;
+		break;
+	case 4:
+		c->red = (uint8_t)t;
+		c->green = (uint8_t)p;
+		c->blue = Brightness;
+		break;
+	default:		// case 5:
+		c->red = Brightness;
+		c->green = (uint8_t)p;
+		c->blue = (uint8_t)q;
+		break;
+	}
+}
+
+void WS2812B_HSVtoRGB(uint16_t Hue, uint8_t Saturation, uint8_t Brightness, uint8_t *R, uint8_t *G, uint8_t *B)
+{
+	ws2812b_color c;
+	HSVtoRGB(Hue, Saturation, Brightness, &c);
+	*R = c.red;
+	*G = c.green;
+	*B = c.blue;
+}
+
+//
+//	32768 / x rounded up, x = 1..255
+//
+static const uint16_t _invTable[256] = {
+      0,32768,16384,10923, 8192, 6554, 5462, 4682, 4096, 3641, 3277, 2979, 2731, 2521, 2341, 2185,
+   2048, 1928, 1821, 1725, 1639, 1561, 1490, 1425, 1366, 1311, 1261, 1214, 1171, 1130, 1093, 1058,
+   1024,  993,  964,  937,  911,  886,  863,  841,  820,  800,  781,  763,  745,  729,  713,  698,
+    683,  669,  656,  643,  631,  619,  607,  596,  586,  575,  565,  556,  547,  538,  529,  521,
+    512,  505,  497,  490,  482,  475,  469,  462,  456,  449,  443,  437,  432,  426,  421,  415,
+    410,  405,  400,  395,  391,  386,  382,  377,  373,  369,  365,  361,  357,  353,  349,  345,
+    342,  338,  335,  331,  328,  325,  322,  319,  316,  313,  310,  307,  304,  301,  298,  296,
+    293,  290,  288,  285,  283,  281,  278,  276,  274,  271,  269,  267,  265,  263,  261,  259,
+    256,  255,  253,  251,  249,  247,  245,  243,  241,  240,  238,  236,  235,  233,  231,  230,
+    228,  226,  225,  223,  222,  220,  219,  218,  216,  215,  213,  212,  211,  209,  208,  207,
+    205,  204,  203,  202,  200,  199,  198,  197,  196,  194,  193,  192,  191,  190,  189,  188,
+    187,  186,  185,  184,  183,  182,  181,  180,  179,  178,  177,  176,  175,  174,  173,  172,
+    171,  170,  169,  169,  168,  167,  166,  165,  164,  164,  163,  162,  161,  160,  160,  159,
+    158,  157,  157,  156,  155,  154,  154,  153,  152,  152,  151,  150,  149,  149,  148,  147,
+    147,  146,  145,  145,  144,  144,  143,  142,  142,  141,  141,  140,  139,  139,  138,  138,
+    137,  136,  136,  135,  135,  134,  134,  133,  133,  132,  132,  131,  131,  130,  130,  129};
+
+//
+//	RGB to HSV conversion without division
+//
+//	Divisions by max and delta are replaced with Q15 reciprocals from _invTable.
+//	Hue is within 1 degree and Saturation within 2 of the exact value.
+//
+void WS2812B_RGBtoHSV(uint8_t R, uint8_t G, uint8_t B, uint16_t *Hue, uint8_t *Saturation, uint8_t *Brightness)
+{
+	uint8_t min, max, delta;
+	int16_t diff;
+	int16_t h;
+	uint32_t s;
+
+	min = R < G ? R : G;
+	min = min < B ? min : B;
+
+	max = R > G ? R : G;
+	max = max > B ? max : B;
+
+	*Brightness = max;
+	delta = max - min;
+	if(delta == 0)
+	{
+		*Saturation = 0;
+		*Hue = 0; // undefined
+		return;
+	}
+
+	s = ((uint32_t)delta * 255 * _invTable[max]) >> 15;
+	*Saturation = (s > 255) ? 255 : s;
+
+	if(R == max)
+	{
+		h = 0;		// between yellow & magenta
+		diff = G - B;
+	}
+	else if(G == max)
+	{
+		h = 120;	// between cyan & yellow
+		diff = B - R;
 	}
 	else
 	{
-		if(Hue >= 360) Hue = 359;
+		h = 240;	// between magenta & cyan
+		diff = R - G;
+	}
 
-		Sector = Hue / 60; // Sector 0 to 5
-		Fracts = Hue % 60;
-		p = (Brightness * (255 - Saturation)) / 256;
-		q = (Brightness * (255 - (Saturation * Fracts)/60)) / 256;
-		t = (Brightness * (255 - (Saturation * (59 - Fracts))/60)) / 256;
+	if(diff < 0)
+		h -= ((uint32_t)(-diff) * 60 * _invTable[delta]) >> 15;
+	else
+		h += ((uint32_t)diff * 60 * _invTable[delta]) >> 15;
 
+	if(h < 0) h += 360;
+	if(h >= 360) h -= 360;
 
-		switch(Sector)
+	*Hue = h;
+}
+
+//
+//	SWAR helpers - 4 independent 8 bit lanes in one 32 bit word
+//
+#define SWAR_ONES	0x01010101UL
+#define SWAR_HIGH	0x80808080UL
+#define SWAR_LOW7	0x7F7F7F7FUL
+
+// 0xFF in lanes where x != 0
+static inline uint32_t SwarNonZero(uint32_t x)
+{
+	return (((((x & SWAR_LOW7) + SWAR_LOW7) | x) & SWAR_HIGH) >> 7) * 0xFF;
+}
+
+// Lanewise x >> n, n = 0..8
+static inline uint32_t SwarShr(uint32_t x, uint8_t n)
+{
+	if(n > 7) return 0;
+	return (x >> n) & ((0xFFUL >> n) * SWAR_ONES);
+}
+
+// Lanewise max(a - b, 0)
+static inline uint32_t SwarSubSat(uint32_t a, uint32_t b)
+{
+	uint32_t d = ((a | SWAR_HIGH) - (b & SWAR_LOW7)) ^ ((a ^ ~b) & SWAR_HIGH);
+	uint32_t borrow = ((~a & b) | (~(a ^ b) & d)) & SWAR_HIGH;
+	return d & ~((borrow >> 7) * 0xFF);
+}
+
+// Lanewise min(a + b, 255)
+static inline uint32_t SwarAddSat(uint32_t a, uint32_t b)
+{
+	uint32_t sum = ((a & SWAR_LOW7) + (b & SWAR_LOW7)) ^ ((a ^ b) & SWAR_HIGH);
+	uint32_t carry = ((a & b) | ((a | b) & ~sum)) & SWAR_HIGH;
+	return sum | ((carry >> 7) * 0xFF);
+}
+
+//
+//	One fade step of every lane of c toward t
+//	Difference d below 3 jumps to target, otherwise moves by d >> rateH + d >> rateL.
+//	Shifts of negative differences round toward minus infinity like in the old int code.
+//
+static inline uint32_t SwarFade(uint32_t c, uint32_t t, uint8_t rateH, uint8_t rateL)
+{
+	uint32_t up = SwarSubSat(t, c);
+	uint32_t dn = SwarSubSat(c, t);
+	uint32_t near;
+
+	// Lanes with difference 0..2 take the whole difference
+	near = ~SwarNonZero(SwarSubSat(up, 2 * SWAR_ONES));
+	up = (up & near) | ((SwarShr(up, rateH) + SwarShr(up, rateL)) & ~near);
+
+	near = ~SwarNonZero(SwarSubSat(dn, 2 * SWAR_ONES));
+	dn = (dn & near) | ((SwarShr(dn, rateH) + (SwarNonZero(dn & ((0xFFUL >> (8 - rateH)) * SWAR_ONES)) & SWAR_ONES) +
+			SwarShr(dn, rateL) + (SwarNonZero(dn & ((0xFFUL >> (8 - rateL)) * SWAR_ONES)) & SWAR_ONES)) & ~near);
+
+	return c + up - dn; // Lanes can't carry, up <= t - c and dn <= c - t
+}
+
+// Lanewise (x * scale) >> 8, scale 0..256
+static inline uint32_t SwarScale(uint32_t x, uint16_t scale)
+{
+	uint32_t even = (((x & 0x00FF00FFUL) * scale) >> 8) & 0x00FF00FFUL;
+	uint32_t odd = (((x >> 8) & 0x00FF00FFUL) * scale) & 0xFF00FF00UL;
+	return even | odd;
+}
+
+static inline uint32_t PixelLoad(const ws2812b_color *c)
+{
+	return c->red | (c->green << 8) | ((uint32_t)c->blue << 16);
+}
+
+static inline void PixelStore(ws2812b_color *c, uint32_t x)
+{
+	c->red = x;
+	c->green = x >> 8;
+	c->blue = x >> 16;
+}
+
+//
+//	Fade count diodes from diode_id one step toward target color
+//	Aligned part goes 4 diodes (3 words) per iteration
+//
+void WS2812B_FadeSpan(int16_t diode_id, uint16_t count, uint32_t target, uint8_t rateH, uint8_t rateL)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+
+	ws2812b_color t = {((target>>16)&0xFF), ((target>>8)&0xFF), (target&0xFF)};
+	uint32_t tp = PixelLoad(&t);
+	ws2812b_color *c = &ws2812b_array[diode_id];
+
+	while(count && (diode_id & 3)) // Head up to word boundary
+	{
+		PixelStore(c, SwarFade(PixelLoad(c), tp, rateH, rateL));
+		c++;
+		diode_id++;
+		count--;
+	}
+
+	uint32_t t0 = tp | (tp << 24);
+	uint32_t t1 = (tp >> 8) | (tp << 16);
+	uint32_t t2 = (tp >> 16) | (tp << 8);
+	ws2812b_word *w = (ws2812b_word*)c;
+
+	for(; count >= 4; count -= 4)
+	{
+		w[0] = SwarFade(w[0], t0, rateH, rateL);
+		w[1] = SwarFade(w[1], t1, rateH, rateL);
+		w[2] = SwarFade(w[2], t2, rateH, rateL);
+		w += 3;
+	}
+
+	c = (ws2812b_color*)w;
+	while(count--) // Tail
+	{
+		PixelStore(c, SwarFade(PixelLoad(c), tp, rateH, rateL));
+		c++;
+	}
+}
+
+//
+//	Scale count diodes from diode_id by scale/256
+//
+void WS2812B_ScaleSpan(int16_t diode_id, uint16_t count, uint16_t scale)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+	if(scale > 256) scale = 256;
+
+	ws2812b_color *c = &ws2812b_array[diode_id];
+
+	while(count && (diode_id & 3)) // Head up to word boundary
+	{
+		PixelStore(c, SwarScale(PixelLoad(c), scale));
+		c++;
+		diode_id++;
+		count--;
+	}
+
+	ws2812b_word *w = (ws2812b_word*)c;
+	uint16_t words = (count / 4) * 3;
+	count &= 3;
+	while(words--)
+	{
+		*w = SwarScale(*w, scale);
+		w++;
+	}
+
+	c = (ws2812b_color*)w;
+	while(count--) // Tail
+	{
+		PixelStore(c, SwarScale(PixelLoad(c), scale));
+		c++;
+	}
+}
+
+//
+//	Blur count diodes from diode_id
+//	diode(i) = diode(i-1)/4 + diode(i) + diode(i+1)/4, saturated at 255
+//	Goes forward in place, so diode(i-1) is already blurred. First and last diode are only read.
+//
+void WS2812B_BlurSpan(int16_t diode_id, uint16_t count)
+{
+	count = SpanClip(diode_id, count);
+	if(count < 3) return;
+
+	ws2812b_color *c = &ws2812b_array[diode_id + 1];
+	uint32_t prev = PixelLoad(c - 1);
+	uint32_t cur = PixelLoad(c);
+
+	for(count -= 2; count; count--)
+	{
+		uint32_t next = PixelLoad(c + 1);
+		cur = SwarAddSat(SwarAddSat(cur, SwarShr(prev, 2)), SwarShr(next, 2));
+		PixelStore(c, cur);
+		prev = cur;
+		cur = next;
+		c++;
+	}
+}
+
+//
+//	Copy count diodes from diode_id to external buffer
+//
+void WS2812B_GetSpan(int16_t diode_id, uint16_t count, ws2812b_color *dst)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+
+	memcpy(dst, &ws2812b_array[diode_id], count * sizeof(ws2812b_color));
+}
+
+//
+//	Copy count diodes from external buffer to diode_id
+//
+void WS2812B_SetSpan(int16_t diode_id, uint16_t count, const ws2812b_color *src)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+
+	memcpy(&ws2812b_array[diode_id], src, count * sizeof(ws2812b_color));
+}
+
+//
+//	Blend two external buffers into count diodes from diode_id
+//	diode = a * (256 - amount) / 256 + b * amount / 256, amount 0..256
+//	Both products are floored, so lanes never exceed 255
+//
+void WS2812B_BlendSpan(int16_t diode_id, uint16_t count, const ws2812b_color *a, const ws2812b_color *b, uint16_t amount)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+	if(amount > 256) amount = 256;
+
+	ws2812b_color *c = &ws2812b_array[diode_id];
+	while(count--)
+	{
+		PixelStore(c++, SwarScale(PixelLoad(a++), 256 - amount) + SwarScale(PixelLoad(b++), amount));
+	}
+}
+
+// Lanewise max(a, b)
+static inline uint32_t SwarMax(uint32_t a, uint32_t b)
+{
+	return b + SwarSubSat(a, b); // Can't carry, result is at most a
+}
+
+// Lanewise a * (b + 1) / 256, one multiply per lane
+static inline uint32_t PixelMultiply(uint32_t a, uint32_t b)
+{
+	return ((((a & 0xFF) * ((b & 0xFF) + 1)) >> 8)) |
+			(((((a >> 8) & 0xFF) * (((b >> 8) & 0xFF) + 1)) >> 8) << 8) |
+			(((((a >> 16) & 0xFF) * (((b >> 16) & 0xFF) + 1)) >> 8) << 16);
+}
+
+//
+//	Composite layer buffer over under buffer into count diodes from diode_id
+//	Layer is scaled by scale/256, combined with under by blend mode
+//	and the result mixed with under by alpha/256. scale and alpha 0..256
+//
+void WS2812B_CompositeSpan(int16_t diode_id, uint16_t count, const ws2812b_color *under, const ws2812b_color *layer, uint16_t scale, uint16_t alpha, ws2812b_blend blend)
+{
+	count = SpanClip(diode_id, count);
+	if(count == 0) return;
+	if(scale > 256) scale = 256;
+	if(alpha > 256) alpha = 256;
+
+	ws2812b_color *c = &ws2812b_array[diode_id];
+	while(count--)
+	{
+		uint32_t u = PixelLoad(under++);
+		uint32_t l = SwarScale(PixelLoad(layer++), scale);
+
+		switch(blend)
 		{
-		case 0:
-			ws2812b_array[diode_id].red = Brightness;
-			ws2812b_array[diode_id].green = (uint8_t)t;
-			ws2812b_array[diode_id]. blue = (uint8_t)p;
-			break;
-		case 1:
-			ws2812b_array[diode_id].red = (uint8_t)q;
-			ws2812b_array[diode_id].green = Brightness;
-			ws2812b_array[diode_id]. blue = (uint8_t)p;
-			break;
-		case 2:
-			ws2812b_array[diode_id].red = (uint8_t)p;
-			ws2812b_array[diode_id].green = Brightness;
-			ws2812b_array[diode_id]. blue = (uint8_t)t;
-			break;
-		case 3:
-			ws2812b_array[diode_id].red = (uint8_t)p;
-			ws2812b_array[diode_id].green = (uint8_t)q;
-			ws2812b_array[diode_id]. blue = Brightness;
-			break;
-		case 4:
-			ws2812b_array[diode_id].red = (uint8_t)t;
-			ws2812b_array[diode_id].green = (uint8_t)p;
-			ws2812b_array[diode_id]. blue = Brightness;
-			break;
-		default:		// case 5:
-			ws2812b_array[diode_id].red = Brightness;
-			ws2812b_array[diode_id].green = (uint8_t)p;
-			ws2812b_array[diode_id]. blue = (uint8_t)q;
-			break;
+		case WS2812B_BLEND_ADD:			l = SwarAddSat(u, l);		break;
+		case WS2812B_BLEND_MAX:			l = SwarMax(u, l);			break;
+		case WS2812B_BLEND_MULTIPLY:	l = PixelMultiply(u, l);	break;
+		default:													break;
 		}
+		PixelStore(c++, SwarScale(u, 256 - alpha) + SwarScale(l, alpha));
 	}
 }
 
+//
+//	Set diode with HSV model
+//
+//	Hue 0-359
+//	Saturation 0-255
+//	Birghtness(Value) 0-255
+//
+void WS2812B_SetDiodeHSV(int16_t diode_id, uint16_t Hue, uint8_t Saturation, uint8_t Brightness)
+{
+	if(diode_id >= WS2812B_LEDS || diode_id < 0) return;
+	HSVtoRGB(Hue, Saturation, Brightness, &ws2812b_array[diode_id]);
+}
+
+//
+//	Cycles of the last and the worst HSV span call, conversion loop only. Read from
+//	a debugger or with WS2812B_GetSpanCycles, needs WS2812B_SPAN_CYCLES 1.
+//
+static uint32_t SpanCyclesLast, SpanCyclesMax;
+
+uint32_t WS2812B_GetSpanCycles(uint32_t *Max)
+{
+	if(Max)
+		*Max = SpanCyclesMax;
+	return SpanCyclesLast;
+}
+
+#if WS2812B_SPAN_CYCLES
+static uint32_t SpanCyclesStart(void)
+{
+	if(!(DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk))
+	{
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+	return DWT->CYCCNT;
+}
+
+static void SpanCyclesStop(uint32_t Start)
+{
+	SpanCyclesLast = DWT->CYCCNT - Start;
+	if(SpanCyclesLast > SpanCyclesMax)
+		SpanCyclesMax = SpanCyclesLast;
+}
+#endif
+
+//
+//	Set count diodes from diode_id with HSV values taken from arrays
+//
+void WS2812B_SetSpanHSV(int16_t diode_id, uint16_t count, const uint16_t *Hue, const uint8_t *Saturation, const uint8_t *Brightness)
+{
+	if(diode_id >= WS2812B_LEDS || diode_id < 0) return;
+	if(count > (WS2812B_LEDS - diode_id)) count = WS2812B_LEDS - diode_id;
+
+#if WS2812B_SPAN_CYCLES
+	uint32_t Start = SpanCyclesStart();
+#endif
+	ws2812b_color *c = &ws2812b_array[diode_id];
+	for(uint16_t i = 0; i < count; i++)
+	{
+		HSVtoRGB(Hue[i], Saturation[i], Brightness[i], c++);
+	}
+#if WS2812B_SPAN_CYCLES
+	SpanCyclesStop(Start);
+#endif
+}
+
+//
+//	Set count diodes from diode_id with hue going from HueStart to HueStop
+//	HueStop lower than HueStart wraps through 359 -> 0
+//
+//	Hue step is kept in 16.16 fixed point, so there is only one division per span
+//
+void WS2812B_SetSpanHSVGradient(int16_t diode_id, uint16_t count, uint16_t HueStart, uint16_t HueStop, uint8_t Saturation, uint8_t Brightness)
+{
+	if(diode_id >= WS2812B_LEDS || diode_id < 0) return;
+	if(count > (WS2812B_LEDS - diode_id)) count = WS2812B_LEDS - diode_id;
+	if(count == 0) return;
+	if(HueStart >= 360) HueStart = 359;
+	if(HueStop >= 360) HueStop = 359;
+
+	uint32_t range = (HueStop >= HueStart) ? (HueStop - HueStart) : (HueStop + 360 - HueStart);
+	uint32_t step = (count > 1) ? ((range << 16) / (count - 1)) : 0;
+	uint32_t acc = 0;
+
+#if WS2812B_SPAN_CYCLES
+	uint32_t Start = SpanCyclesStart();
+#endif
+	ws2812b_color *c = &ws2812b_array[diode_id];
+	for(uint16_t i = 0; i < count; i++)
+	{
+		uint16_t h = HueStart + (acc >> 16);
+		if(h >= 360) h -= 360;
+		HSVtoRGB(h, Saturation, Brightness, c++);
+		acc += step;
+	}
+#if WS2812B_SPAN_CYCLES
+	SpanCyclesStop(Start);
+#endif
+}
+
 void WS2812B_Refresh()
 {
 	CurrentLed = 0;
@@ -143,6 +827,13 @@ void WS2812B_Refresh()
 
 }
 
+//
+//	Whole strip clocked out. Called from DMA interrupt, override to get notified.
+//
+__weak void WS2812B_RefreshCpltCallback(void)
+{
+}
+
 void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi)
 {
 	if(hspi == hspi_ws2812b)
@@ -157,17 +848,19 @@ void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi)
 		}
 		else // LEDs Odd 1,3,5,7...
 		{
-			if(CurrentLed > WS2812B_LEDS)
+			if(CurrentLed > WS2812B_OUTPUT_LEDS)
 			{
 				HAL_SPI_DMAStop(hspi_ws2812b);
+				WS2812B_RefreshCpltCallback();
 			}
 			else
 			{
+				ws2812b_color c = OutputColor(CurrentLed);
 				uint8_t j = 0;
 				//GREEN
 				for(int8_t k=7; k>=0; k--)
 				{
-					if((ws2812b_array[CurrentLed].green & (1<<k)) == 0)
+					if((c.green & (1<<k)) == 0)
 						buffer[j] = zero;
 					else
 						buffer[j] = one;
@@ -177,7 +870,7 @@ void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi)
 				//RED
 				for(int8_t k=7; k>=0; k--)
 				{
-					if((ws2812b_array[CurrentLed].red & (1<<k)) == 0)
+					if((c.red & (1<<k)) == 0)
 						buffer[j] = zero;
 					else
 						buffer[j] = one;
@@ -187,7 +880,7 @@ void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi)
 				//BLUE
 				for(int8_t k=7; k>=0; k--)
 				{
-					if((ws2812b_array[CurrentLed].blue & (1<<k)) == 0)
+					if((c.blue & (1<<k)) == 0)
 						buffer[j] = zero;
 					else
 						buffer[j] = one;
@@ -203,18 +896,20 @@ void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
 {
 	if(hspi == hspi_ws2812b)
 	{
-		if(CurrentLed > WS2812B_LEDS)
+		if(CurrentLed > WS2812B_OUTPUT_LEDS)
 		{
 			HAL_SPI_DMAStop(hspi_ws2812b);
+			WS2812B_RefreshCpltCallback();
 		}
 		else
 		{
 			// Even LEDs 0,2,0
+			ws2812b_color c = OutputColor(CurrentLed);
 			uint8_t j = 24;
 			//GREEN
 			for(int8_t k=7; k>=0; k--)
 			{
-				if((ws2812b_array[CurrentLed].green & (1<<k)) == 0)
+				if((c.green & (1<<k)) == 0)
 					buffer[j] = zero;
 				else
 					buffer[j] = one;
@@ -224,7 +919,7 @@ void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
 			//RED
 			for(int8_t k=7; k>=0; k--)
 			{
-				if((ws2812b_array[CurrentLed].red & (1<<k)) == 0)
+				if((c.red & (1<<k)) == 0)
 					buffer[j] = zero;
 				else
 					buffer[j] = one;
@@ -234,7 +929,7 @@ void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
 			//BLUE
 			for(int8_t k=7; k>=0; k--)
 			{
-				if((ws2812b_array[CurrentLed].blue & (1<<k)) == 0)
+				if((c.blue & (1<<k)) == 0)
 					buffer[j] = zero;
 				else
 					buffer[j] = one;
@@ -0,0 +1,132 @@
+/*
+ * ws2812b_correction.c
+ *
+ *	The MIT License.
+ *		Author: agent
+ *		agent@local
+ *
+ *	Generated by Tools/gamma_gen, do not edit:
+ *	gamma_gen gamma28 2.8 2.8 2.8 1 1 1 strip 2.8 2.8 2.8 1 0.69 0.94
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "ws2812b.h"
+
+const uint8_t WS2812B_CorrectionProfiles = 2;
+
+const ws2812b_correction WS2812B_Correction[2] =
+{
+	{	// 1 - gamma28, gamma 2.8/2.8/2.8, scale 1/1/1
+		.red = {
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
+			  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+			  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
+			  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
+			 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
+			 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
+			 25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
+			 37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
+			 51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
+			 69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
+			 90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
+			115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
+			144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
+			177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
+			215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255,
+		},
+		.green = {
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
+			  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+			  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
+			  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
+			 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
+			 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
+			 25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
+			 37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
+			 51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
+			 69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
+			 90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
+			115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
+			144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
+			177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
+			215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255,
+		},
+		.blue = {
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
+			  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+			  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
+			  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
+			 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
+			 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
+			 25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
+			 37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
+			 51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
+			 69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
+			 90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
+			115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
+			144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
+			177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
+			215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255,
+		},
+	},
+	{	// 2 - strip, gamma 2.8/2.8/2.8, scale 1/0.69/0.94
+		.red = {
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
+			  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+			  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
+			  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
+			 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
+			 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
+			 25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
+			 37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
+			 51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
+			 69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
+			 90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
+			115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
+			144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
+			177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
+			215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255,
+		},
+		.green = {
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,
+			  2,  2,  2,  2,  2,  2,  2,  2,  3,  3,  3,  3,  3,  3,  3,  4,
+			  4,  4,  4,  4,  4,  5,  5,  5,  5,  5,  6,  6,  6,  6,  6,  7,
+			  7,  7,  7,  8,  8,  8,  8,  9,  9,  9, 10, 10, 10, 10, 11, 11,
+			 11, 12, 12, 12, 13, 13, 14, 14, 14, 15, 15, 15, 16, 16, 17, 17,
+			 18, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 23, 24, 24, 25,
+			 26, 26, 27, 27, 28, 28, 29, 30, 30, 31, 32, 32, 33, 33, 34, 35,
+			 36, 36, 37, 38, 38, 39, 40, 41, 41, 42, 43, 44, 44, 45, 46, 47,
+			 48, 49, 49, 50, 51, 52, 53, 54, 55, 56, 57, 57, 58, 59, 60, 61,
+			 62, 63, 64, 65, 66, 67, 68, 69, 71, 72, 73, 74, 75, 76, 77, 78,
+			 79, 81, 82, 83, 84, 85, 87, 88, 89, 90, 92, 93, 94, 95, 97, 98,
+			 99,101,102,104,105,106,108,109,111,112,113,115,116,118,119,121,
+			122,124,125,127,129,130,132,133,135,137,138,140,142,143,145,147,
+			148,150,152,154,156,157,159,161,163,165,166,168,170,172,174,176,
+		},
+		.blue = {
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+			  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,
+			  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,
+			  2,  2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,
+			  5,  5,  5,  6,  6,  6,  6,  7,  7,  7,  8,  8,  8,  8,  9,  9,
+			  9, 10, 10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15,
+			 16, 16, 16, 17, 17, 18, 18, 19, 19, 20, 21, 21, 22, 22, 23, 23,
+			 24, 25, 25, 26, 26, 27, 28, 28, 29, 30, 30, 31, 32, 33, 33, 34,
+			 35, 36, 36, 37, 38, 39, 40, 40, 41, 42, 43, 44, 45, 46, 47, 47,
+			 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 61, 62, 63, 64,
+			 65, 66, 67, 68, 70, 71, 72, 73, 75, 76, 77, 78, 80, 81, 82, 84,
+			 85, 86, 88, 89, 90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,
+			108,110,111,113,115,116,118,120,121,123,125,127,128,130,132,134,
+			135,137,139,141,143,145,147,149,151,153,155,157,159,161,163,165,
+			167,169,171,173,175,177,180,182,184,186,188,191,193,195,198,200,
+			202,205,207,209,212,214,217,219,222,224,227,229,232,234,237,240,
+		},
+	},
+};
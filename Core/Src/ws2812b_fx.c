@@ -12,15 +12,17 @@
  */
 #include "stm32f1xx_hal.h"
 #include <stdlib.h>
+#include <string.h>
 
 #include "ws2812b.h"
 #include "ws2812b_fx.h"
+#include "ws2812b_matrix.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)<(b))?(b):(a))
 
-#define SEGMENT_LENGTH   (Ws28b12b_Segments[mActualSegment].IdStop - Ws28b12b_Segments[mActualSegment].IdStart + 1)
-#define IS_REVERSE		Ws28b12b_Segments[mActualSegment].Reverse
+#define SEGMENT_LENGTH   (mSeg->IdStop - mSeg->IdStart + 1)
+#define IS_REVERSE		mSeg->Reverse
 
 uint8_t 	mRunning;
 uint8_t 	mTriggered;
@@ -31,9 +33,12 @@ uint16_t 	mSegments;
 uint32_t		mColor[NUM_COLORS];
 ws2812b_color	mColor_w[NUM_COLORS];
 
+int32_t			mTimeOffset;	// Shared time - HAL tick
+
 typedef struct ws2812bfx_s
 {
 	volatile uint32_t	ModeDelay;	// Segment SW timer counter
+	volatile uint8_t	Overdue;	// ms past ModeDelay end, taken from the next delay
 
 	uint16_t	IdStart;			// Start segment point
 	uint16_t	IdStop;				// End segment point
@@ -43,151 +48,163 @@ typedef struct ws2812bfx_s
 	uint8_t		Reverse : 1;		// Is reverted mode
 	uint32_t	CounterModeCall;	// Numbers of calls
 	uint32_t	CounterModeStep;	// Call step
+	uint32_t	Epoch;				// Shared time of step 0 for modes which take their step from time
 
 	uint16_t		Speed;			// Segment speed
 
 	uint32_t		ModeColor[NUM_COLORS];		// Mode color 32 bit representation
 	ws2812b_color	ModeColor_w[NUM_COLORS]; 	// Mode color struct representation
 
+	uint16_t	BaseHue;			// Cached HSV of ModeColor[0]
+	uint8_t		BaseSat;			//
+	uint8_t		BaseVal;			//
+	uint16_t	SatStepDelay;		// Cached Speed / BaseSat / 2
+	uint16_t	ValStepDelay;		// Cached Speed / BaseVal / 2
+
 	uint8_t 	AuxParam;			// Computing variable
 	uint16_t 	AuxParam16b;		// Computing variable
 	uint8_t 	Cycle : 1;			// Cycle variable
+	uint8_t		Palette;			// Palette for palette modes
+
+	uint16_t	TransitionTime;		// Crossfade time on mode change, 0 - instant
+	uint8_t		Transition;			// Active transition slot + 1, 0 - none
+
+	uint8_t		Brightness;			// Layer scale, 255 - full
+	uint8_t		Alpha;				// Layer opacity, 255 - opaque
+	uint8_t		Blend;				// Layer blend mode, ws2812b_blend
+	uint8_t		Layer;				// Layer slot + 1, 0 - draws straight on the strip
+
+	uint16_t	Link;				// Leader segment + 1, 0 - runs its own mode
+	uint8_t		LinkMode;			// fx_link
+	uint8_t		Frame;				// Counts draws, followers copy when it changes
+	uint8_t		LinkFrame;			// Leader's Frame copied last time
 
 	void 	(*mModeCallback)(void); // Sector mode callback
 } ws2812bfx_s;
 
 ws2812bfx_s *Ws28b12b_Segments = NULL;
+ws2812bfx_s *mSeg;	// State of the segment whose mode is running
+
+//
+//	Crossfade between old and new mode
+//	Both modes render into their own canvas and the canvases are blended into the strip.
+//	Canvases come from fixed pool of TRANSITION_SLOTS, so RAM usage doesn't depend on segments count.
+//
+typedef struct ws2812bfx_transition_s
+{
+	ws2812bfx_s			Old;			// Outgoing mode state
+	volatile uint16_t	TimeLeft;		// ms to the end of transition
+	uint16_t			Time;			// Whole transition time
+	volatile uint8_t	BlendDelay;		// ms to the next blended frame
+	uint8_t				Active : 1;		// Is slot in use
+
+	ws2812b_color		Canvas[2][TRANSITION_MAX_LEDS];	// 0 - old mode, 1 - new mode
+} ws2812bfx_transition_s;
+
+ws2812bfx_transition_s mTransition[TRANSITION_SLOTS];
+
+//
+//	Layers - segments with brightness, alpha or blend mode
+//	Plain segments draw straight on the strip. A layer draws on its own canvas which is then
+//	composited over the strip, in segment order after all plain segments. Strip under each layer
+//	is kept, so before anything draws again layers are peeled off in reverse order and modes
+//	below see their own pixels.
+//
+typedef struct ws2812bfx_layer_s
+{
+	uint16_t		IdStart;		// Span composited last time
+	uint16_t		Length;
+	uint8_t			Active : 1;		// Is slot in use
+
+	ws2812b_color	Canvas[2][LAYER_MAX_LEDS];	// 0 - strip under the layer, 1 - layer
+} ws2812bfx_layer_s;
+
+ws2812bfx_layer_s mLayer[LAYER_SLOTS];
+uint8_t mLayerDirty;	// Layer settings changed, composite even if nothing draws
 
 void (*mModeCallback)(void);
 
+static FX_STATUS layer_update(uint16_t Segment);
+
 
 /*
  *
  *  MODES
  *
  * */
-void
-strip_off(void),
-mode_static(void),
-mode_white_to_color(void),
-mode_black_to_color(void),
-mode_blink(void),
-mode_blink_rainbow(void),
-mode_strobe(void),
-mode_strobe_rainbow(void),
-mode_breath(void),
-mode_color_wipe(void),
-mode_color_wipe_inv(void),
-mode_color_wipe_rev(void),
-mode_color_wipe_rev_inv(void),
-mode_color_wipe_random(void),
-mode_color_sweep_random(void),
-mode_random_color(void),
-mode_single_dynamic(void),
-mode_multi_dynamic(void),
-mode_rainbow(void),
-mode_rainbow_cycle(void),
-mode_fade(void),
-mode_scan(void),
-mode_dual_scan(void),
-mode_theater_chase(void),
-mode_theater_chase_rainbow(void),
-mode_running_lights(void),
-mode_twinkle(void),
-mode_twinkle_random(void),
-mode_twinkle_fade(void),
-mode_twinkle_fade_random(void),
-mode_sparkle(void),
-mode_flash_sparkle(void),
-mode_hyper_sparkle(void),
-mode_multi_strobe(void),
-mode_chase_white(void),
-mode_chase_color(void),
-mode_chase_random(void),
-mode_chase_rainbow(void),
-mode_chase_flash(void),
-mode_chase_flash_random(void),
-mode_chase_rainbow_white(void),
-mode_chase_blackout(void),
-mode_chase_blackout_rainbow(void),
-mode_running_color(void),
-mode_running_red_blue(void),
-mode_running_random(void),
-mode_larson_scanner(void),
-mode_comet(void),
-mode_fireworks(void),
-mode_fireworks_random(void),
-mode_merry_christmas(void),
-mode_fire_flicker(void),
-mode_fire_flicker_soft(void),
-mode_fire_flicker_intense(void),
-mode_circus_combustus(void),
-mode_halloween(void),
-mode_bicolor_chase(void),
-mode_tricolor_chase(void),
-mode_icu(void)
-;
-
-void (*mMode[MODE_COUNT])(void) =
-{
-	mode_static,
-	mode_white_to_color,
-	mode_black_to_color,
-	mode_blink,
-	mode_blink_rainbow,
-	mode_strobe,
-	mode_strobe_rainbow,
-	mode_breath,
-	mode_color_wipe,
-	mode_color_wipe_inv,
-	mode_color_wipe_rev,
-	mode_color_wipe_rev_inv,
-	mode_color_wipe_random,
-	mode_color_sweep_random,
-	mode_random_color,
-    mode_single_dynamic,
-    mode_multi_dynamic,
-    mode_rainbow,
-    mode_rainbow_cycle,
-    mode_fade,
-    mode_scan,
-    mode_dual_scan,
-    mode_theater_chase,
-    mode_theater_chase_rainbow,
-    mode_running_lights,
-    mode_twinkle,
-    mode_twinkle_random,
-	mode_twinkle_fade,
-	mode_twinkle_fade_random,
-    mode_sparkle,
-    mode_flash_sparkle,
-    mode_hyper_sparkle,
-	mode_multi_strobe,
-    mode_chase_white,
-    mode_chase_color,
-    mode_chase_random,
-    mode_chase_rainbow,
-    mode_chase_flash,
-    mode_chase_flash_random,
-    mode_chase_rainbow_white,
-    mode_chase_blackout,
-    mode_chase_blackout_rainbow,
-    mode_running_color,
-    mode_running_red_blue,
-    mode_running_random,
-    mode_larson_scanner,
-    mode_comet,
-    mode_fireworks,
-    mode_fireworks_random,
-    mode_merry_christmas,
-    mode_fire_flicker,
-    mode_fire_flicker_soft,
-    mode_fire_flicker_intense,
-    mode_circus_combustus,
-    mode_halloween,
-    mode_bicolor_chase,
-    mode_tricolor_chase,
-    mode_icu
+void strip_off(void);
+
+#define FX_MODE(Name, Function) void Function(void);
+#include "ws2812b_fx_modes.h"
+#undef FX_MODE
+
+void (* const mMode[MODE_COUNT])(void) =	// Flash, not RAM
+{
+#define FX_MODE(Name, Function) Function,
+#include "ws2812b_fx_modes.h"
+#undef FX_MODE
+};
+
+/*
+ *
+ *  PALETTES
+ *
+ *  16 entries each, colors between entries are linearly interpolated
+ *
+ * */
+static const ws2812b_color mPaletteRainbow[PALETTE_SIZE] = {
+	{0xFF,0x00,0x00}, {0xD5,0x2A,0x00}, {0xAB,0x55,0x00}, {0xAB,0x7F,0x00},
+	{0xAB,0xAB,0x00}, {0x56,0xD5,0x00}, {0x00,0xFF,0x00}, {0x00,0xD5,0x2A},
+	{0x00,0xAB,0x55}, {0x00,0x56,0xAA}, {0x00,0x00,0xFF}, {0x2A,0x00,0xD5},
+	{0x55,0x00,0xAB}, {0x7F,0x00,0x81}, {0xAB,0x00,0x55}, {0xD5,0x00,0x2B}
+};
+
+static const ws2812b_color mPaletteHeat[PALETTE_SIZE] = {
+	{0x00,0x00,0x00}, {0x33,0x00,0x00}, {0x66,0x00,0x00}, {0x99,0x00,0x00},
+	{0xCC,0x00,0x00}, {0xFF,0x00,0x00}, {0xFF,0x33,0x00}, {0xFF,0x66,0x00},
+	{0xFF,0x99,0x00}, {0xFF,0xCC,0x00}, {0xFF,0xFF,0x00}, {0xFF,0xFF,0x33},
+	{0xFF,0xFF,0x66}, {0xFF,0xFF,0x99}, {0xFF,0xFF,0xCC}, {0xFF,0xFF,0xFF}
+};
+
+static const ws2812b_color mPaletteOcean[PALETTE_SIZE] = {
+	{0x19,0x19,0x70}, {0x00,0x00,0x8B}, {0x19,0x19,0x70}, {0x00,0x00,0x80},
+	{0x00,0x00,0x8B}, {0x00,0x00,0xCD}, {0x2E,0x8B,0x57}, {0x00,0x80,0x80},
+	{0x5F,0x9E,0xA0}, {0x00,0x00,0xFF}, {0x00,0x8B,0x8B}, {0x64,0x95,0xED},
+	{0x7F,0xFF,0xD4}, {0x2E,0x8B,0x57}, {0x00,0xFF,0xFF}, {0x87,0xCE,0xFA}
+};
+
+static const ws2812b_color mPaletteForest[PALETTE_SIZE] = {
+	{0x00,0x64,0x00}, {0x00,0x64,0x00}, {0x55,0x6B,0x2F}, {0x00,0x64,0x00},
+	{0x00,0x80,0x00}, {0x22,0x8B,0x22}, {0x6B,0x8E,0x23}, {0x00,0x80,0x00},
+	{0x2E,0x8B,0x57}, {0x66,0xCD,0xAA}, {0x32,0xCD,0x32}, {0x9A,0xCD,0x32},
+	{0x90,0xEE,0x90}, {0x7C,0xFC,0x00}, {0x66,0xCD,0xAA}, {0x22,0x8B,0x22}
+};
+
+static const ws2812b_color mPaletteLava[PALETTE_SIZE] = {
+	{0x00,0x00,0x00}, {0x80,0x00,0x00}, {0x00,0x00,0x00}, {0x80,0x00,0x00},
+	{0x8B,0x00,0x00}, {0x80,0x00,0x00}, {0x8B,0x00,0x00}, {0x8B,0x00,0x00},
+	{0x8B,0x00,0x00}, {0xFF,0x00,0x00}, {0xFF,0xA5,0x00}, {0xFF,0xFF,0xFF},
+	{0xFF,0xA5,0x00}, {0xFF,0x00,0x00}, {0x8B,0x00,0x00}, {0x00,0x00,0x00}
+};
+
+static const ws2812b_color mPaletteParty[PALETTE_SIZE] = {
+	{0x55,0x00,0xAB}, {0x84,0x00,0x7C}, {0xB5,0x00,0x4B}, {0xE5,0x00,0x1B},
+	{0xE8,0x17,0x00}, {0xB8,0x47,0x00}, {0xAB,0x77,0x00}, {0xAB,0xAB,0x00},
+	{0xAB,0x55,0x00}, {0xDD,0x22,0x00}, {0xF2,0x00,0x0E}, {0xC2,0x00,0x3E},
+	{0x8F,0x00,0x71}, {0x5F,0x00,0xA1}, {0x2F,0x00,0xD0}, {0x00,0x07,0xF9}
+};
+
+ws2812b_color mPaletteUser[PALETTE_SIZE];	// Uploaded over USB
+
+static const ws2812b_color * const mPalette[PALETTE_COUNT] =
+{
+	mPaletteRainbow,
+	mPaletteHeat,
+	mPaletteOcean,
+	mPaletteForest,
+	mPaletteLava,
+	mPaletteParty,
+	mPaletteUser
 };
 
 FX_STATUS WS2812BFX_Init(uint16_t Segments)
@@ -215,7 +232,11 @@ FX_STATUS WS2812BFX_Init(uint16_t Segments)
 		for(uint16_t i = 0; i < mSegments; i++)
 		{
 			SegmentsTmp[i].Speed = DEFAULT_SPEED;
-			SegmentsTmp[i].Running = DEFAULT_MODE;
+			SegmentsTmp[i].Running = 0;
+			SegmentsTmp[i].ActualMode = DEFAULT_MODE;
+			SegmentsTmp[i].mModeCallback = mMode[DEFAULT_MODE];	// Start before SetMode must not call NULL
+			SegmentsTmp[i].Brightness = 255;
+			SegmentsTmp[i].Alpha = 255;
 
 			SegmentsTmp[i].IdStart = div;
 			div += ((WS2812B_LEDS + 1) / Segments) - 1;
@@ -233,7 +254,7 @@ FX_STATUS WS2812BFX_Init(uint16_t Segments)
 			SegmentsTmp[i].IdStart = div;
 			div += ((WS2812B_LEDS + 1) / Segments) - 1;
 			SegmentsTmp[i].IdStop = div;
-			if(SegmentsTmp[i].IdStop >= WS2812B_LEDS) Ws28b12b_Segments[i].IdStop = WS2812B_LEDS - 1;
+			if(SegmentsTmp[i].IdStop >= WS2812B_LEDS) SegmentsTmp[i].IdStop = WS2812B_LEDS - 1;
 			div++;
 
 			SegmentsTmp[i].Running = Ws28b12b_Segments[i].Running;
@@ -241,34 +262,78 @@ FX_STATUS WS2812BFX_Init(uint16_t Segments)
 			SegmentsTmp[i].Reverse = Ws28b12b_Segments[i].Reverse;
 			SegmentsTmp[i].CounterModeCall = Ws28b12b_Segments[i].CounterModeCall;
 			SegmentsTmp[i].CounterModeStep = Ws28b12b_Segments[i].CounterModeStep;
+			SegmentsTmp[i].Epoch = Ws28b12b_Segments[i].Epoch;
 			SegmentsTmp[i].Speed = Ws28b12b_Segments[i].Speed;
 			for(uint8_t j = 0; j < NUM_COLORS; j++)
 			{
 				SegmentsTmp[i].ModeColor[j] = Ws28b12b_Segments[i].ModeColor[j];
 				SegmentsTmp[i].ModeColor_w[j] = Ws28b12b_Segments[i].ModeColor_w[j];
 			}
+			SegmentsTmp[i].BaseHue = Ws28b12b_Segments[i].BaseHue;
+			SegmentsTmp[i].BaseSat = Ws28b12b_Segments[i].BaseSat;
+			SegmentsTmp[i].BaseVal = Ws28b12b_Segments[i].BaseVal;
+			SegmentsTmp[i].SatStepDelay = Ws28b12b_Segments[i].SatStepDelay;
+			SegmentsTmp[i].ValStepDelay = Ws28b12b_Segments[i].ValStepDelay;
 			SegmentsTmp[i].AuxParam = Ws28b12b_Segments[i].AuxParam;
 			SegmentsTmp[i].AuxParam16b = Ws28b12b_Segments[i].AuxParam16b;
+			SegmentsTmp[i].Palette = Ws28b12b_Segments[i].Palette;
+			SegmentsTmp[i].TransitionTime = Ws28b12b_Segments[i].TransitionTime;
 			SegmentsTmp[i].Cycle = Ws28b12b_Segments[i].Cycle;
 			SegmentsTmp[i].mModeCallback = Ws28b12b_Segments[i].mModeCallback;
+			SegmentsTmp[i].Brightness = Ws28b12b_Segments[i].Brightness;
+			SegmentsTmp[i].Alpha = Ws28b12b_Segments[i].Alpha;
+			SegmentsTmp[i].Blend = Ws28b12b_Segments[i].Blend;
+			if(Ws28b12b_Segments[i].Link <= Segments) // Leader still exists
+			{
+				SegmentsTmp[i].Link = Ws28b12b_Segments[i].Link;
+				SegmentsTmp[i].LinkMode = Ws28b12b_Segments[i].LinkMode;
+			}
 		}
 
-		if(Segments > mSegments) // Add new Segment
+		for(uint16_t i = mSegments; i < Segments; i++) // Add new Segments
 		{
-			SegmentsTmp[Segments - 1].Speed = DEFAULT_SPEED;
-			SegmentsTmp[Segments - 1].ActualMode = DEFAULT_MODE;
-			SegmentsTmp[Segments - 1].Running = 0; // Sany new segment is stopped by default
+			SegmentsTmp[i].Speed = DEFAULT_SPEED;
+			SegmentsTmp[i].ActualMode = DEFAULT_MODE;
+			SegmentsTmp[i].mModeCallback = mMode[DEFAULT_MODE];
+			SegmentsTmp[i].Running = 0; // Any new segment is stopped by default
+			SegmentsTmp[i].Brightness = 255;
+			SegmentsTmp[i].Alpha = 255;
 
-			SegmentsTmp[Segments - 1].IdStart = div;
+			SegmentsTmp[i].IdStart = div;
 			div += ((WS2812B_LEDS + 1) / Segments) - 1;
-			SegmentsTmp[Segments - 1].IdStop = WS2812B_LEDS - 1;
+			SegmentsTmp[i].IdStop = (i == Segments - 1) ? (WS2812B_LEDS - 1) : div;
+			div++;
 		}
 
 		mSegments = Segments;
 	}
 
+	for(uint8_t i = 0; i < TRANSITION_SLOTS; i++) // Layout changed, finish all crossfades
+	{
+		mTransition[i].Active = 0;
+	}
+
+	for(uint8_t i = 0; i < LAYER_SLOTS; i++) // Layers are taken again for the new layout
+	{
+		mLayer[i].Active = 0;
+	}
+
 	free(Ws28b12b_Segments);	// Free previous array if reinit
 	Ws28b12b_Segments = SegmentsTmp;
+
+	for(uint16_t i = 0; i < mSegments; i++)
+	{
+		if(layer_update(i) != FX_OK) // Out of slots - segment goes back to plain
+		{
+			Ws28b12b_Segments[i].Brightness = 255;
+			Ws28b12b_Segments[i].Alpha = 255;
+			Ws28b12b_Segments[i].Blend = WS2812B_BLEND_NORMAL;
+		}
+		if(Ws28b12b_Segments[i].Link) // Spans moved, copy again
+		{
+			Ws28b12b_Segments[i].LinkFrame = Ws28b12b_Segments[Ws28b12b_Segments[i].Link - 1].Frame - 1;
+		}
+	}
 	return FX_OK;
 }
 
@@ -294,55 +359,639 @@ FX_STATUS WS2812BFX_SegmentDecrease(void)
 		WS2812BFX_Init(mSegments - 1);
 	 return FX_OK;
 	}
-	return FX_ERROR;
-}
+	return FX_ERROR;
+}
+
+void WS2812BFX_SysTickCallback(void)
+{
+	for(uint16_t i = 0; i < mSegments; i++)
+	{
+		if(Ws28b12b_Segments[i].ModeDelay > 0) Ws28b12b_Segments[i].ModeDelay--;
+		else if(Ws28b12b_Segments[i].Overdue < 0xFF) Ws28b12b_Segments[i].Overdue++;
+	}
+
+	for(uint8_t i = 0; i < TRANSITION_SLOTS; i++)
+	{
+		if(mTransition[i].Active)
+		{
+			if(mTransition[i].Old.ModeDelay > 0) mTransition[i].Old.ModeDelay--;
+			if(mTransition[i].TimeLeft > 0) mTransition[i].TimeLeft--;
+			if(mTransition[i].BlendDelay > 0) mTransition[i].BlendDelay--;
+		}
+	}
+}
+
+//
+//	Start crossfade from actual Segment state
+//	Falls back to instant change when segment is too long or there is no free slot
+//
+static void transition_start(uint16_t Segment)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+	uint16_t Length = Seg->IdStop - Seg->IdStart + 1;
+	ws2812bfx_transition_s *T = NULL;
+
+	if(Seg->TransitionTime == 0 || !Seg->Running || Seg->mModeCallback == NULL) return;
+	if(Length > TRANSITION_MAX_LEDS) return;
+
+	if(Seg->Transition) // Restart - actual new mode becomes the old one
+	{
+		T = &mTransition[Seg->Transition - 1];
+		memcpy(T->Canvas[0], T->Canvas[1], Length * sizeof(ws2812b_color));
+	}
+	else
+	{
+		for(uint8_t i = 0; i < TRANSITION_SLOTS; i++)
+		{
+			if(!mTransition[i].Active)
+			{
+				T = &mTransition[i];
+				Seg->Transition = i + 1;
+				break;
+			}
+		}
+		if(T == NULL) return;
+
+		WS2812B_GetSpan(Seg->IdStart, Length, T->Canvas[0]);
+		WS2812B_GetSpan(Seg->IdStart, Length, T->Canvas[1]);
+	}
+
+	T->Old = *Seg;
+	T->Old.Transition = 0;
+	T->Time = Seg->TransitionTime;
+	T->TimeLeft = Seg->TransitionTime;
+	T->BlendDelay = 0;
+	T->Active = 1;
+}
+
+//
+//	One mode call with given state - segment's own or outgoing mode of a transition.
+//	Matrix writes are clipped to the segment, as 1D modes only draw inside it.
+//
+static void mode_run(uint16_t Segment, ws2812bfx_s *State)
+{
+	mActualSegment = Segment;
+	mSeg = State;
+	WS2812B_MatrixClip(State->IdStart, State->IdStop);
+	State->mModeCallback();
+	WS2812B_MatrixClip(0, WS2812B_LEDS - 1);
+	State->CounterModeCall++;
+}
+
+//
+//	Run one mode of transition on its own canvas
+//
+static void transition_render(uint16_t Segment, ws2812bfx_s *State, ws2812b_color *Canvas)
+{
+	uint16_t Length = State->IdStop - State->IdStart + 1;
+
+	WS2812B_SetSpan(State->IdStart, Length, Canvas);
+	mode_run(Segment, State);
+	WS2812B_GetSpan(State->IdStart, Length, Canvas);
+}
+
+//
+//	Transition callback, returns 1 if strip needs refresh
+//
+static uint8_t transition_callback(uint16_t Segment)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+	ws2812bfx_transition_s *T = &mTransition[Seg->Transition - 1];
+	uint16_t Length = Seg->IdStop - Seg->IdStart + 1;
+	uint8_t Render = 0;
+
+	if(T->Old.IdStart != Seg->IdStart || T->Old.IdStop != Seg->IdStop) // Segment resized, drop old mode
+	{
+		T->Active = 0;
+		Seg->Transition = 0;
+		return 0;
+	}
+
+	if(T->TimeLeft == 0) // Finished, new mode continues on the strip
+	{
+		WS2812B_SetSpan(Seg->IdStart, Length, T->Canvas[1]);
+		T->Active = 0;
+		Seg->Transition = 0;
+		return 1;
+	}
+
+	if(T->Old.ModeDelay == 0) // Old mode runs on its own state, SysTick keeps counting both
+	{
+		transition_render(Segment, &T->Old, T->Canvas[0]);
+		Render = 1;
+	}
+
+	if(Seg->ModeDelay == 0)
+	{
+		transition_render(Segment, Seg, T->Canvas[1]);
+		Render = 1;
+	}
+
+	if(Render || T->BlendDelay == 0)
+	{
+		uint16_t amount = 256 - (((uint32_t)T->TimeLeft << 8) / T->Time);
+		WS2812B_BlendSpan(Seg->IdStart, Length, T->Canvas[0], T->Canvas[1], amount);
+		T->BlendDelay = TRANSITION_FRAME;
+		return 1;
+	}
+	return 0;
+}
+
+//
+//	Keeps mode calls on their schedule regardless of main loop jitter -
+//	new delay set by the mode counts from when the call was due, not when it ran.
+//	Catch-up is limited to 255 ms of lateness.
+//
+static void schedule_shift(uint16_t Segment, int32_t Late)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+
+	__disable_irq();
+	Late += Seg->Overdue;
+	Seg->Overdue = 0;
+	if(Late < 0)
+	{
+		Seg->ModeDelay -= Late;
+	}
+	else if(Seg->ModeDelay > (uint32_t)Late)
+	{
+		Seg->ModeDelay -= Late;
+	}
+	else
+	{
+		Late -= Seg->ModeDelay;
+		Seg->Overdue = (Late > 0xFF) ? 0xFF : Late;
+		Seg->ModeDelay = 0;
+	}
+	__enable_irq();
+}
+
+static void schedule_late(uint16_t Segment)
+{
+	schedule_shift(Segment, 0);
+}
+
+//
+//	Step of a periodic mode - (shared time - Epoch) / Speed, so boards with the same
+//	shared time show the same step however their main loops ran. Next call is set on
+//	the next step boundary, lateness is already counted in.
+//
+static uint32_t time_step(void)
+{
+	int32_t Elapsed = WS2812BFX_GetTime() - mSeg->Epoch;
+
+	if(Elapsed < 0) Elapsed = 0;	// Restart on a SYNC_PERIOD boundary still ahead
+
+	__disable_irq();
+	mSeg->ModeDelay = mSeg->Speed - (Elapsed % mSeg->Speed);
+	mSeg->Overdue = 0;
+	__enable_irq();
+	return Elapsed / mSeg->Speed;
+}
+
+//
+//	Follower takes leader's latest pixels, returns 1 if strip needs refresh.
+//	These are leader's mode output - a layer leader keeps them in its canvas, before brightness
+//	and alpha, so follower's own layer settings apply to them the same way.
+//
+static uint8_t link_callback(uint16_t Segment)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+	ws2812bfx_s *Leader = &Ws28b12b_Segments[Seg->Link - 1];
+	uint16_t Length = Seg->IdStop - Seg->IdStart + 1;
+	uint16_t Source = Leader->IdStop - Leader->IdStart + 1;
+	ws2812b_color Pixels[WS2812B_LEDS];
+
+	if(Leader->Frame == Seg->LinkFrame) return 0;
+	Seg->LinkFrame = Leader->Frame;
+
+	if(Leader->Layer)
+	{
+		ws2812bfx_layer_s *L = &mLayer[Leader->Layer - 1];
+
+		if(Source > L->Length) Source = L->Length;
+		memcpy(Pixels, L->Canvas[1], Source * sizeof(ws2812b_color));
+	}
+	else
+	{
+		WS2812B_GetSpan(Leader->IdStart, Source, Pixels);
+	}
+
+	switch(Seg->LinkMode)
+	{
+	case FX_LINK_COPY:
+		WS2812B_SetSpan(Seg->IdStart, (Length < Source) ? Length : Source, Pixels);
+		break;
+
+	case FX_LINK_REVERSE:	// Longer follower keeps leader's end at its own end
+		if(Length > Source)
+		{
+			WS2812B_SetSpan(Seg->IdStart + Length - Source, Source, Pixels);
+			WS2812B_CopySpanReverse(Seg->IdStart + Length - Source, Seg->IdStart + Length - Source, Source);
+		}
+		else
+		{
+			WS2812B_SetSpan(Seg->IdStart, Length, Pixels);
+			WS2812B_CopySpanReverse(Seg->IdStart, Seg->IdStart, Length);
+		}
+		break;
+
+	case FX_LINK_MIRROR:	// First half from the leader, second one is the first reversed
+	{
+		uint16_t Half = Length - Length / 2;	// With the middle diode
+		uint16_t Count = (Half < Source) ? Half : Source;
+
+		WS2812B_SetSpan(Seg->IdStart, Count, Pixels);
+		if(Count > Length / 2) Count = Length / 2;
+		WS2812B_CopySpanReverse(Seg->IdStart + Length - Count, Seg->IdStart, Count);
+		break;
+	}
+	}
+	return 1;
+}
+
+//
+//	Runs segment's mode or transition if its time came, returns 1 if strip needs refresh
+//
+static uint8_t segment_callback(uint16_t Segment)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+	uint8_t Drawn = 0;
+
+	if(Seg->Link)
+	{
+		Drawn = link_callback(Segment);
+	}
+	else if(Seg->Transition && Seg->Running)
+	{
+		Drawn = transition_callback(Segment);
+	}
+	else if(Seg->ModeDelay == 0 && Seg->Running)
+	{
+		mode_run(Segment, Seg);
+		schedule_late(Segment);
+		Drawn = 1;
+	}
+	Seg->Frame += Drawn;
+	return Drawn;
+}
+
+//
+//	Would segment_callback do anything now
+//
+static uint8_t segment_due(uint16_t Segment)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+
+	if(Seg->Link) return Ws28b12b_Segments[Seg->Link - 1].Frame != Seg->LinkFrame;
+	if(!Seg->Running) return 0;
+	if(Seg->Transition)
+	{
+		ws2812bfx_transition_s *T = &mTransition[Seg->Transition - 1];
+
+		return T->TimeLeft == 0 || T->Old.ModeDelay == 0 || Seg->ModeDelay == 0 || T->BlendDelay == 0 ||
+				T->Old.IdStart != Seg->IdStart || T->Old.IdStop != Seg->IdStop;
+	}
+	return Seg->ModeDelay == 0;
+}
+
+//
+//	Pixels of a layer's canvases still inside its segment - the segment may be resized
+//	after the last composite, canvases hold L->Length pixels
+//
+static uint16_t layer_length(ws2812bfx_s *Seg, ws2812bfx_layer_s *L)
+{
+	uint16_t Length = Seg->IdStop - Seg->IdStart + 1;
+
+	return (Length < L->Length) ? Length : L->Length;
+}
+
+//
+//	Take or give back layer slot after segment's layer settings changed
+//
+static FX_STATUS layer_update(uint16_t Segment)
+{
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+	uint16_t Length = Seg->IdStop - Seg->IdStart + 1;
+	uint8_t Needed = (Seg->Brightness != 255) || (Seg->Alpha != 255) || (Seg->Blend != WS2812B_BLEND_NORMAL);
+
+	mLayerDirty = 1;
+
+	if(!Needed && Seg->Layer) // Back to drawing straight on the strip, with its latest pixels
+	{
+		ws2812bfx_layer_s *L = &mLayer[Seg->Layer - 1];
+		uint16_t Kept = layer_length(Seg, L);
+
+		WS2812B_SetSpan(Seg->IdStart, Kept, L->Canvas[1]);
+		WS2812B_FillSpan(Seg->IdStart + Kept, Length - Kept, 0);	// Grown since the last frame, mode draws it next
+		L->Active = 0;
+		Seg->Layer = 0;
+	}
+	else if(Needed && !Seg->Layer)
+	{
+		if(Length > LAYER_MAX_LEDS) return FX_ERROR;
+
+		for(uint8_t i = 0; i < LAYER_SLOTS; i++)
+		{
+			if(!mLayer[i].Active)
+			{
+				ws2812bfx_layer_s *L = &mLayer[i];
+
+				memset(L->Canvas[0], 0, sizeof(L->Canvas[0]));	// Nothing under until the next frame
+				WS2812B_GetSpan(Seg->IdStart, Length, L->Canvas[1]);
+				L->IdStart = Seg->IdStart;
+				L->Length = Length;
+				L->Active = 1;
+				Seg->Layer = i + 1;
+				return FX_OK;
+			}
+		}
+		return FX_ERROR;
+	}
+	return FX_OK;
+}
+
+//
+//	Peel layers off the strip if anything is going to draw. Returns 1 if layers need compositing.
+//
+static uint8_t layer_restore(void)
+{
+	uint8_t Due = mLayerDirty;
+	uint8_t Active = 0;
+
+	for(uint8_t i = 0; i < LAYER_SLOTS; i++)
+	{
+		Active |= mLayer[i].Active;
+	}
+	if(!Active) // Plain strip, nothing to peel off
+	{
+		mLayerDirty = 0;
+		return 0;
+	}
+
+	for(uint16_t i = 0; i < mSegments && !Due; i++)
+	{
+		if(segment_due(i)) Due = 1;
+	}
+	if(!Due) return 0;
+
+	mLayerDirty = 0;
+	for(uint16_t i = mSegments; i-- > 0;)
+	{
+		if(Ws28b12b_Segments[i].Layer)
+		{
+			ws2812bfx_layer_s *L = &mLayer[Ws28b12b_Segments[i].Layer - 1];
+			WS2812B_SetSpan(L->IdStart, layer_length(&Ws28b12b_Segments[i], L), L->Canvas[0]);	// Shrunk - leave the rest to its new owner
+		}
+	}
+	return 1;
+}
+
+//
+//	Draw every layer on its canvas and composite it over the strip
+//
+static void layer_composite(void)
+{
+	for(uint16_t i = 0; i < mSegments; i++)
+	{
+		ws2812bfx_s *Seg = &Ws28b12b_Segments[i];
+		if(!Seg->Layer) continue;
+
+		ws2812bfx_layer_s *L = &mLayer[Seg->Layer - 1];
+		uint16_t Length = Seg->IdStop - Seg->IdStart + 1;
+
+		if(Length > LAYER_MAX_LEDS) Length = LAYER_MAX_LEDS;	// Resized after it became a layer, tail stays plain
+
+		if(L->IdStart != Seg->IdStart || L->Length != Length) // Resized, mode draws it again
+		{
+			memset(L->Canvas[1], 0, sizeof(L->Canvas[1]));
+			L->IdStart = Seg->IdStart;
+			L->Length = Length;
+		}
+
+		WS2812B_GetSpan(Seg->IdStart, Length, L->Canvas[0]);
+		WS2812B_SetSpan(Seg->IdStart, Length, L->Canvas[1]);
+		segment_callback(i);
+		WS2812B_GetSpan(Seg->IdStart, Length, L->Canvas[1]);
+		WS2812B_CompositeSpan(Seg->IdStart, Length, L->Canvas[0], L->Canvas[1],	// 0..255 -> 0..256, both ends exact
+				Seg->Brightness + (Seg->Brightness >> 7), Seg->Alpha + (Seg->Alpha >> 7), Seg->Blend);
+	}
+}
+
+void WS2812BFX_Callback()
+ {
+	static uint8_t trig = 0;;
+  if(mRunning || mTriggered)
+  {
+	  uint8_t Composite = layer_restore();
+
+	  for(uint16_t i = 0; i < mSegments; i++)
+	  {
+		  if(!Ws28b12b_Segments[i].Layer && segment_callback(i)) trig = 1;
+	  }
+	  if(Composite)
+	  {
+		  layer_composite();
+		  trig = 1;
+	  }
+	  if(trig)
+	  {
+		  WS2812B_Refresh();
+		  trig = 0;
+	  }
+  }
+}
+
+//
+//	Shared time
+//	Boards given the same time run running segments on the same schedule.
+//	Small corrections shift the schedules, bigger ones restart segments on the next
+//	SYNC_PERIOD boundary of shared time with rand() seeded from it. That boundary is
+//	the segment's epoch - periodic modes take their step from it (time_step), so they
+//	come back in phase after a stalled main loop or a late correction.
+//
+uint32_t WS2812BFX_GetTime(void)
+{
+	return HAL_GetTick() + mTimeOffset;
+}
+
+void WS2812BFX_SetTime(uint32_t Time)
+{
+	int32_t Delta = Time - WS2812BFX_GetTime();
+
+	mTimeOffset = Time - HAL_GetTick();
+
+	if(Delta >= -SYNC_SLEW_MAX && Delta <= SYNC_SLEW_MAX)
+	{
+		for(uint16_t i = 0; i < mSegments; i++)
+			schedule_shift(i, Delta);
+		return;
+	}
+
+	srand(Time / SYNC_PERIOD + 1);
+	for(uint16_t i = 0; i < mSegments; i++)
+	{
+		if(!Ws28b12b_Segments[i].Running) continue;
+		__disable_irq();
+		Ws28b12b_Segments[i].CounterModeCall = 0;
+		Ws28b12b_Segments[i].CounterModeStep = 0;
+		Ws28b12b_Segments[i].Overdue = 0;
+		Ws28b12b_Segments[i].ModeDelay = SYNC_PERIOD - (Time % SYNC_PERIOD);
+		Ws28b12b_Segments[i].Epoch = Time + Ws28b12b_Segments[i].ModeDelay;
+		__enable_irq();
+	}
+}
+
+//
+//	Derived parameters cache
+//	Recomputed only when segment colors or speed change, so modes don't redo color space math every frame
+//
+static void update_derived_colors(uint16_t Segment)
+{
+	WS2812B_RGBtoHSV(Ws28b12b_Segments[Segment].ModeColor_w[0].red, Ws28b12b_Segments[Segment].ModeColor_w[0].green, Ws28b12b_Segments[Segment].ModeColor_w[0].blue,
+			&Ws28b12b_Segments[Segment].BaseHue, &Ws28b12b_Segments[Segment].BaseSat, &Ws28b12b_Segments[Segment].BaseVal);
+}
+
+static void update_derived_delays(uint16_t Segment)
+{
+	uint16_t Speed = Ws28b12b_Segments[Segment].Speed;
+
+	// Zero divisor gives zero delay the same way as Cortex-M3 udiv does
+	Ws28b12b_Segments[Segment].SatStepDelay = Ws28b12b_Segments[Segment].BaseSat ? (Speed / Ws28b12b_Segments[Segment].BaseSat / 2) : 0;
+	Ws28b12b_Segments[Segment].ValStepDelay = Ws28b12b_Segments[Segment].BaseVal ? (Speed / Ws28b12b_Segments[Segment].BaseVal / 2) : 0;
+}
+
+FX_STATUS WS2812BFX_SetMode(uint16_t Segment, fx_mode Mode)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	if(Mode >= MODE_COUNT) return FX_ERROR;	// mMode[] index
+	transition_start(Segment);
+	Ws28b12b_Segments[Segment].CounterModeCall = 0;
+	Ws28b12b_Segments[Segment].CounterModeStep = 0;
+	Ws28b12b_Segments[Segment].Epoch = WS2812BFX_GetTime();
+	Ws28b12b_Segments[Segment].ActualMode = Mode;
+	Ws28b12b_Segments[Segment].mModeCallback = mMode[Mode];
+	for(uint8_t i = 0; i < NUM_COLORS; i++)
+	{
+		Ws28b12b_Segments[Segment].ModeColor[i] = mColor[i];
+		Ws28b12b_Segments[Segment].ModeColor_w[i].red = mColor_w[i].red;
+		Ws28b12b_Segments[Segment].ModeColor_w[i].green = mColor_w[i].green;
+		Ws28b12b_Segments[Segment].ModeColor_w[i].blue = mColor_w[i].blue;
+	}
+	update_derived_colors(Segment);
+	update_derived_delays(Segment);
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_SetTransition(uint16_t Segment, uint16_t Time)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	Ws28b12b_Segments[Segment].TransitionTime = Time;
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_GetTransition(uint16_t Segment, uint16_t *Time)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	*Time = Ws28b12b_Segments[Segment].TransitionTime;
+	return FX_OK;
+}
+
+//
+//	Layer settings - any of brightness < 255, alpha < 255 or blend other than normal
+//	makes segment a layer. Fails when all LAYER_SLOTS are taken.
+//
+FX_STATUS WS2812BFX_SetLayer(uint16_t Segment, uint8_t Brightness, uint8_t Alpha, ws2812b_blend Blend)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	if(Blend >= WS2812B_BLEND_COUNT) return FX_ERROR;
+
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+	ws2812bfx_s Old = *Seg;
+
+	Seg->Brightness = Brightness;
+	Seg->Alpha = Alpha;
+	Seg->Blend = Blend;
+	if(layer_update(Segment) != FX_OK)
+	{
+		Seg->Brightness = Old.Brightness;
+		Seg->Alpha = Old.Alpha;
+		Seg->Blend = Old.Blend;
+		return FX_ERROR;
+	}
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_GetLayer(uint16_t Segment, uint8_t *Brightness, uint8_t *Alpha, ws2812b_blend *Blend)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	*Brightness = Ws28b12b_Segments[Segment].Brightness;
+	*Alpha = Ws28b12b_Segments[Segment].Alpha;
+	*Blend = Ws28b12b_Segments[Segment].Blend;
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_SetBrightness(uint16_t Segment, uint8_t Brightness)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	return WS2812BFX_SetLayer(Segment, Brightness, Ws28b12b_Segments[Segment].Alpha, Ws28b12b_Segments[Segment].Blend);
+}
+
+FX_STATUS WS2812BFX_SetAlpha(uint16_t Segment, uint8_t Alpha)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	return WS2812BFX_SetLayer(Segment, Ws28b12b_Segments[Segment].Brightness, Alpha, Ws28b12b_Segments[Segment].Blend);
+}
+
+FX_STATUS WS2812BFX_SetBlend(uint16_t Segment, ws2812b_blend Blend)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	return WS2812BFX_SetLayer(Segment, Ws28b12b_Segments[Segment].Brightness, Ws28b12b_Segments[Segment].Alpha, Blend);
+}
+
+//
+//	Segment links - follower copies leader's pixels every time the leader draws, so both stay
+//	in phase and the mode runs once. Follower's own mode, speed and running state are not used
+//	until FX_LINK_NONE. Leader can't follow another segment and follower can't lead.
+//	Copy takes as many diodes as the shorter of both spans.
+//
+FX_STATUS WS2812BFX_SetLink(uint16_t Segment, uint16_t Leader, fx_link Link)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	if(Link >= FX_LINK_COUNT) return FX_ERROR;
+
+	ws2812bfx_s *Seg = &Ws28b12b_Segments[Segment];
+
+	if(Link == FX_LINK_NONE)
+	{
+		Seg->Link = 0;
+		Seg->LinkMode = FX_LINK_NONE;
+		return FX_OK;
+	}
 
-void WS2812BFX_SysTickCallback(void)
-{
+	if(Leader >= mSegments || Leader == Segment) return FX_ERROR;
+	if(Ws28b12b_Segments[Leader].Link) return FX_ERROR;
 	for(uint16_t i = 0; i < mSegments; i++)
-		if(Ws28b12b_Segments[i].ModeDelay > 0) Ws28b12b_Segments[i].ModeDelay--;
-}
+	{
+		if(Ws28b12b_Segments[i].Link == Segment + 1) return FX_ERROR;
+	}
 
-void WS2812BFX_Callback()
- {
-	static uint8_t trig = 0;;
-  if(mRunning || mTriggered)
-  {
-	  for(uint16_t i = 0; i < mSegments; i++)
-	  {
-		  if(Ws28b12b_Segments[i].ModeDelay == 0)
-		  {
-			  if(Ws28b12b_Segments[i].Running)
-			  {
-				  mActualSegment = i;
-				  Ws28b12b_Segments[i].mModeCallback();
-				  Ws28b12b_Segments[i].CounterModeCall++;
-				  trig = 1;
-			  }
-		  }
-	  }
-	  if(trig)
-	  {
-		  WS2812B_Refresh();
-		  trig = 0;
-	  }
-  }
+	if(Seg->Transition) // Follower's crossfade would never end
+	{
+		mTransition[Seg->Transition - 1].Active = 0;
+		Seg->Transition = 0;
+	}
+	Seg->Link = Leader + 1;
+	Seg->LinkMode = Link;
+	Seg->LinkFrame = Ws28b12b_Segments[Leader].Frame - 1;	// Copy on the next callback
+	return FX_OK;
 }
 
-FX_STATUS WS2812BFX_SetMode(uint16_t Segment, fx_mode Mode)
+FX_STATUS WS2812BFX_GetLink(uint16_t Segment, uint16_t *Leader, fx_link *Link)
 {
 	if(Segment >= mSegments) return FX_ERROR;
-	Ws28b12b_Segments[Segment].CounterModeCall = 0;
-	Ws28b12b_Segments[Segment].CounterModeStep = 0;
-	Ws28b12b_Segments[Segment].ActualMode = Mode;
-	Ws28b12b_Segments[Segment].mModeCallback = mMode[Mode];
-	for(uint8_t i = 0; i < NUM_COLORS; i++)
-	{
-		Ws28b12b_Segments[Segment].ModeColor[i] = mColor[i];
-		Ws28b12b_Segments[Segment].ModeColor_w[i].red = mColor_w[i].red;
-		Ws28b12b_Segments[Segment].ModeColor_w[i].green = mColor_w[i].green;
-		Ws28b12b_Segments[Segment].ModeColor_w[i].blue = mColor_w[i].blue;
-	}
+	*Leader = Ws28b12b_Segments[Segment].Link ? Ws28b12b_Segments[Segment].Link - 1 : Segment;
+	*Link = Ws28b12b_Segments[Segment].LinkMode;
 	return FX_OK;
 }
 
@@ -356,23 +1005,13 @@ FX_STATUS WS2812BFX_GetMode(uint16_t Segment, fx_mode *Mode)
 FX_STATUS WS2812BFX_NextMode(uint16_t Segment)
 {
 	if(Segment >= mSegments) return FX_ERROR;
-	Ws28b12b_Segments[Segment].CounterModeCall = 0;
-	Ws28b12b_Segments[Segment].CounterModeStep = 0;
-	Ws28b12b_Segments[Segment].ActualMode++;
-	if(Ws28b12b_Segments[Segment].ActualMode >= MODE_COUNT) Ws28b12b_Segments[mActualSegment].ActualMode = 0;
-	Ws28b12b_Segments[Segment].mModeCallback = mMode[Ws28b12b_Segments[mActualSegment].ActualMode];
-	return FX_OK;
+	return WS2812BFX_SetMode(Segment, (Ws28b12b_Segments[Segment].ActualMode + 1) % MODE_COUNT);
 }
 
 FX_STATUS WS2812BFX_PrevMode(uint16_t Segment)
 {
 	if(Segment >= mSegments) return FX_ERROR;
-	Ws28b12b_Segments[Segment].CounterModeCall = 0;
-	Ws28b12b_Segments[Segment].CounterModeStep = 0;
-	Ws28b12b_Segments[Segment].ActualMode--;
-	if(Ws28b12b_Segments[Segment].ActualMode == 0) Ws28b12b_Segments[mActualSegment].ActualMode = MODE_COUNT;
-	Ws28b12b_Segments[Segment].mModeCallback = mMode[Ws28b12b_Segments[mActualSegment].ActualMode];
-	return FX_OK;
+	return WS2812BFX_SetMode(Segment, (Ws28b12b_Segments[Segment].ActualMode + MODE_COUNT - 1) % MODE_COUNT);
 }
 
 FX_STATUS WS2812BFX_SetReverse(uint16_t Segment, uint8_t Reverse)
@@ -466,8 +1105,8 @@ FX_STATUS WS2812BFX_SegmentDecreaseEnd(uint16_t Segment)
 FX_STATUS WS2812BFX_SetSegmentSize(uint16_t Segment, uint16_t Start, uint16_t Stop)
 {
 	if(Segment >= mSegments) return FX_ERROR;
-	if(Start >= (WS2812B_LEDS - 1)) return FX_ERROR;
-	if(Stop >= (WS2812B_LEDS - 1)) return FX_ERROR;
+	if(Start >= WS2812B_LEDS) return FX_ERROR;
+	if(Stop >= WS2812B_LEDS) return FX_ERROR;
 	if(Start > Stop) return FX_ERROR;
 
 	WS2812BFX_SetAll(Segment, BLACK); // Set all 'old' segment black
@@ -490,7 +1129,9 @@ FX_STATUS WS2812BFX_Start(uint16_t Segment)
 	if(Segment >= mSegments) return FX_ERROR;
 	Ws28b12b_Segments[Segment].CounterModeCall = 0;
 	Ws28b12b_Segments[Segment].CounterModeStep = 0;
+	Ws28b12b_Segments[Segment].Epoch = WS2812BFX_GetTime();
 	Ws28b12b_Segments[Segment].ModeDelay = 0;
+	Ws28b12b_Segments[Segment].Overdue = 0;
 	Ws28b12b_Segments[Segment].Running = 1;
 	mRunning = 1;
 	return FX_OK;
@@ -526,6 +1167,7 @@ FX_STATUS WS2812BFX_IsRunning(uint16_t Segment, uint8_t *Running)
 
 void WS2812BFX_SetColorStruct(uint8_t id, ws2812b_color c)
 {
+	if(id >= NUM_COLORS) return;
 	mColor[id] = ((c.red<<16)|(c.green<<8)|c.blue);
 	mColor_w[id].red = c.red;
 	mColor_w[id].green = c.green;
@@ -534,6 +1176,7 @@ void WS2812BFX_SetColorStruct(uint8_t id, ws2812b_color c)
 
 void WS2812BFX_SetColorRGB(uint8_t id, uint8_t r, uint8_t g, uint8_t b)
 {
+	if(id >= NUM_COLORS) return;
 	mColor[id] = ((r<<16)|(g<<8)|b);
 	mColor_w[id].red = r;
 	mColor_w[id].green = g;
@@ -550,119 +1193,22 @@ FX_STATUS WS2812BFX_GetColorRGB(uint8_t id, uint8_t *r, uint8_t *g, uint8_t *b)
 	return FX_OK;
 }
 
-void WS2812BFX_RGBtoHSV(uint8_t r, uint8_t g, uint8_t b, uint16_t *h, uint8_t *s, uint8_t *v)
+FX_STATUS WS2812BFX_GetSegmentColor(uint16_t Segment, uint8_t id, uint32_t *c)
 {
-    uint16_t min, max, delta;
-    int16_t h_tmp = *h;
-
-    min = r < g ? r : g;
-    min = min  < b ? min : b;
-
-    max = r > g ? r : g;
-    max = max  > b ? max : b;
-
-    *v = max;	// v
-    delta = max - min;
-    if (delta < 1)
-    {
-        *s = 0;
-        *h = 0; // undefined, maybe nan?
-        return;
-    }
-    if( max > 0 )
-    { // NOTE: if Max is == 0, this divide would cause a crash
-        *s = (((delta * 100) / max) * 255) / 100; // s
-    }
-    else
-    {
-        // if max is 0, then r = g = b = 0
-        // s = 0, h is undefined
-        *s = 0;
-        *h = 0;                            // its now undefined
-        return;
-    }
-
-    if( r == max )
-    {
-    	h_tmp = (( g - b )*100) / delta;        // between yellow & magenta
-    											// *100 to avoid fracts
-    }
-    else
-    {
-		if( g == max )
-		{
-			h_tmp = 720 + (( b - r )*100) / delta;  // between cyan & yellow
-		}
-		else
-		{
-			h_tmp = 1440 + (( r - g )*100) / delta;  // between magenta & cyan
-		}
-    }
-    h_tmp *= 60; // Degrees
-    h_tmp /= 100; // Back from fracts
-
-    if( h_tmp < 0.0 )
-    	h_tmp += 360;
+	if(Segment >= mSegments) return FX_ERROR;
+	if(id >= NUM_COLORS) return FX_ERROR;
+	*c = Ws28b12b_Segments[Segment].ModeColor[id];
+	return FX_OK;
+}
 
-    *h = h_tmp;
+void WS2812BFX_RGBtoHSV(uint8_t r, uint8_t g, uint8_t b, uint16_t *h, uint8_t *s, uint8_t *v)
+{
+	WS2812B_RGBtoHSV(r, g, b, h, s, v);
 }
 
 void WS2812BFX_HSVtoRGB(uint16_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b)
 {
-	uint16_t Sector, Fracts, p, q, t;
-
-	if(s == 0)
-	{
-
-		*r = v;
-		*g = v;
-		*b = v;
-	}
-	else
-	{
-		if(h >= 360) h = 359;
-
-		Sector = h / 60; // Sector 0 to 5
-		Fracts = h % 60;
-		p = (v * (255 - s)) / 256;
-		q = (v * (255 - (s * Fracts)/60)) / 256;
-		t = (v * (255 - (s * (59 - Fracts))/60)) / 256;
-
-
-		switch(Sector)
-		{
-		case 0:
-			*r = v;
-			*g = (uint8_t)t;
-			*b = (uint8_t)p;
-			break;
-		case 1:
-			*r = (uint8_t)q;
-			*g = v;
-			*b = (uint8_t)p;
-			break;
-		case 2:
-			*r = (uint8_t)p;
-			*g = v;
-			*b = (uint8_t)t;
-			break;
-		case 3:
-			*r = (uint8_t)p;
-			*g = (uint8_t)q;
-			*b = v;
-			break;
-		case 4:
-			*r = (uint8_t)t;
-			*g = (uint8_t)p;
-			*b = v;
-			break;
-		default:		// case 5:
-			*r = v;
-			*g = (uint8_t)p;
-			*b = (uint8_t)q;
-			break;
-		}
-	}
+	WS2812B_HSVtoRGB(h, s, v, r, g, b);
 }
 
 //
@@ -674,35 +1220,76 @@ void WS2812BFX_HSVtoRGB(uint16_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g
 //
 void WS2812BFX_SetColorHSV(uint8_t id, uint16_t h, uint8_t s, uint8_t v)
 {
+	if(id >= NUM_COLORS) return;
 	WS2812BFX_HSVtoRGB(h, s, v, &mColor_w[id].red, &mColor_w[id].green, &mColor_w[id].blue);
 	mColor[id] = ((mColor_w[id].red<<16)|(mColor_w[id].green<<8)|mColor_w[id]. blue);
 }
 
 void WS2812BFX_SetColor(uint8_t id, uint32_t c)
 {
+	if(id >= NUM_COLORS) return;
 	mColor[id] = c;
 	mColor_w[id].red = ((c>>16)&0x000000FF);
 	mColor_w[id].green = ((c>>8)&0x000000FF);
 	mColor_w[id].blue = (c&0x000000FF);
 }
 
+FX_STATUS WS2812BFX_SetPalette(uint16_t Segment, uint8_t Palette)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	if(Palette >= PALETTE_COUNT) return FX_ERROR;
+	Ws28b12b_Segments[Segment].Palette = Palette;
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_GetPalette(uint16_t Segment, uint8_t *Palette)
+{
+	if(Segment >= mSegments) return FX_ERROR;
+	*Palette = Ws28b12b_Segments[Segment].Palette;
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_SetUserPaletteEntry(uint8_t id, uint32_t c)
+{
+	if(id >= PALETTE_SIZE) return FX_ERROR;
+	mPaletteUser[id].red = ((c>>16)&0x000000FF);
+	mPaletteUser[id].green = ((c>>8)&0x000000FF);
+	mPaletteUser[id].blue = (c&0x000000FF);
+	return FX_OK;
+}
+
+//
+//	Palette lookup
+//
+//	index 0-255, upper 4 bits select the entry, lower 4 bits blend toward the next one.
+//	Last entry blends back to the first, so palettes wrap around smoothly.
+//
+uint32_t WS2812BFX_ColorFromPalette(uint8_t Palette, uint8_t index)
+{
+	if(Palette >= PALETTE_COUNT) Palette = 0;
+
+	const ws2812b_color *c1 = &mPalette[Palette][index >> 4];
+	const ws2812b_color *c2 = &mPalette[Palette][((index >> 4) + 1) & (PALETTE_SIZE - 1)];
+	int16_t frac = index & 0x0F;
+
+	uint8_t r = c1->red + (((c2->red - c1->red) * frac) >> 4);
+	uint8_t g = c1->green + (((c2->green - c1->green) * frac) >> 4);
+	uint8_t b = c1->blue + (((c2->blue - c1->blue) * frac) >> 4);
+
+	return ((uint32_t)r << 16) | (g << 8) | b;
+}
+
 FX_STATUS WS2812BFX_SetAll(uint16_t Segment, uint32_t c)
 {
 	if(Segment >= mSegments) return FX_ERROR;
-	for(uint16_t i = 0; i < (Ws28b12b_Segments[Segment].IdStop - Ws28b12b_Segments[Segment].IdStart + 1); i++)
-	{
-		WS2812B_SetDiodeRGB(Ws28b12b_Segments[Segment].IdStart + i, ((c>>16)&0xFF), ((c>>8)&0xFF), (c&0xFF));
-	}
+	WS2812B_FillSpan(Ws28b12b_Segments[Segment].IdStart, Ws28b12b_Segments[Segment].IdStop - Ws28b12b_Segments[Segment].IdStart + 1, c);
 	return FX_OK;
 }
 
 FX_STATUS WS2812BFX_SetAllRGB(uint16_t Segment, uint8_t r, uint8_t g, uint8_t b)
 {
 	if(Segment >= mSegments) return FX_ERROR;
-	for(uint16_t i = 0; i < SEGMENT_LENGTH; i++)
-	{
-		WS2812B_SetDiodeRGB(Ws28b12b_Segments[Segment].IdStart + i, r, g, b);
-	}
+	WS2812B_FillSpan(Ws28b12b_Segments[Segment].IdStart, Ws28b12b_Segments[Segment].IdStop - Ws28b12b_Segments[Segment].IdStart + 1, ((uint32_t)r<<16)|(g<<8)|b);
 	return FX_OK;
 }
 
@@ -713,6 +1300,7 @@ FX_STATUS WS2812BFX_SetSpeed(uint16_t Segment, uint16_t Speed)
 	if(Speed > SPEED_MAX) Speed = SPEED_MAX;
 
 	Ws28b12b_Segments[Segment].Speed = Speed;
+	update_derived_delays(Segment);
 	return FX_OK;
 }
 
@@ -725,12 +1313,14 @@ FX_STATUS WS2812BFX_GetSpeed(uint16_t Segment, uint16_t *Speed)
 
 FX_STATUS WS2812BFX_IncreaseSpeed(uint16_t Segment, uint16_t Speed)
 {
-	return WS2812BFX_SetSpeed(Segment, Ws28b12b_Segments[mActualSegment].Speed + Speed);
+	if(Segment >= mSegments) return FX_ERROR;
+	return WS2812BFX_SetSpeed(Segment, Ws28b12b_Segments[Segment].Speed + Speed);
 }
 
 FX_STATUS WS2812BFX_DecreaseSpeed(uint16_t Segment, uint16_t Speed)
 {
-	return WS2812BFX_SetSpeed(Segment, Ws28b12b_Segments[mActualSegment].Speed - Speed);
+	if(Segment >= mSegments) return FX_ERROR;
+	return WS2812BFX_SetSpeed(Segment, Ws28b12b_Segments[Segment].Speed - Speed);
 }
 
 //
@@ -744,10 +1334,7 @@ FX_STATUS WS2812BFX_DecreaseSpeed(uint16_t Segment, uint16_t Speed)
  */
 void strip_off()
 {
-	for(uint16_t i = 0; i < WS2812B_LEDS; i++)
-	{
-		WS2812B_SetDiodeRGB(i, 0, 0, 0);
-	}
+	WS2812B_FillSpan(0, WS2812B_LEDS, BLACK);
 	WS2812B_Refresh();
 }
 
@@ -799,35 +1386,10 @@ void fade_out() {
   uint8_t rateH = rateMapH[rate];
   uint8_t rateL = rateMapL[rate];
 
-  uint32_t color = Ws28b12b_Segments[mActualSegment].ModeColor[1]; // target color
-
-  int r2 = (color >> 16) & 0xff;
-  int g2 = (color >>  8) & 0xff;
-  int b2 =  color        & 0xff;
-
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++) {
-
-    color = WS2812B_GetColor(i);
-    if(rate == 0) { // old fade-to-black algorithm
-    	WS2812B_SetDiodeColor(i, (color >> 1) & 0x7F7F7F7F);
-    } else { // new fade-to-color algorithm
-      int r1 = (color >> 16) & 0xff;
-      int g1 = (color >>  8) & 0xff;
-      int b1 =  color        & 0xff;
-
-      // calculate the color differences between the current and target colors
-      int rdelta = r2 - r1;
-      int gdelta = g2 - g1;
-      int bdelta = b2 - b1;
-
-      // if the current and target colors are almost the same, jump right to the target color,
-      // otherwise calculate an intermediate color. (fixes rounding issues)
-      rdelta = abs(rdelta) < 3 ? rdelta : (rdelta >> rateH) + (rdelta >> rateL);
-      gdelta = abs(gdelta) < 3 ? gdelta : (gdelta >> rateH) + (gdelta >> rateL);
-      bdelta = abs(bdelta) < 3 ? bdelta : (bdelta >> rateH) + (bdelta >> rateL);
-
-      WS2812B_SetDiodeRGB(i, r1 + rdelta, g1 + gdelta, b1 + bdelta);
-    }
+  if(rate == 0) { // old fade-to-black algorithm
+    WS2812B_ScaleSpan(mSeg->IdStart, SEGMENT_LENGTH, 128);
+  } else { // new fade-to-color algorithm, 4 diodes per 3 word operations
+    WS2812B_FadeSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[1], rateH, rateL);
   }
 }
 
@@ -857,16 +1419,22 @@ uint32_t color_blend(uint32_t color1, uint32_t color2, uint8_t blend)
   return ((w3 << 24) | (r3 << 16) | (g3 << 8) | (b3));
 }
 
+/*
+ * Packed color into a pixel of a span rendered before WS2812B_SetSpan
+ */
+static inline ws2812b_color span_pixel(uint32_t color)
+{
+  ws2812b_color c = { (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF };
+  return c;
+}
+
 /*
  * No blinking. Just plain old static light.
  */
 void mode_static(void)
 {
-
-  for(uint16_t i = Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++) {
-	  WS2812B_SetDiodeColorStruct(i, Ws28b12b_Segments[mActualSegment].ModeColor_w[0]);
-  }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[0]);
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 //
@@ -875,50 +1443,50 @@ void mode_static(void)
 void to_color(uint8_t from)
 {
 	// HSV Saturatioin modifing
-	uint16_t h;
-	uint8_t s, v, r, g, b;
-
-	WS2812BFX_RGBtoHSV(Ws28b12b_Segments[mActualSegment].ModeColor_w[0].red, Ws28b12b_Segments[mActualSegment].ModeColor_w[0].green, Ws28b12b_Segments[mActualSegment].ModeColor_w[0].blue, &h, &s, &v);
+	uint16_t h = mSeg->BaseHue;
+	uint8_t s = mSeg->BaseSat;
+	uint8_t v = mSeg->BaseVal;
+	uint8_t r, g, b;
 
 	if(from)
-		WS2812BFX_HSVtoRGB(h, s - Ws28b12b_Segments[mActualSegment].CounterModeStep, v, &r, &g, &b);
+		WS2812B_HSVtoRGB(h, s - mSeg->CounterModeStep, v, &r, &g, &b);
 	else
-		WS2812BFX_HSVtoRGB(h, s, v - Ws28b12b_Segments[mActualSegment].CounterModeStep, &r, &g, &b);
+		WS2812B_HSVtoRGB(h, s, v - mSeg->CounterModeStep, &r, &g, &b);
 
 	WS2812BFX_SetAllRGB(mActualSegment, r, g, b);
 
-	if(!Ws28b12b_Segments[mActualSegment].Cycle)
+	if(!mSeg->Cycle)
 	{
 		if(from)
 		{
-			if(Ws28b12b_Segments[mActualSegment].CounterModeStep < s)
-				Ws28b12b_Segments[mActualSegment].CounterModeStep++;
+			if(mSeg->CounterModeStep < s)
+				mSeg->CounterModeStep++;
 			else
-				Ws28b12b_Segments[mActualSegment].Cycle = 1;
+				mSeg->Cycle = 1;
 		}
 		else
 		{
-			if(Ws28b12b_Segments[mActualSegment].CounterModeStep < v)
-				Ws28b12b_Segments[mActualSegment].CounterModeStep++;
+			if(mSeg->CounterModeStep < v)
+				mSeg->CounterModeStep++;
 			else
-				Ws28b12b_Segments[mActualSegment].Cycle = 1;
+				mSeg->Cycle = 1;
 		}
 	}
 	else
 	{
-		if(Ws28b12b_Segments[mActualSegment].CounterModeStep > 0)
-			Ws28b12b_Segments[mActualSegment].CounterModeStep--;
+		if(mSeg->CounterModeStep > 0)
+			mSeg->CounterModeStep--;
 		else
-			Ws28b12b_Segments[mActualSegment].Cycle = 0;
+			mSeg->Cycle = 0;
 	}
 
 	if(from)
 	{
-		Ws28b12b_Segments[mActualSegment].ModeDelay = (Ws28b12b_Segments[mActualSegment].Speed / s / 2);
+		mSeg->ModeDelay = mSeg->SatStepDelay;
 	}
 	else
 	{
-		Ws28b12b_Segments[mActualSegment].ModeDelay = (Ws28b12b_Segments[mActualSegment].Speed / v / 2);
+		mSeg->ModeDelay = mSeg->ValStepDelay;
 	}
 }
 
@@ -938,12 +1506,12 @@ void mode_black_to_color(void)
 //
 void blink(uint32_t color1, uint32_t color2, uint8_t strobe)
 {
-	uint32_t color = ((Ws28b12b_Segments[mActualSegment].CounterModeCall & 1) == 0) ? color1 : color2;
+	uint32_t color = ((mSeg->CounterModeCall & 1) == 0) ? color1 : color2;
 	WS2812BFX_SetAll(mActualSegment, color);
-	if((Ws28b12b_Segments[mActualSegment].CounterModeCall & 1) == 0)
-		Ws28b12b_Segments[mActualSegment].ModeDelay = strobe ? 20 : Ws28b12b_Segments[mActualSegment].Speed / 2;
+	if((mSeg->CounterModeCall & 1) == 0)
+		mSeg->ModeDelay = strobe ? 20 : mSeg->Speed / 2;
 	else
-		Ws28b12b_Segments[mActualSegment].ModeDelay = strobe? Ws28b12b_Segments[mActualSegment].Speed - 20 : (Ws28b12b_Segments[mActualSegment].Speed / 2);
+		mSeg->ModeDelay = strobe? mSeg->Speed - 20 : (mSeg->Speed / 2);
 }
 
 /*
@@ -951,21 +1519,21 @@ void blink(uint32_t color1, uint32_t color2, uint8_t strobe)
  */
 void mode_blink(void)
 {
-	blink(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], 0);
+	blink(mSeg->ModeColor[0], mSeg->ModeColor[1], 0);
 }
 
 void mode_blink_rainbow(void)
 {
-	blink(color_wheel(Ws28b12b_Segments[mActualSegment].CounterModeCall & 0xFF), Ws28b12b_Segments[mActualSegment].ModeColor[1], 0);
+	blink(color_wheel(mSeg->CounterModeCall & 0xFF), mSeg->ModeColor[1], 0);
 }
 
 void mode_strobe(void) {
-	blink(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], 1);
+	blink(mSeg->ModeColor[0], mSeg->ModeColor[1], 1);
 }
 
 void mode_strobe_rainbow(void)
 {
-	blink(color_wheel(Ws28b12b_Segments[mActualSegment].CounterModeCall & 0xFF), Ws28b12b_Segments[mActualSegment].ModeColor[1], 1);
+	blink(color_wheel(mSeg->CounterModeCall & 0xFF), mSeg->ModeColor[1], 1);
 }
 
 /*
@@ -973,7 +1541,7 @@ void mode_strobe_rainbow(void)
  */
 void mode_breath(void)
 {
-	uint32_t lum = Ws28b12b_Segments[mActualSegment].CounterModeStep;
+	uint32_t lum = mSeg->CounterModeStep;
 	if(lum > 255) lum = 511 - lum;
 
 	uint16_t delay;
@@ -986,14 +1554,14 @@ void mode_breath(void)
 	else if(lum <= 150) delay = 11; // 5
 	else delay = 10; // 4
 
-	uint8_t r = Ws28b12b_Segments[mActualSegment].ModeColor_w[0].red * lum / 256;
-	uint8_t g = Ws28b12b_Segments[mActualSegment].ModeColor_w[0].green * lum / 256;
-	uint8_t b = Ws28b12b_Segments[mActualSegment].ModeColor_w[0].blue * lum / 256;
+	uint8_t r = mSeg->ModeColor_w[0].red * lum / 256;
+	uint8_t g = mSeg->ModeColor_w[0].green * lum / 256;
+	uint8_t b = mSeg->ModeColor_w[0].blue * lum / 256;
 
 	WS2812BFX_SetAllRGB(mActualSegment, r, g, b);
-	Ws28b12b_Segments[mActualSegment].CounterModeStep += 2;
-	if(Ws28b12b_Segments[mActualSegment].CounterModeStep > (512-15)) Ws28b12b_Segments[mActualSegment].CounterModeStep = 15;
-	Ws28b12b_Segments[mActualSegment].ModeDelay = delay;
+	mSeg->CounterModeStep += 2;
+	if(mSeg->CounterModeStep > (512-15)) mSeg->CounterModeStep = 15;
+	mSeg->ModeDelay = delay;
 }
 
 /*
@@ -1003,33 +1571,33 @@ void mode_breath(void)
  */
 void color_wipe(uint32_t color1, uint32_t color2, uint8_t rev)
 {
-    if(Ws28b12b_Segments[mActualSegment].CounterModeStep < SEGMENT_LENGTH)
+    if(mSeg->CounterModeStep < SEGMENT_LENGTH)
     {
-    	uint32_t led_offset = Ws28b12b_Segments[mActualSegment].CounterModeStep;
+    	uint32_t led_offset = mSeg->CounterModeStep;
         if(rev)
         {
-        	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - led_offset, color1);
+        	WS2812B_SetDiodeColor(mSeg->IdStop - led_offset, color1);
         }
         else
         {
-        	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + led_offset, color1);
+        	WS2812B_SetDiodeColor(mSeg->IdStart + led_offset, color1);
         }
     }
 	else
 	{
-	    uint32_t led_offset = Ws28b12b_Segments[mActualSegment].CounterModeStep - SEGMENT_LENGTH;
+	    uint32_t led_offset = mSeg->CounterModeStep - SEGMENT_LENGTH;
         if(rev)
         {
-        	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - led_offset, color2);
+        	WS2812B_SetDiodeColor(mSeg->IdStop - led_offset, color2);
         }
         else
         {
-        	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + led_offset, color2);
+        	WS2812B_SetDiodeColor(mSeg->IdStart + led_offset, color2);
         }
 
     }
-    Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % (SEGMENT_LENGTH * 2);
-    Ws28b12b_Segments[mActualSegment].ModeDelay =  Ws28b12b_Segments[mActualSegment].Speed;
+    mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % (SEGMENT_LENGTH * 2);
+    mSeg->ModeDelay =  mSeg->Speed;
 }
 
 /*
@@ -1037,34 +1605,34 @@ void color_wipe(uint32_t color1, uint32_t color2, uint8_t rev)
  */
 void mode_color_wipe(void)
 {
-	color_wipe(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], 0);
+	color_wipe(mSeg->ModeColor[0], mSeg->ModeColor[1], 0);
 }
 
 void mode_color_wipe_inv(void)
 {
-	color_wipe(Ws28b12b_Segments[mActualSegment].ModeColor[1], Ws28b12b_Segments[mActualSegment].ModeColor[0], 0);
+	color_wipe(mSeg->ModeColor[1], mSeg->ModeColor[0], 0);
 }
 
 void mode_color_wipe_rev(void)
 {
-	color_wipe(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], 1);
+	color_wipe(mSeg->ModeColor[0], mSeg->ModeColor[1], 1);
 }
 
 void mode_color_wipe_rev_inv(void)
 {
-	color_wipe(Ws28b12b_Segments[mActualSegment].ModeColor[1], Ws28b12b_Segments[mActualSegment].ModeColor[0], 1);
+	color_wipe(mSeg->ModeColor[1], mSeg->ModeColor[0], 1);
 }
 
 void mode_color_wipe_random(void)
 {
-	if(Ws28b12b_Segments[mActualSegment].CounterModeStep % SEGMENT_LENGTH == 0)
+	if(mSeg->CounterModeStep % SEGMENT_LENGTH == 0)
 	{
-	  Ws28b12b_Segments[mActualSegment].AuxParam = get_random_wheel_index(Ws28b12b_Segments[mActualSegment].AuxParam);
+	  mSeg->AuxParam = get_random_wheel_index(mSeg->AuxParam);
 	}
-	uint32_t color = color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam);
+	uint32_t color = color_wheel(mSeg->AuxParam);
 
 	color_wipe(color, color, 0);
-	Ws28b12b_Segments[mActualSegment].ModeDelay =  Ws28b12b_Segments[mActualSegment].Speed;
+	mSeg->ModeDelay =  mSeg->Speed;
 }
 
 /*
@@ -1072,11 +1640,11 @@ void mode_color_wipe_random(void)
  */
 void mode_color_sweep_random(void)
 {
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep % SEGMENT_LENGTH == 0)
+  if(mSeg->CounterModeStep % SEGMENT_LENGTH == 0)
   { // aux_param will store our random color wheel index
-	  Ws28b12b_Segments[mActualSegment].AuxParam = get_random_wheel_index(Ws28b12b_Segments[mActualSegment].AuxParam);
+	  mSeg->AuxParam = get_random_wheel_index(mSeg->AuxParam);
   }
-  uint32_t color = color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam);
+  uint32_t color = color_wheel(mSeg->AuxParam);
   color_wipe(color, color, 1);
 }
 
@@ -1086,9 +1654,9 @@ void mode_color_sweep_random(void)
  */
 void mode_random_color(void)
 {
-	Ws28b12b_Segments[mActualSegment].AuxParam = get_random_wheel_index(Ws28b12b_Segments[mActualSegment].AuxParam); // aux_param will store our random color wheel index
-	WS2812BFX_SetAll(mActualSegment, color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam));
-	Ws28b12b_Segments[mActualSegment].ModeDelay =  Ws28b12b_Segments[mActualSegment].Speed;
+	mSeg->AuxParam = get_random_wheel_index(mSeg->AuxParam); // aux_param will store our random color wheel index
+	WS2812BFX_SetAll(mActualSegment, color_wheel(mSeg->AuxParam));
+	mSeg->ModeDelay =  mSeg->Speed;
 }
 
 /*
@@ -1097,16 +1665,16 @@ void mode_random_color(void)
  */
 void mode_single_dynamic(void)
 {
-	if(Ws28b12b_Segments[mActualSegment].CounterModeCall == 0)
+	if(mSeg->CounterModeCall == 0)
 	{
-		for(uint16_t i = Ws28b12b_Segments[mActualSegment].IdStop; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
+		for(uint16_t i = mSeg->IdStop; i <= mSeg->IdStop; i++)
 		{
 			WS2812B_SetDiodeColor(i, color_wheel(rand()%256));
 		}
 	}
 
-	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + rand() % SEGMENT_LENGTH, color_wheel(rand()%256));
-	Ws28b12b_Segments[mActualSegment].ModeDelay =  Ws28b12b_Segments[mActualSegment].Speed;
+	WS2812B_SetDiodeColor(mSeg->IdStart + rand() % SEGMENT_LENGTH, color_wheel(rand()%256));
+	mSeg->ModeDelay =  mSeg->Speed;
 }
 
 
@@ -1116,11 +1684,14 @@ void mode_single_dynamic(void)
  */
 void mode_multi_dynamic(void)
 {
-	for(uint16_t i = Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
+	ws2812b_color Pixels[WS2812B_LEDS];
+
+	for(uint16_t i = 0; i < SEGMENT_LENGTH; i++)
 	{
-		WS2812B_SetDiodeColor(i, color_wheel(rand()%256));
+		Pixels[i] = span_pixel(color_wheel(rand()%256));
 	}
-	Ws28b12b_Segments[mActualSegment].ModeDelay =  Ws28b12b_Segments[mActualSegment].Speed;
+	WS2812B_SetSpan(mSeg->IdStart, SEGMENT_LENGTH, Pixels);
+	mSeg->ModeDelay =  mSeg->Speed;
 }
 
 /*
@@ -1128,14 +1699,9 @@ void mode_multi_dynamic(void)
  */
 void mode_rainbow(void)
 {
-  uint32_t color = color_wheel(Ws28b12b_Segments[mActualSegment].CounterModeStep);
-  for(uint16_t i = Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-  {
-	  WS2812B_SetDiodeColor(i, color);
-  }
+  mSeg->CounterModeStep = time_step() & 0xFF;
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) & 0xFF;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, color_wheel(mSeg->CounterModeStep));
 }
 
 
@@ -1144,14 +1710,15 @@ void mode_rainbow(void)
  */
 void mode_rainbow_cycle(void)
 {
+  ws2812b_color Pixels[WS2812B_LEDS];
+
+  mSeg->CounterModeStep = time_step() & 0xFF;
+
   for(uint16_t i=0; i < SEGMENT_LENGTH; i++)
   {
-	  uint32_t color = color_wheel(((i * 256 / SEGMENT_LENGTH) + Ws28b12b_Segments[mActualSegment].CounterModeStep) & 0xFF);
-	  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color);
+	  Pixels[i] = span_pixel(color_wheel(((i * 256 / SEGMENT_LENGTH) + mSeg->CounterModeStep) & 0xFF));
   }
-
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) & 0xFF;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetSpan(mSeg->IdStart, SEGMENT_LENGTH, Pixels);
 }
 
 
@@ -1159,18 +1726,14 @@ void mode_rainbow_cycle(void)
  * Fades the LEDs between two colors
  */
 void mode_fade(void) {
-  int lum = Ws28b12b_Segments[mActualSegment].CounterModeStep;
-  if(lum > 255) lum = 511 - lum; // lum = 0 -> 255 -> 0
+  mSeg->CounterModeStep = (time_step() * 4) & 0x1FF;
 
-  uint32_t color = color_blend(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], lum);
+  int lum = mSeg->CounterModeStep;
+  if(lum > 255) lum = 511 - lum; // lum = 0 -> 255 -> 0
 
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++) {
-    WS2812B_SetDiodeColor(i, color);
-  }
+  uint32_t color = color_blend(mSeg->ModeColor[0], mSeg->ModeColor[1], lum);
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep += 4;
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep > 511) Ws28b12b_Segments[mActualSegment].CounterModeStep = 0;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, color);
 }
 
 
@@ -1178,26 +1741,18 @@ void mode_fade(void) {
  * Runs a single pixel back and forth.
  */
 void mode_scan(void) {
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep > (SEGMENT_LENGTH * 2) - 3) {
-    Ws28b12b_Segments[mActualSegment].CounterModeStep = 0;
-  }
+  mSeg->CounterModeStep = time_step() % MAX(1, (SEGMENT_LENGTH * 2) - 2);
 
-  for(uint16_t i = Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++) {
-    WS2812B_SetDiodeColor(i, Ws28b12b_Segments[mActualSegment].ModeColor[1]);
-  }
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[1]);
 
-  int led_offset = Ws28b12b_Segments[mActualSegment].CounterModeStep - (SEGMENT_LENGTH - 1);
+  int led_offset = mSeg->CounterModeStep - (SEGMENT_LENGTH - 1);
   led_offset = abs(led_offset);
 
   if(IS_REVERSE) {
-    WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - led_offset, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+    WS2812B_SetDiodeColor(mSeg->IdStop - led_offset, mSeg->ModeColor[0]);
   } else {
-    WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + led_offset, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+    WS2812B_SetDiodeColor(mSeg->IdStart + led_offset, mSeg->ModeColor[0]);
   }
-
-
-  Ws28b12b_Segments[mActualSegment].CounterModeStep++;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
 }
 
 
@@ -1205,24 +1760,15 @@ void mode_scan(void) {
  * Runs two pixel back and forth in opposite directions.
  */
 void mode_dual_scan(void) {
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep > (SEGMENT_LENGTH * 2) - 3)
-  {
-    Ws28b12b_Segments[mActualSegment].CounterModeStep = 0;
-  }
+  mSeg->CounterModeStep = time_step() % MAX(1, (SEGMENT_LENGTH * 2) - 2);
 
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <Ws28b12b_Segments[mActualSegment].IdStop; i++)
-  {
-    WS2812B_SetDiodeColor(i, Ws28b12b_Segments[mActualSegment].ModeColor[1]);
-  }
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[1]);
 
-  int led_offset = Ws28b12b_Segments[mActualSegment].CounterModeStep - (SEGMENT_LENGTH - 1);
+  int led_offset = mSeg->CounterModeStep - (SEGMENT_LENGTH - 1);
   led_offset = abs(led_offset);
 
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + led_offset, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + SEGMENT_LENGTH - led_offset - 1, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-
-  Ws28b12b_Segments[mActualSegment].CounterModeStep++;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetDiodeColor(mSeg->IdStart + led_offset, mSeg->ModeColor[0]);
+  WS2812B_SetDiodeColor(mSeg->IdStart + SEGMENT_LENGTH - led_offset - 1, mSeg->ModeColor[0]);
 }
 
 /*
@@ -1230,23 +1776,15 @@ void mode_dual_scan(void) {
  */
 void theater_chase(uint32_t color1, uint32_t color2)
 {
-	Ws28b12b_Segments[mActualSegment].CounterModeCall = Ws28b12b_Segments[mActualSegment].CounterModeCall % 3;
-  for(uint16_t i=0; i < SEGMENT_LENGTH; i++) {
-    if((i % 3) == Ws28b12b_Segments[mActualSegment].CounterModeCall) {
-      if(IS_REVERSE) {
-    	  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - i, color1);
-      } else {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color1);
-      }
-    } else {
-      if(IS_REVERSE) {
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - i, color2);
-      } else {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color2);
-      }
-    }
+  ws2812b_color Pixels[WS2812B_LEDS];
+  ws2812b_color c1 = span_pixel(color1), c2 = span_pixel(color2);
+  uint16_t length = SEGMENT_LENGTH;
+
+  uint8_t phase = mSeg->CounterModeStep % 3;
+  for(uint16_t i=0; i < length; i++) {
+    Pixels[IS_REVERSE ? length - 1 - i : i] = ((i % 3) == phase) ? c1 : c2;
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetSpan(mSeg->IdStart, length, Pixels);
 }
 
 
@@ -1256,8 +1794,8 @@ void theater_chase(uint32_t color1, uint32_t color2)
  */
 void mode_theater_chase(void)
 {
-
-  return theater_chase(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1]);
+  mSeg->CounterModeStep = time_step();
+  return theater_chase(mSeg->ModeColor[0], mSeg->ModeColor[1]);
 }
 
 
@@ -1267,30 +1805,29 @@ void mode_theater_chase(void)
  */
 void mode_theater_chase_rainbow(void)
 {
-
-	Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) & 0xFF;
-	theater_chase(color_wheel(Ws28b12b_Segments[mActualSegment].CounterModeStep), BLACK);
+	mSeg->CounterModeStep = time_step();
+	theater_chase(color_wheel((mSeg->CounterModeStep + 1) & 0xFF), BLACK);
 }
 
 /*
  * Running lights effect with smooth sine transition.
  */
 void mode_running_lights(void) {
-  uint8_t r = ((Ws28b12b_Segments[mActualSegment].ModeColor[0] >> 16) & 0xFF);
-  uint8_t g = ((Ws28b12b_Segments[mActualSegment].ModeColor[0] >>  8) & 0xFF);
-  uint8_t b =  (Ws28b12b_Segments[mActualSegment].ModeColor[0]        & 0xFF);
+  mSeg->CounterModeStep = time_step() & 0xFF;
+
+  uint8_t r = ((mSeg->ModeColor[0] >> 16) & 0xFF);
+  uint8_t g = ((mSeg->ModeColor[0] >>  8) & 0xFF);
+  uint8_t b =  (mSeg->ModeColor[0]        & 0xFF);
 
   uint8_t sineIncr = MAX(1, (256 / WS2812B_LEDS));
   for(uint16_t i=0; i < SEGMENT_LENGTH; i++) {
-    int lum = (int)sine8(((i + Ws28b12b_Segments[mActualSegment].CounterModeStep) * sineIncr));
+    int lum = (int)sine8(((i + mSeg->CounterModeStep) * sineIncr));
     if(IS_REVERSE) {
-    WS2812B_SetDiodeRGB(Ws28b12b_Segments[mActualSegment].IdStart + i,  (r * lum) / 256, (g * lum) / 256, (b * lum) / 256);
+    WS2812B_SetDiodeRGB(mSeg->IdStart + i,  (r * lum) / 256, (g * lum) / 256, (b * lum) / 256);
     } else {
-    WS2812B_SetDiodeRGB(Ws28b12b_Segments[mActualSegment].IdStop - i,  (r * lum) / 256, (g * lum) / 256, (b * lum) / 256);
+    WS2812B_SetDiodeRGB(mSeg->IdStop - i,  (r * lum) / 256, (g * lum) / 256, (b * lum) / 256);
     }
   }
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % 256;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
 }
 
 
@@ -1299,21 +1836,18 @@ void mode_running_lights(void) {
  */
 void twinkle(uint32_t color1, uint32_t color2)
 {
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep == 0)
+  if(mSeg->CounterModeStep == 0)
   {
-    for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-    {
-    	WS2812B_SetDiodeColor(i, color2);
-    }
+    WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, color2);
     uint16_t min_leds = MAX(1, WS2812B_LEDS / 5); // make sure, at least one LED is on
     uint16_t max_leds = MAX(1, WS2812B_LEDS / 2); // make sure, at least one LED is on
-    Ws28b12b_Segments[mActualSegment].CounterModeStep = rand() % (max_leds + 1 - min_leds) + min_leds;
+    mSeg->CounterModeStep = rand() % (max_leds + 1 - min_leds) + min_leds;
   }
 
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + rand() % SEGMENT_LENGTH, color1);
+  WS2812B_SetDiodeColor(mSeg->IdStart + rand() % SEGMENT_LENGTH, color1);
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep--;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->CounterModeStep--;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 /*
@@ -1322,7 +1856,7 @@ void twinkle(uint32_t color1, uint32_t color2)
  */
 void mode_twinkle(void)
 {
-  return twinkle(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1]);
+  return twinkle(mSeg->ModeColor[0], mSeg->ModeColor[1]);
 }
 
 /*
@@ -1331,7 +1865,7 @@ void mode_twinkle(void)
  */
 void mode_twinkle_random(void)
 {
-  return twinkle(color_wheel(rand() % 256), Ws28b12b_Segments[mActualSegment].ModeColor[1]);
+  return twinkle(color_wheel(rand() % 256), mSeg->ModeColor[1]);
 }
 
 /*
@@ -1343,9 +1877,9 @@ void twinkle_fade(uint32_t color)
 
   if((rand() %3) == 0)
   {
-	  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + rand() % SEGMENT_LENGTH, color);
+	  WS2812B_SetDiodeColor(mSeg->IdStart + rand() % SEGMENT_LENGTH, color);
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1354,7 +1888,7 @@ void twinkle_fade(uint32_t color)
  */
 void mode_twinkle_fade(void)
 {
-  twinkle_fade(Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+  twinkle_fade(mSeg->ModeColor[0]);
 }
 
 
@@ -1372,10 +1906,10 @@ void mode_twinkle_fade_random(void)
  */
 void mode_sparkle(void)
 {
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + Ws28b12b_Segments[mActualSegment].AuxParam16b, Ws28b12b_Segments[mActualSegment].ModeColor[1]);
-  Ws28b12b_Segments[mActualSegment].AuxParam16b = rand() % SEGMENT_LENGTH; // aux_param3 stores the random led index
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + Ws28b12b_Segments[mActualSegment].AuxParam16b, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetDiodeColor(mSeg->IdStart + mSeg->AuxParam16b, mSeg->ModeColor[1]);
+  mSeg->AuxParam16b = rand() % SEGMENT_LENGTH; // aux_param3 stores the random led index
+  WS2812B_SetDiodeColor(mSeg->IdStart + mSeg->AuxParam16b, mSeg->ModeColor[0]);
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1385,23 +1919,20 @@ void mode_sparkle(void)
  */
 void mode_flash_sparkle(void)
 {
-  if(Ws28b12b_Segments[mActualSegment].CounterModeCall == 0)
+  if(mSeg->CounterModeCall == 0)
   {
-    for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-    {
-      WS2812B_SetDiodeColor(i, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-    }
+    WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[0]);
   }
 
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + Ws28b12b_Segments[mActualSegment].AuxParam16b, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+  WS2812B_SetDiodeColor(mSeg->IdStart + mSeg->AuxParam16b, mSeg->ModeColor[0]);
 
   if(rand() % 5 == 0)
   {
-    Ws28b12b_Segments[mActualSegment].AuxParam16b = rand() % SEGMENT_LENGTH; // aux_param3 stores the random led index
-    WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + Ws28b12b_Segments[mActualSegment].AuxParam16b, WHITE);
-    Ws28b12b_Segments[mActualSegment].ModeDelay = 20;
+    mSeg->AuxParam16b = rand() % SEGMENT_LENGTH; // aux_param3 stores the random led index
+    WS2812B_SetDiodeColor(mSeg->IdStart + mSeg->AuxParam16b, WHITE);
+    mSeg->ModeDelay = 20;
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1411,20 +1942,17 @@ void mode_flash_sparkle(void)
  */
 void mode_hyper_sparkle(void)
 {
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-  {
-    WS2812B_SetDiodeColor(i, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-  }
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[0]);
 
   if(rand() % 5 < 2)
   {
     for(uint16_t i=0; i < MAX(1, SEGMENT_LENGTH/3); i++)
     {
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + rand() % SEGMENT_LENGTH, WHITE);
+      WS2812B_SetDiodeColor(mSeg->IdStart + rand() % SEGMENT_LENGTH, WHITE);
     }
-    Ws28b12b_Segments[mActualSegment].ModeDelay = 20;
+    mSeg->ModeDelay = 20;
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 /*
@@ -1432,21 +1960,15 @@ void mode_hyper_sparkle(void)
  */
 void mode_multi_strobe(void)
 {
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-  {
-	  WS2812B_SetDiodeColor(i, BLACK);
-  }
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, BLACK);
 
-  uint16_t delay = 200 + ((9 - (Ws28b12b_Segments[mActualSegment].Speed % 10)) * 100);
-  uint16_t count = 2 * ((Ws28b12b_Segments[mActualSegment].Speed / 100) + 1);
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep < count)
+  uint16_t delay = 200 + ((9 - (mSeg->Speed % 10)) * 100);
+  uint16_t count = 2 * ((mSeg->Speed / 100) + 1);
+  if(mSeg->CounterModeStep < count)
   {
-    if((Ws28b12b_Segments[mActualSegment].CounterModeStep & 1) == 0)
+    if((mSeg->CounterModeStep & 1) == 0)
     {
-      for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-      {
-    	  WS2812B_SetDiodeColor(i, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-      }
+      WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[0]);
       delay = 20;
     }
     else
@@ -1454,8 +1976,8 @@ void mode_multi_strobe(void)
       delay = 50;
     }
   }
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % (count + 1);
-  Ws28b12b_Segments[mActualSegment].ModeDelay = delay;
+  mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % (count + 1);
+  mSeg->ModeDelay = delay;
 }
 
 /*
@@ -1465,24 +1987,24 @@ void mode_multi_strobe(void)
  */
 void chase(uint32_t color1, uint32_t color2, uint32_t color3)
 {
-  uint16_t a = Ws28b12b_Segments[mActualSegment].CounterModeStep;
+  uint16_t a = mSeg->CounterModeStep;
   uint16_t b = (a + 1) % SEGMENT_LENGTH;
   uint16_t c = (b + 1) % SEGMENT_LENGTH;
   if(IS_REVERSE) {
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - a, color1);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - b, color2);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - c, color3);
+  WS2812B_SetDiodeColor(mSeg->IdStop - a, color1);
+  WS2812B_SetDiodeColor(mSeg->IdStop - b, color2);
+  WS2812B_SetDiodeColor(mSeg->IdStop - c, color3);
   } else {
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + a, color1);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + b, color2);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + c, color3);
+  WS2812B_SetDiodeColor(mSeg->IdStart + a, color1);
+  WS2812B_SetDiodeColor(mSeg->IdStart + b, color2);
+  WS2812B_SetDiodeColor(mSeg->IdStart + c, color3);
   }
 
-  if(b == 0) Ws28b12b_Segments[mActualSegment].Cycle = 1;
-  else Ws28b12b_Segments[mActualSegment].Cycle = 0;
+  if(b == 0) mSeg->Cycle = 1;
+  else mSeg->Cycle = 0;
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % WS2812B_LEDS;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % WS2812B_LEDS;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1491,7 +2013,7 @@ void chase(uint32_t color1, uint32_t color2, uint32_t color3)
  */
 void mode_bicolor_chase(void)
 {
-  return chase(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], Ws28b12b_Segments[mActualSegment].ModeColor[2]);
+  return chase(mSeg->ModeColor[0], mSeg->ModeColor[1], mSeg->ModeColor[2]);
 }
 
 
@@ -1500,7 +2022,7 @@ void mode_bicolor_chase(void)
  */
 void mode_chase_color(void)
 {
-  return chase(Ws28b12b_Segments[mActualSegment].ModeColor[0], WHITE, WHITE);
+  return chase(mSeg->ModeColor[0], WHITE, WHITE);
 }
 
 
@@ -1509,7 +2031,7 @@ void mode_chase_color(void)
  */
 void mode_chase_blackout(void)
 {
-  return chase(Ws28b12b_Segments[mActualSegment].ModeColor[0], BLACK, BLACK);
+  return chase(mSeg->ModeColor[0], BLACK, BLACK);
 }
 
 
@@ -1518,7 +2040,7 @@ void mode_chase_blackout(void)
  */
 void mode_chase_white(void)
 {
-  return chase(WHITE, Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+  return chase(WHITE, mSeg->ModeColor[0], mSeg->ModeColor[0]);
 }
 
 
@@ -1527,11 +2049,11 @@ void mode_chase_white(void)
  */
 void mode_chase_random(void)
 {
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep == 0)
+  if(mSeg->CounterModeStep == 0)
   {
-    Ws28b12b_Segments[mActualSegment].AuxParam = get_random_wheel_index(Ws28b12b_Segments[mActualSegment].AuxParam);
+    mSeg->AuxParam = get_random_wheel_index(mSeg->AuxParam);
   }
-  return chase(color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam), WHITE, WHITE);
+  return chase(color_wheel(mSeg->AuxParam), WHITE, WHITE);
 }
 
 
@@ -1540,10 +2062,10 @@ void mode_chase_random(void)
  */
 void mode_chase_rainbow_white(void)
 {
-  uint16_t n = Ws28b12b_Segments[mActualSegment].CounterModeStep;
-  uint16_t m = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % WS2812B_LEDS;
-  uint32_t color2 = color_wheel(((n * 256 / SEGMENT_LENGTH) + (Ws28b12b_Segments[mActualSegment].CounterModeCall & 0xFF)) & 0xFF);
-  uint32_t color3 = color_wheel(((m * 256 / SEGMENT_LENGTH) + (Ws28b12b_Segments[mActualSegment].CounterModeCall & 0xFF)) & 0xFF);
+  uint16_t n = mSeg->CounterModeStep;
+  uint16_t m = (mSeg->CounterModeStep + 1) % WS2812B_LEDS;
+  uint32_t color2 = color_wheel(((n * 256 / SEGMENT_LENGTH) + (mSeg->CounterModeCall & 0xFF)) & 0xFF);
+  uint32_t color3 = color_wheel(((m * 256 / SEGMENT_LENGTH) + (mSeg->CounterModeCall & 0xFF)) & 0xFF);
 
   return chase(WHITE, color2, color3);
 }
@@ -1555,8 +2077,8 @@ void mode_chase_rainbow_white(void)
 void mode_chase_rainbow(void)
 {
   uint8_t color_sep = 256 / SEGMENT_LENGTH;
-  uint8_t color_index = Ws28b12b_Segments[mActualSegment].CounterModeCall & 0xFF;
-  uint32_t color = color_wheel(((Ws28b12b_Segments[mActualSegment].CounterModeStep * color_sep) + color_index) & 0xFF);
+  uint8_t color_index = mSeg->CounterModeCall & 0xFF;
+  uint32_t color = color_wheel(((mSeg->CounterModeStep * color_sep) + color_index) & 0xFF);
 
   return chase(color, WHITE, WHITE);
 }
@@ -1568,8 +2090,8 @@ void mode_chase_rainbow(void)
 void mode_chase_blackout_rainbow(void)
 {
   uint8_t color_sep = 256 / SEGMENT_LENGTH;
-  uint8_t color_index = Ws28b12b_Segments[mActualSegment].CounterModeCall & 0xFF;
-  uint32_t color = color_wheel(((Ws28b12b_Segments[mActualSegment].CounterModeStep * color_sep) + color_index) & 0xFF);
+  uint8_t color_index = mSeg->CounterModeCall & 0xFF;
+  uint32_t color = color_wheel(((mSeg->CounterModeStep * color_sep) + color_index) & 0xFF);
 
   return chase(color, 0, 0);
 }
@@ -1580,29 +2102,26 @@ void mode_chase_blackout_rainbow(void)
 void mode_chase_flash(void)
 {
   const static uint8_t flash_count = 4;
-  uint8_t flash_step = Ws28b12b_Segments[mActualSegment].CounterModeCall % ((flash_count * 2) + 1);
+  uint8_t flash_step = mSeg->CounterModeCall % ((flash_count * 2) + 1);
 
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
-  {
-    WS2812B_SetDiodeColor(i, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-  }
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH, mSeg->ModeColor[0]);
 
-  uint16_t delay = Ws28b12b_Segments[mActualSegment].Speed;
+  uint16_t delay = mSeg->Speed;
   if(flash_step < (flash_count * 2))
   {
     if(flash_step % 2 == 0)
     {
-      uint16_t n = Ws28b12b_Segments[mActualSegment].CounterModeStep;
-      uint16_t m = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % SEGMENT_LENGTH;
+      uint16_t n = mSeg->CounterModeStep;
+      uint16_t m = (mSeg->CounterModeStep + 1) % SEGMENT_LENGTH;
       if(IS_REVERSE)
       {
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - n, WHITE);
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - m, WHITE);
+      WS2812B_SetDiodeColor(mSeg->IdStop - n, WHITE);
+      WS2812B_SetDiodeColor(mSeg->IdStop - m, WHITE);
       }
       else
       {
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + n, WHITE);
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + m, WHITE);
+        WS2812B_SetDiodeColor(mSeg->IdStart + n, WHITE);
+        WS2812B_SetDiodeColor(mSeg->IdStart + m, WHITE);
       }
       delay = 20;
     }
@@ -1613,9 +2132,9 @@ void mode_chase_flash(void)
   }
   else
   {
-    Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % SEGMENT_LENGTH;
+    mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % SEGMENT_LENGTH;
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = delay;
+  mSeg->ModeDelay = delay;
 }
 
 
@@ -1625,41 +2144,38 @@ void mode_chase_flash(void)
 void mode_chase_flash_random(void)
 {
   const static uint8_t flash_count = 4;
-  uint8_t flash_step = Ws28b12b_Segments[mActualSegment].CounterModeCall % ((flash_count * 2) + 1);
+  uint8_t flash_step = mSeg->CounterModeCall % ((flash_count * 2) + 1);
 
-  for(uint16_t i=0; i < Ws28b12b_Segments[mActualSegment].CounterModeStep; i++)
-  {
-    WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam));
-  }
+  WS2812B_FillSpan(mSeg->IdStart, mSeg->CounterModeStep, color_wheel(mSeg->AuxParam));
 
-  uint16_t delay = Ws28b12b_Segments[mActualSegment].Speed;
+  uint16_t delay = mSeg->Speed;
   if(flash_step < (flash_count * 2))
   {
-    uint16_t n = Ws28b12b_Segments[mActualSegment].CounterModeStep;
-    uint16_t m = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % SEGMENT_LENGTH;
+    uint16_t n = mSeg->CounterModeStep;
+    uint16_t m = (mSeg->CounterModeStep + 1) % SEGMENT_LENGTH;
     if(flash_step % 2 == 0)
     {
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + n, WHITE);
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + m, WHITE);
+      WS2812B_SetDiodeColor(mSeg->IdStart + n, WHITE);
+      WS2812B_SetDiodeColor(mSeg->IdStart + m, WHITE);
       delay = 20;
     }
     else
     {
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + n, color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam));
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + m, BLACK);
+      WS2812B_SetDiodeColor(mSeg->IdStart + n, color_wheel(mSeg->AuxParam));
+      WS2812B_SetDiodeColor(mSeg->IdStart + m, BLACK);
       delay = 30;
     }
   }
   else
   {
-    Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % SEGMENT_LENGTH;
+    mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % SEGMENT_LENGTH;
 
-    if(Ws28b12b_Segments[mActualSegment].CounterModeStep == 0)
+    if(mSeg->CounterModeStep == 0)
     {
-      Ws28b12b_Segments[mActualSegment].AuxParam = get_random_wheel_index(Ws28b12b_Segments[mActualSegment].AuxParam);
+      mSeg->AuxParam = get_random_wheel_index(mSeg->AuxParam);
     }
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = delay;
+  mSeg->ModeDelay = delay;
 }
 
 
@@ -1668,26 +2184,21 @@ void mode_chase_flash_random(void)
  */
 void running(uint32_t color1, uint32_t color2)
 {
-  for(uint16_t i=0; i < SEGMENT_LENGTH; i++)
+  ws2812b_color Pixels[WS2812B_LEDS];
+  ws2812b_color c1 = span_pixel(color1), c2 = span_pixel(color2);
+  uint16_t length = SEGMENT_LENGTH;
+
+  mSeg->CounterModeStep = time_step() & 0x3;
+
+  for(uint16_t i=0; i < length; i++)
   {
-    if((i + Ws28b12b_Segments[mActualSegment].CounterModeStep) % 4 < 2)
-    {
-      if(IS_REVERSE) {
-    	  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color1);
-      } else {
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - i, color1);
-      }
+    if(IS_REVERSE) {
+      Pixels[i] = c1;	// Reversed segment has always been all color1
     } else {
-      if(IS_REVERSE) {
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color1);
-      } else {
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - i, color2);
-      }
+      Pixels[length - 1 - i] = ((i + mSeg->CounterModeStep) % 4 < 2) ? c1 : c2;
     }
   }
-
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) & 0x3;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetSpan(mSeg->IdStart, length, Pixels);
 }
 
 /*
@@ -1695,7 +2206,7 @@ void running(uint32_t color1, uint32_t color2)
  */
 void mode_running_color(void)
 {
-  return running(Ws28b12b_Segments[mActualSegment].ModeColor[0], WHITE);
+  return running(mSeg->ModeColor[0], WHITE);
 }
 
 
@@ -1728,26 +2239,24 @@ void mode_halloween(void)
  * Random colored pixels running.
  */
 void mode_running_random(void) {
-  for(uint16_t i=SEGMENT_LENGTH-1; i > 0; i--) {
-    if(IS_REVERSE) {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - i, WS2812B_GetColor(Ws28b12b_Segments[mActualSegment].IdStop - i + 1));
-    } else {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, WS2812B_GetColor(Ws28b12b_Segments[mActualSegment].IdStart + i - 1));
-    }
+  if(IS_REVERSE) {
+	  WS2812B_CopySpan(mSeg->IdStart, mSeg->IdStart + 1, SEGMENT_LENGTH - 1);
+  } else {
+	  WS2812B_CopySpan(mSeg->IdStart + 1, mSeg->IdStart, SEGMENT_LENGTH - 1);
   }
 
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep == 0)
+  if(mSeg->CounterModeStep == 0)
   {
-    Ws28b12b_Segments[mActualSegment].AuxParam = get_random_wheel_index(Ws28b12b_Segments[mActualSegment].AuxParam);
+    mSeg->AuxParam = get_random_wheel_index(mSeg->AuxParam);
     if(IS_REVERSE) {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop, color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam));
+    	WS2812B_SetDiodeColor(mSeg->IdStop, color_wheel(mSeg->AuxParam));
     } else {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart, color_wheel(Ws28b12b_Segments[mActualSegment].AuxParam));
+    	WS2812B_SetDiodeColor(mSeg->IdStart, color_wheel(mSeg->AuxParam));
     }
   }
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep == 0) ? 1 : 0;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->CounterModeStep = (mSeg->CounterModeStep == 0) ? 1 : 0;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1757,28 +2266,29 @@ void mode_running_random(void) {
 void mode_larson_scanner(void) {
   fade_out();
 
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep < SEGMENT_LENGTH)
+  if(mSeg->CounterModeStep < SEGMENT_LENGTH)
   {
     if(IS_REVERSE) {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - Ws28b12b_Segments[mActualSegment].CounterModeStep, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+    	WS2812B_SetDiodeColor(mSeg->IdStop - mSeg->CounterModeStep, mSeg->ModeColor[0]);
     } else {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + Ws28b12b_Segments[mActualSegment].CounterModeStep, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+    	WS2812B_SetDiodeColor(mSeg->IdStart + mSeg->CounterModeStep, mSeg->ModeColor[0]);
     }
   }
   else
   {
     if(IS_REVERSE) {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - ((SEGMENT_LENGTH * 2) - Ws28b12b_Segments[mActualSegment].CounterModeStep) + 2, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+    	WS2812B_SetDiodeColor(mSeg->IdStop - ((SEGMENT_LENGTH * 2) - mSeg->CounterModeStep) + 2, mSeg->ModeColor[0]);
     } else {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + ((SEGMENT_LENGTH * 2) - Ws28b12b_Segments[mActualSegment].CounterModeStep) - 2, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+    	WS2812B_SetDiodeColor(mSeg->IdStart + ((SEGMENT_LENGTH * 2) - mSeg->CounterModeStep) - 2, mSeg->ModeColor[0]);
     }
   }
 
-  if(Ws28b12b_Segments[mActualSegment].CounterModeStep % SEGMENT_LENGTH  == 0) Ws28b12b_Segments[mActualSegment].Cycle = 1;
-  else Ws28b12b_Segments[mActualSegment].Cycle = 1;
+  if(mSeg->CounterModeStep % SEGMENT_LENGTH  == 0) mSeg->Cycle = 1;
+  else mSeg->Cycle = 1;
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % ((SEGMENT_LENGTH * 2) - 2);
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  if(SEGMENT_LENGTH > 1) // Single diode has nowhere to go
+    mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % ((SEGMENT_LENGTH * 2) - 2);
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1789,13 +2299,13 @@ void mode_comet(void) {
   fade_out();
 
   if(IS_REVERSE) {
-	  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - Ws28b12b_Segments[mActualSegment].CounterModeStep, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+	  WS2812B_SetDiodeColor(mSeg->IdStop - mSeg->CounterModeStep, mSeg->ModeColor[0]);
   } else {
-	  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + Ws28b12b_Segments[mActualSegment].CounterModeStep, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+	  WS2812B_SetDiodeColor(mSeg->IdStart + mSeg->CounterModeStep, mSeg->ModeColor[0]);
   }
 
-  Ws28b12b_Segments[mActualSegment].CounterModeStep = (Ws28b12b_Segments[mActualSegment].CounterModeStep + 1) % SEGMENT_LENGTH;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) % SEGMENT_LENGTH;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 
@@ -1805,29 +2315,8 @@ void mode_comet(void) {
 void fireworks(uint32_t color) {
   fade_out();
 
-//// set brightness(i) = brightness(i-1)/4 + brightness(i) + brightness(i+1)/4
-/*
-// the old way, so many calls to the pokey getPixelColor() function made this super slow
-  for(uint16_t i=0 + 1; i <WS2812B_LEDS; i++) {
-    uint32_t prevLed = (Adafruit_NeoPixel::getPixelColor(i-1) >> 2) & 0x3F3F3F3F;
-    uint32_t thisLed = Adafruit_NeoPixel::getPixelColor(i);
-    uint32_t nextLed = (Adafruit_NeoPixel::getPixelColor(i+1) >> 2) & 0x3F3F3F3F;
-    WS2812B_SetDiodeColor(i, prevLed + thisLed + nextLed);
-  }
-*/
-
-// the new way, manipulate the Adafruit_NeoPixels pixels[] array directly, about 5x faster
-  uint8_t *pixels = WS2812B_GetPixels();
-  uint8_t pixelsPerLed = 3;
-  uint16_t startPixel = Ws28b12b_Segments[mActualSegment].IdStart * pixelsPerLed + pixelsPerLed;
-  uint16_t stopPixel = Ws28b12b_Segments[mActualSegment].IdStop * pixelsPerLed ;
-  for(uint16_t i=startPixel; i <stopPixel; i++)
-  {
-    uint16_t tmpPixel = (pixels[i - pixelsPerLed] >> 2) +
-      pixels[i] +
-      (pixels[i + pixelsPerLed] >> 2);
-    pixels[i] =  tmpPixel > 255 ? 255 : tmpPixel;
-  }
+  // set brightness(i) = brightness(i-1)/4 + brightness(i) + brightness(i+1)/4
+  WS2812B_BlurSpan(mSeg->IdStart, SEGMENT_LENGTH);
 
   if(!mTriggered)
   {
@@ -1835,7 +2324,7 @@ void fireworks(uint32_t color) {
     {
       if(rand()%10 == 0)
       {
-        WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + rand() % SEGMENT_LENGTH, color);
+        WS2812B_SetDiodeColor(mSeg->IdStart + rand() % SEGMENT_LENGTH, color);
       }
     }
   }
@@ -1843,10 +2332,10 @@ void fireworks(uint32_t color) {
   {
     for(uint16_t i=0; i<MAX(1, SEGMENT_LENGTH/10); i++)
     {
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + rand() % SEGMENT_LENGTH, color);
+      WS2812B_SetDiodeColor(mSeg->IdStart + rand() % SEGMENT_LENGTH, color);
     }
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 /*
@@ -1854,7 +2343,7 @@ void fireworks(uint32_t color) {
  */
 void mode_fireworks(void)
 {
-  return fireworks(Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+  return fireworks(mSeg->ModeColor[0]);
 }
 
 /*
@@ -1871,16 +2360,22 @@ void mode_fireworks_random(void)
  */
 void fire_flicker(int rev_intensity)
 {
-  uint8_t r = (Ws28b12b_Segments[mActualSegment].ModeColor[0] >> 16) & 0xFF;
-  uint8_t g = (Ws28b12b_Segments[mActualSegment].ModeColor[0] >>  8) & 0xFF;
-  uint8_t b = (Ws28b12b_Segments[mActualSegment].ModeColor[0]        & 0xFF);
+  uint8_t r = (mSeg->ModeColor[0] >> 16) & 0xFF;
+  uint8_t g = (mSeg->ModeColor[0] >>  8) & 0xFF;
+  uint8_t b = (mSeg->ModeColor[0]        & 0xFF);
   uint8_t lum = MAX(r, MAX(g, b)) / rev_intensity;
-  for(uint16_t i=Ws28b12b_Segments[mActualSegment].IdStart; i <= Ws28b12b_Segments[mActualSegment].IdStop; i++)
+  ws2812b_color Pixels[WS2812B_LEDS];
+
+  for(uint16_t i=0; i < SEGMENT_LENGTH; i++)
   {
-    int flicker = rand()%lum;
-    WS2812B_SetDiodeRGB(i, MAX(r - flicker, 0), MAX(g - flicker, 0), MAX(b - flicker, 0));
+    int flicker = rand();
+    flicker = lum ? flicker % lum : 0; // Black color - nothing to flicker
+    Pixels[i].red = MAX(r - flicker, 0);
+    Pixels[i].green = MAX(g - flicker, 0);
+    Pixels[i].blue = MAX(b - flicker, 0);
   }
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetSpan(mSeg->IdStart, SEGMENT_LENGTH, Pixels);
+  mSeg->ModeDelay = mSeg->Speed;
 }
 
 /*
@@ -1913,24 +2408,20 @@ void mode_fire_flicker_intense(void)
  */
 void tricolor_chase(uint32_t color1, uint32_t color2, uint32_t color3)
 {
-  uint16_t index = Ws28b12b_Segments[mActualSegment].CounterModeStep % 6;
-  for(uint16_t i=0; i < SEGMENT_LENGTH; i++, index++)
+  ws2812b_color Pixels[WS2812B_LEDS];
+  ws2812b_color c[3] = { span_pixel(color1), span_pixel(color2), span_pixel(color3) };
+  uint16_t length = SEGMENT_LENGTH;
+
+  mSeg->CounterModeStep = time_step();
+
+  uint16_t index = mSeg->CounterModeStep % 6;
+  for(uint16_t i=0; i < length; i++, index++)
   {
     if(index > 5) index = 0;
 
-    uint32_t color = color3;
-    if(index < 2) color = color1;
-    else if(index < 4) color = color2;
-
-    if(IS_REVERSE) {
-    	WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + i, color);
-    } else {
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStop - i, color);
-    }
+    Pixels[IS_REVERSE ? i : length - 1 - i] = c[index >> 1];
   }
-
-  Ws28b12b_Segments[mActualSegment].CounterModeStep++;
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+  WS2812B_SetSpan(mSeg->IdStart, length, Pixels);
 }
 
 
@@ -1939,7 +2430,7 @@ void tricolor_chase(uint32_t color1, uint32_t color2, uint32_t color3)
  */
 void mode_tricolor_chase(void)
 {
-  return tricolor_chase(Ws28b12b_Segments[mActualSegment].ModeColor[0], Ws28b12b_Segments[mActualSegment].ModeColor[1], Ws28b12b_Segments[mActualSegment].ModeColor[2]);
+  return tricolor_chase(mSeg->ModeColor[0], mSeg->ModeColor[1], mSeg->ModeColor[2]);
 }
 
 
@@ -1956,38 +2447,137 @@ void mode_circus_combustus(void)
  */
 void mode_icu(void)
 {
-  uint16_t dest = Ws28b12b_Segments[mActualSegment].CounterModeStep & 0xFFFF;
+  uint16_t dest = mSeg->CounterModeStep & 0xFFFF;
 
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest + WS2812B_LEDS/2, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+  WS2812B_SetDiodeColor(mSeg->IdStart + dest, mSeg->ModeColor[0]);
+  WS2812B_SetDiodeColor(mSeg->IdStart + dest + WS2812B_LEDS/2, mSeg->ModeColor[0]);
 
-  if(Ws28b12b_Segments[mActualSegment].AuxParam16b == dest)
+  if(mSeg->AuxParam16b == dest)
   { // pause between eye movements
     if(rand()%6 == 0)
     { // blink once in a while
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest, BLACK);
-      WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest + SEGMENT_LENGTH/2, BLACK);
-      Ws28b12b_Segments[mActualSegment].ModeDelay = 200;
+      WS2812B_SetDiodeColor(mSeg->IdStart + dest, BLACK);
+      WS2812B_SetDiodeColor(mSeg->IdStart + dest + SEGMENT_LENGTH/2, BLACK);
+      mSeg->ModeDelay = 200;
     }
-    Ws28b12b_Segments[mActualSegment].AuxParam16b = rand() %(SEGMENT_LENGTH/2);
-    Ws28b12b_Segments[mActualSegment].ModeDelay = 1000 + rand() %2000;
+    mSeg->AuxParam16b = (SEGMENT_LENGTH > 1) ? rand() %(SEGMENT_LENGTH/2) : 0;
+    mSeg->ModeDelay = 1000 + rand() %2000;
   }
 
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest, BLACK);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest + SEGMENT_LENGTH/2, BLACK);
+  WS2812B_SetDiodeColor(mSeg->IdStart + dest, BLACK);
+  WS2812B_SetDiodeColor(mSeg->IdStart + dest + SEGMENT_LENGTH/2, BLACK);
 
-  if(Ws28b12b_Segments[mActualSegment].AuxParam16b > Ws28b12b_Segments[mActualSegment].CounterModeStep)
+  if(mSeg->AuxParam16b > mSeg->CounterModeStep)
   {
-    Ws28b12b_Segments[mActualSegment].CounterModeStep++;
+    mSeg->CounterModeStep++;
     dest++;
-  } else if (Ws28b12b_Segments[mActualSegment].AuxParam16b < Ws28b12b_Segments[mActualSegment].CounterModeStep)
+  } else if (mSeg->AuxParam16b < mSeg->CounterModeStep)
   {
-    Ws28b12b_Segments[mActualSegment].CounterModeStep--;
+    mSeg->CounterModeStep--;
     dest--;
   }
 
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
-  WS2812B_SetDiodeColor(Ws28b12b_Segments[mActualSegment].IdStart + dest + SEGMENT_LENGTH/2, Ws28b12b_Segments[mActualSegment].ModeColor[0]);
+  WS2812B_SetDiodeColor(mSeg->IdStart + dest, mSeg->ModeColor[0]);
+  WS2812B_SetDiodeColor(mSeg->IdStart + dest + SEGMENT_LENGTH/2, mSeg->ModeColor[0]);
+
+  mSeg->ModeDelay = mSeg->Speed;
+}
+
+/*
+ * Palette spread over the segment, moving.
+ */
+void mode_palette_cycle(void)
+{
+  ws2812b_color Pixels[WS2812B_LEDS];
+  uint16_t length = SEGMENT_LENGTH;
+
+  mSeg->CounterModeStep = time_step() & 0xFF;
+
+  uint32_t index = (mSeg->CounterModeStep & 0xFF) << 8; // 8.8 fixed point
+  uint32_t step = (256 << 8) / length;
+
+  for(uint16_t i=0; i < length; i++)
+  {
+    Pixels[IS_REVERSE ? length - 1 - i : i] = span_pixel(WS2812BFX_ColorFromPalette(mSeg->Palette, (index >> 8) & 0xFF));
+    index += step;
+  }
+  WS2812B_SetSpan(mSeg->IdStart, length, Pixels);
+}
+
+/*
+ * Whole segment goes through the palette.
+ */
+void mode_palette_solid(void)
+{
+  WS2812B_FillSpan(mSeg->IdStart, SEGMENT_LENGTH,
+		  WS2812BFX_ColorFromPalette(mSeg->Palette, mSeg->CounterModeStep));
+
+  mSeg->CounterModeStep = (mSeg->CounterModeStep + 1) & 0xFF;
+  mSeg->ModeDelay = mSeg->Speed;
+}
+
+/*
+ * Random palette colors blinking on, fading out.
+ */
+void mode_palette_twinkle(void)
+{
+  twinkle_fade(WS2812BFX_ColorFromPalette(mSeg->Palette, rand() % 256));
+}
+
+/*
+ * Diagonal rainbow moving over the matrix.
+ */
+void mode_matrix_rainbow(void)
+{
+  mSeg->CounterModeStep = time_step() & 0xFF;
+
+  for(uint8_t y=0; y < MATRIX_HEIGHT; y++)
+  {
+    for(uint8_t x=0; x < MATRIX_WIDTH; x++)
+    {
+      WS2812B_MatrixSetPixel(x, y, color_wheel((((x + y) << 4) + mSeg->CounterModeStep) & 0xFF));
+    }
+  }
+}
+
+/*
+ * Drops of _color falling down the matrix, leaving fading trails.
+ */
+void mode_matrix_rain(void)
+{
+  for(uint8_t y=MATRIX_HEIGHT-1; y > 0; y--)
+  {
+    WS2812B_MatrixCopyRow(y, y - 1);
+  }
+
+  for(uint8_t x=0; x < MATRIX_WIDTH; x++)
+  {
+    if(rand() % 8 == 0)
+    {
+      WS2812B_MatrixSetPixel(x, 0, mSeg->ModeColor[0]);
+    }
+    else
+    {
+      WS2812B_MatrixSetPixel(x, 0, color_blend(WS2812B_MatrixGetPixel(x, 0), mSeg->ModeColor[1], 128));
+    }
+  }
+  mSeg->ModeDelay = mSeg->Speed;
+}
 
-  Ws28b12b_Segments[mActualSegment].ModeDelay = Ws28b12b_Segments[mActualSegment].Speed;
+/*
+ * Sine plasma colored with segment's palette.
+ */
+void mode_matrix_plasma(void)
+{
+  uint8_t t = mSeg->CounterModeStep = time_step() & 0xFF;
+
+  for(uint8_t y=0; y < MATRIX_HEIGHT; y++)
+  {
+    uint8_t sy = sine8((y << 5) + t);
+    for(uint8_t x=0; x < MATRIX_WIDTH; x++)
+    {
+      uint8_t index = (sine8((x << 5) - t) + sy) >> 1;
+      WS2812B_MatrixSetPixel(x, y, WS2812BFX_ColorFromPalette(mSeg->Palette, index + (t >> 1)));
+    }
+  }
 }
@@ -0,0 +1,180 @@
+/*
+ * ws2812b_matrix.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "ws2812b.h"
+#include "ws2812b_matrix.h"
+
+//
+//	(x, y) to diode index lookup table
+//
+//	Whole table is computed by the preprocessor, so it lives in flash and there is
+//	no mirroring, rotation or serpentine math at runtime.
+//
+
+// Mirroring on logical coordinates
+#define MAP_MX(x)			(MATRIX_MIRROR_X ? (MATRIX_WIDTH - 1 - (x)) : (x))
+#define MAP_MY(y)			(MATRIX_MIRROR_Y ? (MATRIX_HEIGHT - 1 - (y)) : (y))
+
+// Rotation from logical to physical coordinates
+#if MATRIX_ROTATION == 0
+#define MAP_PX(x, y)		(x)
+#define MAP_PY(x, y)		(y)
+#elif MATRIX_ROTATION == 1
+#define MAP_PX(x, y)		(y)
+#define MAP_PY(x, y)		(MATRIX_PHYS_HEIGHT - 1 - (x))
+#elif MATRIX_ROTATION == 2
+#define MAP_PX(x, y)		(MATRIX_PHYS_WIDTH - 1 - (x))
+#define MAP_PY(x, y)		(MATRIX_PHYS_HEIGHT - 1 - (y))
+#else
+#define MAP_PX(x, y)		(MATRIX_PHYS_WIDTH - 1 - (y))
+#define MAP_PY(x, y)		(x)
+#endif
+
+// Physical coordinates to strip index
+#define MAP_SERP(px, py)	((MATRIX_SERPENTINE && ((py) & 1)) ? (MATRIX_PHYS_WIDTH - 1 - (px)) : (px))
+#define MAP_INDEX(px, py)	(MATRIX_OFFSET + ((py) * MATRIX_PHYS_WIDTH) + MAP_SERP(px, py))
+
+#define MAP_XY(x, y)		((((x) < MATRIX_WIDTH) && ((y) < MATRIX_HEIGHT)) ? \
+								MAP_INDEX(MAP_PX(MAP_MX(x), MAP_MY(y)), MAP_PY(MAP_MX(x), MAP_MY(y))) : MATRIX_NONE)
+
+#define MAP_ROW(y)			{ MAP_XY(0, y), MAP_XY(1, y), MAP_XY(2, y), MAP_XY(3, y), \
+							  MAP_XY(4, y), MAP_XY(5, y), MAP_XY(6, y), MAP_XY(7, y), \
+							  MAP_XY(8, y), MAP_XY(9, y), MAP_XY(10, y), MAP_XY(11, y), \
+							  MAP_XY(12, y), MAP_XY(13, y), MAP_XY(14, y), MAP_XY(15, y) }
+
+static const uint16_t mMatrixMap[MATRIX_MAX_SIZE][MATRIX_MAX_SIZE] =
+{
+	MAP_ROW(0), MAP_ROW(1), MAP_ROW(2), MAP_ROW(3),
+	MAP_ROW(4), MAP_ROW(5), MAP_ROW(6), MAP_ROW(7),
+	MAP_ROW(8), MAP_ROW(9), MAP_ROW(10), MAP_ROW(11),
+	MAP_ROW(12), MAP_ROW(13), MAP_ROW(14), MAP_ROW(15)
+};
+
+static uint16_t mClipFirst = 0, mClipLast = WS2812B_LEDS - 1;
+
+static inline ws2812b_color *MatrixPixels(void)
+{
+	return (ws2812b_color*)WS2812B_GetPixels();
+}
+
+static inline uint8_t InClip(uint16_t i)
+{
+	return (i >= mClipFirst) && (i <= mClipLast);
+}
+
+static inline void PixelSet(ws2812b_color *pixels, uint16_t i, uint32_t color)
+{
+	if(!InClip(i)) return;
+	pixels[i].red = ((color>>16)&0xFF);
+	pixels[i].green = ((color>>8)&0xFF);
+	pixels[i].blue = (color&0xFF);
+}
+
+static inline void PixelCopy(ws2812b_color *pixels, uint16_t dst, uint16_t src)
+{
+	const ws2812b_color Black = { 0, 0, 0 };
+
+	if(!InClip(dst)) return;
+	pixels[dst] = InClip(src) ? pixels[src] : Black;
+}
+
+//
+//	Strip window the matrix may touch, diodes out of it are not written and read as black.
+//	FX sets it to the running segment, so a matrix mode stays inside its segment like 1D ones.
+//
+void WS2812B_MatrixClip(uint16_t first, uint16_t last)
+{
+	mClipFirst = first;
+	mClipLast = last;
+}
+
+uint16_t WS2812B_MatrixXY(uint8_t x, uint8_t y)
+{
+	if(x >= MATRIX_WIDTH || y >= MATRIX_HEIGHT) return MATRIX_NONE;
+	return mMatrixMap[y][x];
+}
+
+void WS2812B_MatrixSetPixel(uint8_t x, uint8_t y, uint32_t color)
+{
+	if(x >= MATRIX_WIDTH || y >= MATRIX_HEIGHT) return;
+	PixelSet(MatrixPixels(), mMatrixMap[y][x], color);
+}
+
+uint32_t WS2812B_MatrixGetPixel(uint8_t x, uint8_t y)
+{
+	if(x >= MATRIX_WIDTH || y >= MATRIX_HEIGHT) return 0;
+	if(!InClip(mMatrixMap[y][x])) return 0;
+	return WS2812B_GetColor(mMatrixMap[y][x]);
+}
+
+//
+//	2D span functions
+//	Range is checked once per call and clipped to the matrix, every diode to the window
+//
+void WS2812B_MatrixFillRow(uint8_t y, uint8_t x, uint8_t count, uint32_t color)
+{
+	if(x >= MATRIX_WIDTH || y >= MATRIX_HEIGHT) return;
+	if(count > (MATRIX_WIDTH - x)) count = MATRIX_WIDTH - x;
+
+	ws2812b_color *pixels = MatrixPixels();
+	const uint16_t *map = &mMatrixMap[y][x];
+	while(count--)
+	{
+		PixelSet(pixels, *map++, color);
+	}
+}
+
+void WS2812B_MatrixFillColumn(uint8_t x, uint8_t y, uint8_t count, uint32_t color)
+{
+	if(x >= MATRIX_WIDTH || y >= MATRIX_HEIGHT) return;
+	if(count > (MATRIX_HEIGHT - y)) count = MATRIX_HEIGHT - y;
+
+	ws2812b_color *pixels = MatrixPixels();
+	for(; count; count--, y++)
+	{
+		PixelSet(pixels, mMatrixMap[y][x], color);
+	}
+}
+
+void WS2812B_MatrixFillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint32_t color)
+{
+	if(x >= MATRIX_WIDTH || y >= MATRIX_HEIGHT) return;
+	if(h > (MATRIX_HEIGHT - y)) h = MATRIX_HEIGHT - y;
+
+	for(; h; h--, y++)
+	{
+		WS2812B_MatrixFillRow(y, x, w, color);
+	}
+}
+
+void WS2812B_MatrixCopyRow(uint8_t dst_y, uint8_t src_y)
+{
+	if(dst_y >= MATRIX_HEIGHT || src_y >= MATRIX_HEIGHT) return;
+
+	ws2812b_color *pixels = MatrixPixels();
+	const uint16_t *dst = mMatrixMap[dst_y];
+	const uint16_t *src = mMatrixMap[src_y];
+	for(uint8_t x = 0; x < MATRIX_WIDTH; x++)
+	{
+		PixelCopy(pixels, dst[x], src[x]);
+	}
+}
+
+void WS2812B_MatrixCopyColumn(uint8_t dst_x, uint8_t src_x)
+{
+	if(dst_x >= MATRIX_WIDTH || src_x >= MATRIX_WIDTH) return;
+
+	ws2812b_color *pixels = MatrixPixels();
+	for(uint8_t y = 0; y < MATRIX_HEIGHT; y++)
+	{
+		PixelCopy(pixels, mMatrixMap[y][dst_x], mMatrixMap[y][src_x]);
+	}
+}
@@ -0,0 +1,284 @@
+/*
+ * ws2812b_scene.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#include "stm32f1xx_hal.h"
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+#include "ws2812b_scene.h"
+
+#define SCENE_MAGIC		0x5CE1
+#define SCENE_VERSION	1
+#define SCENE_ERASED	0xFFFF
+
+#define SCENE_FLAG_REVERSE	(1<<0)
+#define SCENE_FLAG_RUNNING	(1<<1)
+
+#if SCENE_MAX_SIZE > FLASH_PAGE_SIZE
+#error "Scene record does not fit in a flash page"
+#endif
+
+//
+//	Record, all fields little endian:
+//
+//	0	Magic			uint16
+//	2	Length			uint16	whole record, even
+//	4	Sequence		uint16	newer record has higher number (wrapping)
+//	6	CRC				uint16	CRC-16/CCITT of bytes 8..Length-1
+//	8	Version			uint8
+//	9	Segments		uint8
+//	10	Segment[]		SCENE_SEGMENT_SIZE each:
+//		+0	Start		uint16
+//		+2	Stop		uint16
+//		+4	Mode		uint8
+//		+5	Flags		uint8	SCENE_FLAG_*
+//		+6	Speed		uint16
+//		+8	Transition	uint16
+//		+10	Palette		uint8
+//		+11	Colors		NUM_COLORS * RGB
+//
+static uint8_t SceneRecord[SCENE_MAX_SIZE] __attribute__((aligned(2)));
+
+static uint16_t Crc16(const uint8_t *Buf, uint16_t Length)
+{
+	uint16_t Crc = 0xFFFF;
+
+	while(Length--)
+	{
+		Crc ^= (uint16_t)(*Buf++) << 8;
+		for(uint8_t i = 0; i < 8; i++)
+			Crc = (Crc & 0x8000) ? ((Crc << 1) ^ 0x1021) : (Crc << 1);
+	}
+	return Crc;
+}
+
+static void Put16(uint8_t *Buf, uint16_t Value)
+{
+	Buf[0] = Value & 0xFF;
+	Buf[1] = Value >> 8;
+}
+
+static uint16_t Get16(const uint8_t *Buf)
+{
+	return Buf[0] | (Buf[1] << 8);
+}
+
+//
+//	Current FX setup into Buf (SCENE_MAX_SIZE bytes). Returns record length.
+//
+uint16_t WS2812BFX_SceneSerialize(uint8_t *Buf, uint16_t Sequence)
+{
+	uint8_t Segments = WS2812BFX_GetSegmentsQuantity();
+	uint16_t Length = SCENE_HEADER_SIZE + 2 + Segments * SCENE_SEGMENT_SIZE;
+	uint8_t *p = &Buf[SCENE_HEADER_SIZE + 2];
+
+	Buf[SCENE_HEADER_SIZE] = SCENE_VERSION;
+	Buf[SCENE_HEADER_SIZE + 1] = Segments;
+
+	for(uint8_t i = 0; i < Segments; i++)
+	{
+		uint16_t Start, Stop, Speed, Transition;
+		fx_mode Mode;
+		uint8_t Reverse, Running, Palette;
+		uint32_t Color;
+
+		WS2812BFX_GetSegmentSize(i, &Start, &Stop);
+		WS2812BFX_GetMode(i, &Mode);
+		WS2812BFX_GetReverse(i, &Reverse);
+		WS2812BFX_IsRunning(i, &Running);
+		WS2812BFX_GetSpeed(i, &Speed);
+		WS2812BFX_GetTransition(i, &Transition);
+		WS2812BFX_GetPalette(i, &Palette);
+
+		Put16(&p[0], Start);
+		Put16(&p[2], Stop);
+		p[4] = Mode;
+		p[5] = (Reverse ? SCENE_FLAG_REVERSE : 0) | (Running ? SCENE_FLAG_RUNNING : 0);
+		Put16(&p[6], Speed);
+		Put16(&p[8], Transition);
+		p[10] = Palette;
+		for(uint8_t j = 0; j < NUM_COLORS; j++)
+		{
+			WS2812BFX_GetSegmentColor(i, j, &Color);
+			p[11 + j * 3] = Color >> 16;
+			p[12 + j * 3] = Color >> 8;
+			p[13 + j * 3] = Color;
+		}
+		p += SCENE_SEGMENT_SIZE;
+	}
+
+	Put16(&Buf[0], SCENE_MAGIC);
+	Put16(&Buf[2], Length);
+	Put16(&Buf[4], Sequence);
+	Put16(&Buf[6], Crc16(&Buf[SCENE_HEADER_SIZE], Length - SCENE_HEADER_SIZE));
+	return Length;
+}
+
+static uint8_t SceneValid(const uint8_t *Buf, uint16_t Length)
+{
+	if(Length < SCENE_HEADER_SIZE + 2) return 0;
+	if(Get16(&Buf[0]) != SCENE_MAGIC) return 0;
+	if(Get16(&Buf[2]) != Length) return 0;
+	if(Get16(&Buf[6]) != Crc16(&Buf[SCENE_HEADER_SIZE], Length - SCENE_HEADER_SIZE)) return 0;
+	if(Buf[SCENE_HEADER_SIZE] != SCENE_VERSION) return 0;
+	if(Buf[SCENE_HEADER_SIZE + 1] == 0 || Buf[SCENE_HEADER_SIZE + 1] > WS2812B_LEDS) return 0;
+	if(Length != SCENE_HEADER_SIZE + 2 + Buf[SCENE_HEADER_SIZE + 1] * SCENE_SEGMENT_SIZE) return 0;
+
+	const uint8_t *p = &Buf[SCENE_HEADER_SIZE + 2];
+	for(uint8_t i = 0; i < Buf[SCENE_HEADER_SIZE + 1]; i++, p += SCENE_SEGMENT_SIZE)
+	{
+		if(Get16(&p[0]) > Get16(&p[2])) return 0;
+		if(Get16(&p[2]) >= WS2812B_LEDS) return 0;
+		if(p[4] >= MODE_COUNT) return 0;
+		if(p[10] >= PALETTE_COUNT) return 0;
+	}
+	return 1;
+}
+
+//
+//	Whole record is checked before FX is touched, so a bad record leaves current setup
+//
+FX_STATUS WS2812BFX_SceneDeserialize(const uint8_t *Buf, uint16_t Length)
+{
+	if(!SceneValid(Buf, Length)) return FX_ERROR;
+
+	uint8_t Segments = Buf[SCENE_HEADER_SIZE + 1];
+	const uint8_t *p = &Buf[SCENE_HEADER_SIZE + 2];
+
+	if(WS2812BFX_Init(Segments) != FX_OK) return FX_ERROR;
+
+	for(uint8_t i = 0; i < Segments; i++, p += SCENE_SEGMENT_SIZE)
+	{
+		WS2812BFX_SetSegmentSize(i, Get16(&p[0]), Get16(&p[2]));
+		WS2812BFX_SetSpeed(i, Get16(&p[6]));
+		WS2812BFX_SetReverse(i, (p[5] & SCENE_FLAG_REVERSE) ? 1 : 0);
+		WS2812BFX_SetPalette(i, p[10]);
+		for(uint8_t j = 0; j < NUM_COLORS; j++)
+			WS2812BFX_SetColorRGB(j, p[11 + j * 3], p[12 + j * 3], p[13 + j * 3]);
+		WS2812BFX_SetMode(i, p[4]);	// Takes the colors
+		WS2812BFX_SetTransition(i, Get16(&p[8]));
+		if(p[5] & SCENE_FLAG_RUNNING)
+			WS2812BFX_Start(i);
+		else
+			WS2812BFX_Stop(i);
+	}
+	return FX_OK;
+}
+
+//
+//	Log scan
+//
+//	Newest - address of the newest valid record, 0 if none
+//	Free - first free address in each page, 0 if the page holds garbage
+//
+static uint32_t SceneScan(uint32_t Free[SCENE_FLASH_PAGES])
+{
+	uint32_t Newest = 0;
+	uint16_t NewestSeq = 0;
+
+	for(uint8_t Page = 0; Page < SCENE_FLASH_PAGES; Page++)
+	{
+		uint32_t Addr = SCENE_FLASH_START + Page * FLASH_PAGE_SIZE;
+		uint32_t End = Addr + FLASH_PAGE_SIZE;
+
+		Free[Page] = 0;
+		while(Addr + SCENE_HEADER_SIZE <= End)
+		{
+			const uint8_t *Rec = (const uint8_t*)Addr;
+			uint16_t Length = Get16(&Rec[2]);
+
+			if(Get16(&Rec[0]) == SCENE_ERASED)
+			{
+				Free[Page] = Addr;
+				break;
+			}
+			if(Get16(&Rec[0]) != SCENE_MAGIC || Length < SCENE_HEADER_SIZE || (Length & 1) || Addr + Length > End)
+				break;	// Page is not usable until erased
+
+			if(SceneValid(Rec, Length) && (!Newest || (int16_t)(Get16(&Rec[4]) - NewestSeq) > 0))
+			{
+				Newest = Addr;
+				NewestSeq = Get16(&Rec[4]);
+			}
+			Addr += Length;	// Torn records are skipped by their length
+		}
+	}
+	return Newest;
+}
+
+static FX_STATUS SceneErasePage(uint8_t Page)
+{
+	FLASH_EraseInitTypeDef Erase;
+	uint32_t PageError;
+
+	Erase.TypeErase = FLASH_TYPEERASE_PAGES;
+	Erase.PageAddress = SCENE_FLASH_START + Page * FLASH_PAGE_SIZE;
+	Erase.NbPages = 1;
+	return (HAL_FLASHEx_Erase(&Erase, &PageError) == HAL_OK) ? FX_OK : FX_ERROR;
+}
+
+FX_STATUS WS2812BFX_SceneSave(void)
+{
+	uint32_t Free[SCENE_FLASH_PAGES];
+	uint32_t Newest = SceneScan(Free);
+	uint8_t Page = 0;
+	uint16_t Sequence = 0;
+	uint32_t Addr;
+	FX_STATUS Status = FX_OK;
+
+	if(Newest)
+	{
+		Page = (Newest - SCENE_FLASH_START) / FLASH_PAGE_SIZE;
+		Sequence = Get16(&((const uint8_t*)Newest)[4]) + 1;
+	}
+
+	uint16_t Length = WS2812BFX_SceneSerialize(SceneRecord, Sequence);
+
+	HAL_FLASH_Unlock();
+
+	Addr = Free[Page];
+	if(!Addr || Addr + Length > SCENE_FLASH_START + (Page + 1) * FLASH_PAGE_SIZE)
+	{
+		if(Newest)	// Current page full - move on, newest record stays until next wrap
+			Page = (Page + 1) % SCENE_FLASH_PAGES;
+
+		Addr = SCENE_FLASH_START + Page * FLASH_PAGE_SIZE;
+		Status = SceneErasePage(Page);
+	}
+
+	for(uint16_t i = 0; i < Length && Status == FX_OK; i += 2)
+	{
+		if(HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Addr + i, Get16(&SceneRecord[i])) != HAL_OK)
+			Status = FX_ERROR;
+	}
+
+	HAL_FLASH_Lock();
+	return Status;
+}
+
+FX_STATUS WS2812BFX_SceneLoad(void)
+{
+	uint32_t Free[SCENE_FLASH_PAGES];
+	uint32_t Newest = SceneScan(Free);
+
+	if(!Newest) return FX_ERROR;
+
+	return WS2812BFX_SceneDeserialize((const uint8_t*)Newest, Get16(&((const uint8_t*)Newest)[2]));
+}
+
+FX_STATUS WS2812BFX_SceneClear(void)
+{
+	FX_STATUS Status = FX_OK;
+
+	HAL_FLASH_Unlock();
+	for(uint8_t Page = 0; Page < SCENE_FLASH_PAGES && Status == FX_OK; Page++)
+		Status = SceneErasePage(Page);
+	HAL_FLASH_Lock();
+	return Status;
+}
@@ -0,0 +1,208 @@
+/*
+ * ws2812b_sequence.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#include "stm32f1xx_hal.h"
+#include <string.h>
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+#include "ws2812b_sequence.h"
+
+static uint8_t mProgram[SEQUENCE_SIZE];
+static uint16_t mLength;			// Bytes uploaded
+
+static uint8_t mRunning;
+static uint16_t mPc;
+static uint32_t mWaitUntil;		// Shared time when current WAIT ends
+static uint8_t mWaiting;
+
+static struct
+{
+	uint16_t Start;				// First instruction after REPEAT
+	uint8_t Left;				// Repeats left, 0 - forever
+} mStack[SEQUENCE_DEPTH];
+static uint8_t mDepth;
+
+static const uint8_t mOperands[SEQ_OPCODE_COUNT] =
+{
+	[SEQ_END] = 0,
+	[SEQ_MODE] = 2,
+	[SEQ_COLOR] = 4,
+	[SEQ_SPEED] = 3,
+	[SEQ_WAIT] = 2,
+	[SEQ_REPEAT] = 1,
+	[SEQ_ENDREPEAT] = 0,
+	[SEQ_XFADE] = 4,
+	[SEQ_START] = 1,
+	[SEQ_STOP] = 1,
+};
+
+static uint16_t Get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+//
+//	Whole program check - opcodes, operands inside the slot, modes, REPEAT nesting
+//
+static FX_STATUS SequenceVerify(void)
+{
+	uint16_t Pc = 0;
+	uint8_t Depth = 0;
+
+	while(Pc < mLength)
+	{
+		uint8_t Op = mProgram[Pc];
+
+		if(Op >= SEQ_OPCODE_COUNT) return FX_ERROR;
+		if(Pc + 1 + mOperands[Op] > mLength) return FX_ERROR;
+
+		switch(Op)
+		{
+		case SEQ_END:
+			return (Depth == 0) ? FX_OK : FX_ERROR;
+		case SEQ_MODE:
+		case SEQ_XFADE:
+			if(mProgram[Pc + 2] >= MODE_COUNT) return FX_ERROR;
+			break;
+		case SEQ_COLOR:
+			if(mProgram[Pc + 1] >= NUM_COLORS) return FX_ERROR;
+			break;
+		case SEQ_REPEAT:
+			if(++Depth > SEQUENCE_DEPTH) return FX_ERROR;
+			break;
+		case SEQ_ENDREPEAT:
+			if(Depth-- == 0) return FX_ERROR;
+			break;
+		}
+		Pc += 1 + mOperands[Op];
+	}
+	return FX_ERROR;	// No END
+}
+
+FX_STATUS WS2812BFX_SequenceWrite(uint16_t Offset, const uint8_t *Code, uint16_t Length)
+{
+	if(Offset > SEQUENCE_SIZE || Length > SEQUENCE_SIZE - Offset) return FX_ERROR;
+
+	mRunning = 0;
+	memcpy(&mProgram[Offset], Code, Length);
+	if(Offset + Length > mLength)
+		mLength = Offset + Length;
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_SequenceClear(void)
+{
+	mRunning = 0;
+	mLength = 0;
+	return FX_OK;
+}
+
+FX_STATUS WS2812BFX_SequenceStart(void)
+{
+	if(SequenceVerify() != FX_OK) return FX_ERROR;
+
+	mPc = 0;
+	mDepth = 0;
+	mWaiting = 0;
+	mWaitUntil = WS2812BFX_GetTime();
+	mRunning = 1;
+	return FX_OK;
+}
+
+void WS2812BFX_SequenceStop(void)
+{
+	mRunning = 0;
+}
+
+uint8_t WS2812BFX_SequenceIsRunning(void)
+{
+	return mRunning;
+}
+
+uint16_t WS2812BFX_SequenceGetLength(void)
+{
+	return mLength;
+}
+
+//
+//	Main loop part, next to WS2812BFX_Callback
+//
+void WS2812BFX_SequenceCallback(void)
+{
+	if(!mRunning) return;
+
+	if(mWaiting)
+	{
+		if((int32_t)(WS2812BFX_GetTime() - mWaitUntil) < 0) return;
+		mWaiting = 0;
+	}
+
+	for(uint8_t Step = 0; Step < SEQUENCE_STEPS; Step++)
+	{
+		const uint8_t *p = &mProgram[mPc];
+
+		mPc += 1 + mOperands[p[0]];
+
+		switch(p[0])
+		{
+		case SEQ_END:
+			mRunning = 0;
+			return;
+
+		case SEQ_MODE:
+			WS2812BFX_SetMode(p[1], p[2]);
+			break;
+
+		case SEQ_COLOR:
+			WS2812BFX_SetColorRGB(p[1], p[2], p[3], p[4]);
+			break;
+
+		case SEQ_SPEED:
+			WS2812BFX_SetSpeed(p[1], Get16(&p[2]));
+			break;
+
+		case SEQ_WAIT:
+			mWaitUntil += Get16(&p[1]);
+			mWaiting = 1;
+			return;
+
+		case SEQ_REPEAT:
+			mStack[mDepth].Start = mPc;
+			mStack[mDepth].Left = p[1];
+			mDepth++;
+			break;
+
+		case SEQ_ENDREPEAT:
+			if(mStack[mDepth - 1].Left == 0 || --mStack[mDepth - 1].Left)	// Forever or not done yet
+				mPc = mStack[mDepth - 1].Start;
+			else
+				mDepth--;
+			break;
+
+		case SEQ_XFADE:	// Segment's own transition time is kept for plain MODE
+		{
+			uint16_t Time = 0;
+			WS2812BFX_GetTransition(p[1], &Time);
+			WS2812BFX_SetTransition(p[1], Get16(&p[3]));
+			WS2812BFX_SetMode(p[1], p[2]);
+			WS2812BFX_SetTransition(p[1], Time);
+			break;
+		}
+
+		case SEQ_START:
+			WS2812BFX_Start(p[1]);
+			break;
+
+		case SEQ_STOP:
+			WS2812BFX_Stop(p[1]);
+			break;
+		}
+	}
+}
@@ -0,0 +1,275 @@
+/*
+ * delta_enc.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Delta frame encoder and savings report
+//
+//	Reads recorded frames - PPM images from fx_render with -z 1, one row per frame -
+//	and encodes each against the previous one as a TPM2 delta frame (see usb_stream.h).
+//	Both the full TPM2 frame and the delta frame go through the real USB_StreamReceive
+//	on separate passes, so the decoder in usb_stream.c checks the encoder: after every
+//	frame the strip has to match the recorded row, otherwise exit code is 1.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o delta_enc Tools/delta_enc/delta_enc.c Core/Src/usb_stream.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c
+//
+//	Example - a frame set from a few modes, 50 fps:
+//
+//	for m in 0 2 8 12 20 45; do ./fx_render -m $m -z 1 -f 20 -t 10000 -o mode$m.ppm; done
+//	./delta_enc mode*.ppm
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ws2812b.h"
+#include "usb_stream.h"
+#include "usb_parsing.h"
+
+#define DELTA_MAX_LEDS		1024
+#define DELTA_RECORD		64		// Pixels in one record
+#define DELTA_SKIP			0x00
+#define DELTA_LITERAL		0x40
+#define DELTA_RUN			0x80
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+
+static uint8_t Frame[4 + DELTA_MAX_LEDS * 4 + 1];	// Worst case delta - every pixel a literal of one
+
+//
+//	HAL stand-in. Refresh never completes, frames are read from the pixel buffer.
+//
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+uint8_t USB_ParsingTransmit(const uint8_t *Buf, uint16_t Len)
+{
+	(void)Buf; (void)Len;
+	return 1;
+}
+
+static uint8_t Same(const uint8_t *a, const uint8_t *b)
+{
+	return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+//
+//	Delta payload of Next against Prev, Count pixels. Unchanged pixels are skipped,
+//	a changed pixel repeated at least twice is a run, the rest go in literals.
+//	Unchanged pixels at the end are left out. Returns the payload size.
+//
+static uint32_t DeltaEncode(const uint8_t *Prev, const uint8_t *Next, uint32_t Count, uint8_t *Out)
+{
+	uint32_t n = 0, i = 0, Literal = 0;	// Literal - position of the open literal header, 0 - none
+	uint32_t End = Count;
+
+	while(End && Same(&Prev[(End - 1) * 3], &Next[(End - 1) * 3]))
+		End--;
+
+	while(i < End)
+	{
+		uint32_t k = 1;
+
+		if(Same(&Prev[i * 3], &Next[i * 3]))
+		{
+			while(i + k < End && k < DELTA_RECORD && Same(&Prev[(i + k) * 3], &Next[(i + k) * 3]))
+				k++;
+			Out[n++] = DELTA_SKIP | (k - 1);
+			Literal = 0;
+		}
+		else
+		{
+			while(i + k < End && k < DELTA_RECORD && Same(&Next[i * 3], &Next[(i + k) * 3]))
+				k++;
+
+			if(k > 1)
+			{
+				Out[n++] = DELTA_RUN | (k - 1);
+				memcpy(&Out[n], &Next[i * 3], 3);
+				n += 3;
+				Literal = 0;
+			}
+			else
+			{
+				if(!Literal || (Out[Literal - 1] & 0x3F) == DELTA_RECORD - 1)
+				{
+					Out[n++] = DELTA_LITERAL;
+					Literal = n;
+				}
+				else
+					Out[Literal - 1]++;
+				memcpy(&Out[n], &Next[i * 3], 3);
+				n += 3;
+			}
+		}
+		i += k;
+	}
+	return n;
+}
+
+static uint32_t Tpm2(uint8_t Type, const uint8_t *Payload, uint32_t Size)
+{
+	Frame[0] = 0xC9;
+	Frame[1] = Type;
+	Frame[2] = Size >> 8;
+	Frame[3] = Size & 0xFF;
+	memmove(&Frame[4], Payload, Size);
+	Frame[4 + Size] = 0x36;
+	return Size + 5;
+}
+
+//
+//	Frame in, presented and compared with the row
+//
+static int Send(uint32_t Length, const uint8_t *Row, uint32_t Count)
+{
+	uint32_t Shown = (Count < WS2812B_LEDS) ? Count : WS2812B_LEDS;
+
+	if(USB_StreamReceive(Frame, Length) != Length)
+		return 1;
+	USB_StreamTask();
+	return memcmp(WS2812B_GetPixels(), Row, Shown * 3) != 0;
+}
+
+//
+//	Skips past 65536 pixels followed by a literal - it has to land off the strip,
+//	not wrap to LED 0
+//
+static int SkipWrap(void)
+{
+	static uint8_t Payload[1024 + 4];
+	uint8_t Before[3];
+	uint32_t n = 0;
+
+	memcpy(Before, WS2812B_GetPixels(), 3);
+	while(n < 1024)
+		Payload[n++] = DELTA_SKIP | (DELTA_RECORD - 1);
+	Payload[n++] = DELTA_LITERAL;
+	Payload[n++] = Before[0] ^ 0xFF;
+	Payload[n++] = Before[1] ^ 0xFF;
+	Payload[n++] = Before[2] ^ 0xFF;
+
+	return Send(Tpm2(0xDE, Payload, n), Before, 1);
+}
+
+static uint8_t* ReadPpm(const char *Name, uint32_t *Width, uint32_t *Height)
+{
+	FILE *f = fopen(Name, "rb");
+	unsigned w, h, Max;
+	uint8_t *Data = NULL;
+
+	if(!f)
+		return NULL;
+	if(fscanf(f, "P6 %u %u %u", &w, &h, &Max) == 3 && Max == 255 && fgetc(f) != EOF &&
+		w && w <= DELTA_MAX_LEDS && h && (Data = malloc((size_t)w * h * 3)) &&
+		fread(Data, 3, (size_t)w * h, f) == (size_t)w * h)
+	{
+		*Width = w;
+		*Height = h;
+	}
+	else
+	{
+		free(Data);
+		Data = NULL;
+	}
+	fclose(f);
+	return Data;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t Payload[DELTA_MAX_LEDS * 4];
+	static uint8_t Black[DELTA_MAX_LEDS * 3];
+	uint64_t TotalFull = 0, TotalDelta = 0;
+	int Status = 0;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: %s frames.ppm [...]\n", argv[0]);
+		return 1;
+	}
+
+	WS2812B_Init(&Spi);
+
+	if(SkipWrap())
+	{
+		fprintf(stderr, "Delta skip past 65536 pixels wrapped onto the strip\n");
+		Status = 1;
+	}
+
+	for(int f = 1; f < argc; f++)
+	{
+		uint32_t Width, Height, Full = 0, Delta = 0, Bad = 0;
+		uint8_t *Rows = ReadPpm(argv[f], &Width, &Height);
+
+		if(!Rows)
+		{
+			fprintf(stderr, "%s: not a PPM with up to %d pixels per row\n", argv[f], DELTA_MAX_LEDS);
+			return 1;
+		}
+
+		for(uint32_t r = 0; r < Height; r++)	// Full frames, the strip starts black
+		{
+			const uint8_t *Row = &Rows[(size_t)r * Width * 3];
+			uint32_t Length = Tpm2(0xDA, Row, Width * 3);
+			Full += Length;
+			Bad += Send(Length, Row, Width);
+		}
+
+		Tpm2(0xDA, Black, Width * 3);
+		Send(Width * 3 + 5, Black, Width);
+		for(uint32_t r = 0; r < Height; r++)	// Delta frames, each against the row before
+		{
+			const uint8_t *Row = &Rows[(size_t)r * Width * 3];
+			const uint8_t *Prev = r ? Row - Width * 3 : Black;
+			uint32_t Length = Tpm2(0xDE, Payload, DeltaEncode(Prev, Row, Width, Payload));
+			Delta += Length;
+			Bad += Send(Length, Row, Width);
+		}
+
+		printf("%-24s %5u frames  full %8u B  delta %8u B  saved %5.1f%%%s\n", argv[f], Height,
+			Full, Delta, 100.0 - 100.0 * Delta / Full, Bad ? "  MISMATCH" : "");
+		TotalFull += Full;
+		TotalDelta += Delta;
+		Status |= (Bad != 0);
+		free(Rows);
+	}
+
+	if(argc > 2)
+		printf("%-24s                full %8llu B  delta %8llu B  saved %5.1f%%\n", "total",
+			(unsigned long long)TotalFull, (unsigned long long)TotalDelta, 100.0 - 100.0 * TotalDelta / TotalFull);
+	if(USB_StreamGetErrors() || USB_StreamGetDropped())
+	{
+		fprintf(stderr, "Stream errors %u, dropped %u\n", USB_StreamGetErrors(), USB_StreamGetDropped());
+		Status = 1;
+	}
+	return Status;
+}
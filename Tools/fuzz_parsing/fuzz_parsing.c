@@ -0,0 +1,341 @@
+/*
+ * fuzz_parsing.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Fuzz harness for the USB command parser and frame stream
+//
+//	An input is the byte stream from the PC. It is cut into CDC packets - at each
+//	newline or after 64 bytes - and each packet goes through the same split as
+//	CDC_Receive_FS: USB_StreamReceive between command lines, the rest to
+//	USB_ParsingReceive. A packet is only handed over when the receive buffer has
+//	room for a whole one, like the endpoint held in NAK on the MCU. Between packets
+//	the main loop runs as in main.c with the real FX library, scene, sequence and
+//	stream code linked. Flash is kept in RAM mapped at FLASH_BASE, replies are taken
+//	by a CDC stand-in which is busy until the next loop pass, the SPI DMA raises its
+//	half and complete callbacks once per pass.
+//
+//	Every input starts from the same state: three running segments, no sequence,
+//	blank scene pages, no line or frame pending. A receive buffer which does not
+//	drain is reported as a crash.
+//
+//	libFuzzer with ASan and UBSan, from the repository root:
+//
+//	clang -g -O1 -std=gnu11 -fsanitize=fuzzer,address,undefined -fno-sanitize-recover=all -ITools/fx_render -ICore/Inc -o fuzz_parsing Tools/fuzz_parsing/fuzz_parsing.c Core/Src/usb_parsing.c Core/Src/usb_stream.c Core/Src/ws2812b_scene.c Core/Src/ws2812b_sequence.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c Core/Src/ws2812b_matrix.c Core/Src/ws2812b_fx.c
+//	mkdir -p corpus && ./fuzz_parsing -dict=Tools/fuzz_parsing/commands.dict corpus Tools/fuzz_parsing/seeds
+//
+//	AFL or plain gcc - same sources with -DFUZZ_MAIN, which adds a main() replaying
+//	files given as arguments or stdin:
+//
+//	afl-clang-fast -g -O1 -std=gnu11 -DFUZZ_MAIN -fsanitize=address,undefined -ITools/fx_render -ICore/Inc -o fuzz_parsing ...
+//	afl-fuzz -i Tools/fuzz_parsing/seeds -o findings -x Tools/fuzz_parsing/commands.dict -- ./fuzz_parsing
+//
+//	Without a fuzzer './fuzz_parsing -r iterations [seed]' feeds random inputs made
+//	of command tokens, numbers and raw bytes.
+//
+#include "stm32f1xx_hal.h"
+#include "usbd_cdc_if.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+#include "ws2812b_scene.h"
+#include "ws2812b_sequence.h"
+#include "usb_parsing.h"
+#include "usb_stream.h"
+
+#define FUZZ_PACKET			64		// CDC_DATA_FS_OUT_PACKET_SIZE
+#define FUZZ_LOOP_MS		3		// Tick between main loop passes
+#define FUZZ_DRAIN_PASSES	16		// Passes for the receive buffer to make room
+#define FLASH_SIZE			(64 * 1024)
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+static uint8_t DmaRunning, DmaHalf;
+
+static uint32_t Tick;
+static uint8_t *Flash;
+static uint8_t Locked = 1;
+static uint8_t InFlight;	// Reply packet not taken by the host yet
+
+//
+//	HAL stand-in
+//
+uint32_t HAL_GetTick(void)
+{
+	return Tick;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	if(DmaRunning)
+		return HAL_BUSY;
+	DmaRunning = 1;
+	DmaHalf = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	DmaRunning = 0;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	Locked = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	Locked = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	if(Locked || TypeProgram != FLASH_TYPEPROGRAM_HALFWORD || (Address & 1) ||
+		Address < FLASH_BASE || Address + 2 > FLASH_BASE + FLASH_SIZE)
+		abort();	// Scene code never asks for this
+
+	uint8_t *Cell = &Flash[Address - FLASH_BASE];
+	if(Cell[0] != 0xFF || Cell[1] != 0xFF)
+		return HAL_ERROR;
+	Cell[0] = Data & 0xFF;
+	Cell[1] = (Data >> 8) & 0xFF;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+	uint32_t Addr = pEraseInit->PageAddress;
+
+	*PageError = 0xFFFFFFFF;
+	if(Locked || (Addr - FLASH_BASE) % FLASH_PAGE_SIZE ||
+		Addr + pEraseInit->NbPages * FLASH_PAGE_SIZE > FLASH_BASE + FLASH_SIZE)
+		abort();
+	memset(&Flash[Addr - FLASH_BASE], 0xFF, pEraseInit->NbPages * FLASH_PAGE_SIZE);
+	return HAL_OK;
+}
+
+//
+//	CDC stand-in
+//
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
+{
+	(void)Buf;
+	if(!Len || Len > USB_TX_BUFFER_SIZE)
+		abort();
+	if(InFlight)
+		return USBD_BUSY;
+	InFlight = 1;
+	return USBD_OK;
+}
+
+uint8_t CDC_TransmitBusy_FS(void)
+{
+	return InFlight;
+}
+
+void CDC_ResumeReceive_FS(void)
+{
+}
+
+//
+//	One pass of the main loop in main.c, the host takes the reply afterwards
+//
+static void MainLoop(void)
+{
+	for(uint8_t i = 0; i < FUZZ_LOOP_MS; i++)
+	{
+		Tick++;
+		WS2812BFX_SysTickCallback();
+	}
+
+	if(DmaRunning)
+	{
+		if(DmaHalf) HAL_SPI_TxHalfCpltCallback(&Spi);
+		else HAL_SPI_TxCpltCallback(&Spi);
+		DmaHalf ^= 1;
+	}
+
+	WS2812BFX_SequenceCallback();
+	if(!USB_StreamIsActive())
+		WS2812BFX_Callback();
+	USB_StreamTask();
+	USB_Parsing();
+
+	InFlight = 0;
+}
+
+//
+//	Packet into the receive callback, as CDC_Receive_FS
+//
+static void Receive(const uint8_t *Buf, uint32_t Len)
+{
+	uint32_t Stream = 0;
+
+	for(uint8_t i = 0; USB_ParsingRxFree() < FUZZ_PACKET; i++)
+	{
+		if(i == FUZZ_DRAIN_PASSES)
+			abort();	// Endpoint would stay in NAK for good
+		MainLoop();
+	}
+
+	if(!USB_ParsingRxInLine())
+		Stream = USB_StreamReceive(Buf, Len);
+	if(Stream < Len)
+		USB_ParsingReceive(&Buf[Stream], Len - Stream);
+	MainLoop();
+}
+
+static void Reset(void)
+{
+	static uint8_t Ready;
+
+	if(!Ready)
+	{
+		Flash = mmap((void*)(uintptr_t)FLASH_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+		if(Flash != (uint8_t*)(uintptr_t)FLASH_BASE)
+		{
+			perror("Flash at FLASH_BASE");
+			exit(1);
+		}
+		WS2812B_Init(&Spi);
+		Ready = 1;
+	}
+
+	Receive((const uint8_t*)"\n", 1);	// Ends a line left from the previous input
+	Tick += USB_STREAM_TIMEOUT + 1;	// and drops a frame
+	MainLoop();
+
+	WS2812BFX_SequenceStop();
+	WS2812BFX_SequenceClear();
+	USB_StreamSetNotify(0);
+	memset(&Flash[SCENE_FLASH_START - FLASH_BASE], 0xFF, SCENE_FLASH_PAGES * FLASH_PAGE_SIZE);
+
+	WS2812BFX_Init(3);
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		WS2812BFX_SetMode(i, i);
+		WS2812BFX_Start(i);
+	}
+	MainLoop();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size)
+{
+	Reset();
+
+	while(Size)
+	{
+		size_t Len = 0;
+
+		while(Len < Size && Len < FUZZ_PACKET && Data[Len++] != '\n')
+			;
+		Receive(Data, Len);
+		Data += Len;
+		Size -= Len;
+	}
+	MainLoop();
+	return 0;
+}
+
+#ifdef FUZZ_MAIN
+static const char * const Tokens[] = {
+	"C", "V", "M", "S", "R", "P", "PU", "L", "K", "W", "F0", "F1", "G", "T", "H",
+	"ES", "EL", "EC", "QW", "QR", "QS", "QC",
+	",", "+", "-", ",S", ",T", ",E", ",R", ",L", "\n", "\r", "\r\n", " ",
+	"Ada", "\xC9\xDA", "\xC9\xDE", "\xC9\xAA", "\x36", "FF", "00",
+};
+
+static const long Numbers[] = { 0, 1, 2, 3, 34, 35, 63, 64, 65, 255, 256, 65535, 65536, -1, 2147483647 };
+
+//
+//	Random input made of tokens, numbers, hex and raw bytes
+//
+static size_t Random(uint8_t *Buf, size_t Max)
+{
+	size_t n = 0, Len = 1 + rand() % Max;
+
+	while(n < Len)
+	{
+		char Tmp[24];
+		const char *t = Tmp;
+		uint8_t k = rand() % 10;
+
+		if(k < 5)
+			t = Tokens[rand() % (sizeof(Tokens) / sizeof(Tokens[0]))];
+		else if(k < 8)
+			snprintf(Tmp, sizeof(Tmp), "%ld", (rand() % 3) ? Numbers[rand() % (sizeof(Numbers) / sizeof(Numbers[0]))] : rand() % 1000);
+		else if(k < 9)
+			snprintf(Tmp, sizeof(Tmp), "%X", rand());
+		else
+		{
+			Buf[n++] = rand();
+			continue;
+		}
+
+		while(*t && n < Len)
+			Buf[n++] = *t++;
+	}
+	return n;
+}
+
+static int Replay(FILE *f)
+{
+	static uint8_t Buf[1 << 20];
+	size_t Size = fread(Buf, 1, sizeof(Buf), f);
+
+	return LLVMFuzzerTestOneInput(Buf, Size);
+}
+
+int main(int argc, char **argv)
+{
+	if(argc >= 3 && !strcmp(argv[1], "-r"))
+	{
+		static uint8_t Buf[4 * FUZZ_PACKET * 4];
+		long Runs = atol(argv[2]);
+
+		srand(argc > 3 ? atoi(argv[3]) : 1);
+		for(long i = 0; i < Runs; i++)
+			LLVMFuzzerTestOneInput(Buf, Random(Buf, sizeof(Buf)));
+		printf("%ld random inputs\n", Runs);
+		return 0;
+	}
+
+	if(argc < 2)
+		return Replay(stdin);
+
+	for(int i = 1; i < argc; i++)
+	{
+		FILE *f = fopen(argv[i], "rb");
+		if(!f)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+		Replay(f);
+		fclose(f);
+	}
+	printf("%d inputs\n", argc - 1);
+	return 0;
+}
+#endif
@@ -0,0 +1,564 @@
+/*
+ * fx_render.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Effect preview on a PC
+//
+//	The real ws2812b.c, ws2812b_matrix.c and ws2812b_fx.c run against a host HAL
+//	stand-in with a simulated 1 ms tick. Strip is sampled every frame and written
+//	as a PPM image - diodes on X, time going down on Y.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o fx_render Tools/fx_render/fx_render.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c Core/Src/ws2812b_matrix.c Core/Src/ws2812b_fx.c
+//
+//	Example:
+//
+//	./fx_render -l 0-16,17-34 -m 8,45 -s 1000,2000 -c FF0000,0000FF -t 4000 -o wipe.ppm
+//
+//	Output check before and after a library change - every mode with the same setup,
+//	one FNV-1a hash per frame. Runs are bit-exact for a given seed, so any line which
+//	differs in diff shows the mode and time where an effect changed:
+//
+//	./fx_render -A -H -t 3000 > before.txt
+//	./fx_render -A -H -t 3000 > after.txt
+//	diff before.txt after.txt
+//
+//	Golden files with their options in the first line are checked in next to this file.
+//	Any frame different from them fails, unless its mode, or mode and tick, is listed
+//	in golden_whitelist.txt with the reason for the intended change:
+//
+//	./fx_render -A -H -t 2000 -f 40 -G Tools/fx_render/golden.txt -W Tools/fx_render/golden_whitelist.txt
+//	./fx_render -A -H -t 2000 -f 40 -l 0-9,10-20,21-34 -s 300,1000,77 -c 102030,FF8000,00FFFF -b 255,128,255 -x 0,0,1 -p 2 -G Tools/fx_render/golden_layers.txt -W Tools/fx_render/golden_whitelist.txt
+//
+//	After an intended change regenerate the golden file with the command from its first
+//	line and empty the whitelist.
+//
+//	Two boards side by side - board B powered up earlier with its clock off by -S ppm,
+//	both sent the same 'T' every second. After the restart on a shared SYNC_PERIOD
+//	boundary every frame of B has to match A within SYNC_TOLERANCE ms, else exit code
+//	is 1. -j blocks B's main loop once in the middle of the run; periodic modes, which
+//	take their step from shared time, are back in phase on their next step:
+//
+//	./fx_render -A -S 200 -t 10000
+//	./fx_render -A -S 200 -j 400 -t 20000
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+
+#define RENDER_MAX_LIST		WS2812B_LEDS	// Values in one comma separated option
+#define SYNC_BOARD_B_UP		4321			// ms board B was on before board A
+#define SYNC_RESEND			1000			// ms between 'T' sent to both boards
+#define SYNC_BASE			1000000			// Shared time at the first 'T', far from both ticks
+#define SYNC_SETTLE			(3 * SYNC_PERIOD)	// First 'T', restart and one more period for trails
+#define SYNC_TOLERANCE		2				// ms board B may be off board A
+#define GOLDEN_WHITELIST	256				// Entries in the whitelist file
+#define GOLDEN_SHOWN		3				// Mismatches printed per mode
+
+static long Start[RENDER_MAX_LIST] = { 0 }, Stop[RENDER_MAX_LIST] = { WS2812B_LEDS - 1 };
+static long Mode[RENDER_MAX_LIST] = { 0 }, Speed[RENDER_MAX_LIST] = { DEFAULT_SPEED };
+static long Color[NUM_COLORS] = { RED, GREEN, BLUE };
+static long Bright[RENDER_MAX_LIST] = { 255 }, Alpha[RENDER_MAX_LIST] = { 255 }, Blend[RENDER_MAX_LIST] = { WS2812B_BLEND_NORMAL };
+static long Link[RENDER_MAX_LIST][3];	// Follower, leader, fx_link
+static int Segments = 1, Modes = 1, Speeds = 1, Brights = 1, Alphas = 1, Blends = 1, Links = 0;
+static long Palette = 0, Duration = 5000, Frame = 20, Zoom = 8, Seed = 1;
+static uint8_t Hash;
+static long SyncPpm, SyncStall = -1;	// -1 - no two board run
+
+static uint32_t Tick;
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+
+//
+//	HAL stand-in. Refresh ends at once, pixels are read straight from the buffer.
+//
+uint32_t HAL_GetTick(void)
+{
+	return Tick;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -l a-b[,c-d...]   segments, default whole strip\n"
+		"  -m mode[,...]     mode per segment 0-%d, list repeats, default 0\n"
+		"  -s speed[,...]    speed per segment %d-%d, list repeats\n"
+		"  -b bright[,...]   segment brightness 0-255, list repeats\n"
+		"  -a alpha[,...]    segment opacity 0-255, list repeats\n"
+		"  -x blend[,...]    0 normal, 1 add, 2 max, 3 multiply, list repeats\n"
+		"  -k f,l,link       segment f follows l, 1 copy, 2 reverse, 3 mirror, repeats\n"
+		"  -c RRGGBB[,...]   colors 0-%d\n"
+		"  -p palette        palette 0-%d\n"
+		"  -t ms             rendered time, default 5000\n"
+		"  -f ms             time between rows, default 20\n"
+		"  -z n              pixel size in the image, default 8\n"
+		"  -r seed           rand() seed, default 1\n"
+		"  -o file           output, default stdout\n"
+		"  -H                frame hashes instead of the image\n"
+		"  -A                every mode in turn on all segments, needs -H\n"
+		"  -S ppm            two boards synced with 'T', board B clock off by ppm,\n"
+		"                    exit code 1 if their frames differ\n"
+		"  -j ms             with -S board B main loop blocked once for ms\n"
+		"  -G file           compare hashes with a golden file, exit code 1 on a difference\n"
+		"  -W file           with -G differences allowed, lines 'mode' or 'mode tick'\n",
+		Name, MODE_COUNT - 1, SPEED_MIN, SPEED_MAX, NUM_COLORS - 1, PALETTE_COUNT - 1);
+	exit(1);
+}
+
+//
+//	Comma separated numbers, Pair takes 'a-b' items. Returns count, 0 on error.
+//
+static int ParseList(const char *Arg, int Base, long *Out, long *Out2)
+{
+	int Count = 0;
+	char *End;
+
+	while(*Arg && Count < RENDER_MAX_LIST)
+	{
+		Out[Count] = strtol(Arg, &End, Base);
+		if(End == Arg) return 0;
+		Arg = End;
+
+		if(Out2)
+		{
+			if(*Arg++ != '-') return 0;
+			Out2[Count] = strtol(Arg, &End, Base);
+			if(End == Arg) return 0;
+			Arg = End;
+		}
+		Count++;
+
+		if(*Arg == ',') Arg++;
+		else if(*Arg) return 0;
+	}
+	return *Arg ? 0 : Count;
+}
+
+static uint32_t Fnv1a(const uint8_t *Buf, uint32_t Length)
+{
+	uint32_t h = 2166136261u;
+
+	while(Length--)
+	{
+		h ^= *Buf++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+//
+//	Library set up from the options at power up. ForceMode >= 0 replaces the -m list.
+//
+static int Setup(long ForceMode)
+{
+	srand(Seed);
+	WS2812B_Init(&Spi);
+	if(WS2812BFX_Init(Segments) != FX_OK)
+	{
+		fprintf(stderr, "Bad segment count %d\n", Segments);
+		return 1;
+	}
+
+	for(int i = 0; i < NUM_COLORS; i++)
+		WS2812BFX_SetColor(i, Color[i]);
+
+	for(int i = 0; i < Segments; i++)
+	{
+		long m = (ForceMode >= 0) ? ForceMode : Mode[i % Modes];
+
+		if(m < 0 || m >= MODE_COUNT || Speed[i % Speeds] < SPEED_MIN || Speed[i % Speeds] > SPEED_MAX ||
+			WS2812BFX_SetSegmentSize(i, Start[i], Stop[i]) != FX_OK)
+		{
+			fprintf(stderr, "Bad setup of segment %d\n", i);
+			return 1;
+		}
+		if(Bright[i % Brights] < 0 || Bright[i % Brights] > 255 || Alpha[i % Alphas] < 0 || Alpha[i % Alphas] > 255 ||
+			Blend[i % Blends] < 0 || WS2812BFX_SetLayer(i, Bright[i % Brights], Alpha[i % Alphas], Blend[i % Blends]) != FX_OK)
+		{
+			fprintf(stderr, "Bad layer of segment %d\n", i);
+			return 1;
+		}
+		WS2812BFX_SetSpeed(i, Speed[i % Speeds]);
+		WS2812BFX_SetPalette(i, Palette);
+		WS2812BFX_SetMode(i, m);
+		WS2812BFX_Start(i);
+	}
+
+	for(int i = 0; i < Links; i++)
+	{
+		if(Link[i][0] < 0 || Link[i][1] < 0 || Link[i][2] < 0 ||
+			WS2812BFX_SetLink(Link[i][0], Link[i][1], Link[i][2]) != FX_OK)
+		{
+			fprintf(stderr, "Bad link %ld,%ld,%ld\n", Link[i][0], Link[i][1], Link[i][2]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//
+//	One run from power up
+//
+static int Render(FILE *Out, long ForceMode)
+{
+	if(Setup(ForceMode)) return 1;
+
+	long Rows = Duration / Frame;
+	uint8_t Row[WS2812B_LEDS * 3];
+
+	if(!Hash)
+		fprintf(Out, "P6\n%ld %ld\n255\n", (long)WS2812B_LEDS * Zoom, Rows * Zoom);
+
+	for(long r = 0; r < Rows; r++)
+	{
+		for(long t = 0; t < Frame; t++)	// Same order as on the MCU - tick interrupt, then main loop
+		{
+			Tick++;
+			WS2812BFX_SysTickCallback();
+			WS2812BFX_Callback();
+		}
+
+		memcpy(Row, WS2812B_GetPixels(), sizeof(Row));
+		if(Hash)
+		{
+			if(ForceMode >= 0) fprintf(Out, "%2ld ", ForceMode);
+			fprintf(Out, "%6lu %08x\n", (unsigned long)Tick, Fnv1a(Row, sizeof(Row)));
+			continue;
+		}
+		for(long y = 0; y < Zoom; y++)
+			for(int x = 0; x < WS2812B_LEDS; x++)
+				for(long z = 0; z < Zoom; z++)
+					fwrite(&Row[x * 3], 1, 3, Out);
+	}
+	return 0;
+}
+
+//
+//	One board of the two board run, a fresh process. Wall time goes in 1 ms steps, the
+//	board's tick runs Ppm faster and starts at PowerUp. Host sends the same 'T' to both
+//	boards every SYNC_RESEND, the first one far off so both restart on the same boundary.
+//	Strip hash after every wall ms goes to Fd.
+//
+static int Board(int Fd, long ForceMode, uint32_t PowerUp, long Ppm, long Stall)
+{
+	uint32_t *Hashes = malloc(Duration * sizeof(uint32_t));
+	int64_t Phase = 0;
+
+	Tick = PowerUp;
+	if(!Hashes || Setup(ForceMode)) return 1;
+
+	for(long Now = 1; Now <= Duration; Now++)
+	{
+		uint8_t Blocked = (Now > Duration / 2 && Now <= Duration / 2 + Stall);	// Main loop stuck, interrupts run
+
+		for(Phase += 1000000 + Ppm; Phase >= 1000000; Phase -= 1000000)
+		{
+			Tick++;
+			WS2812BFX_SysTickCallback();
+			if(!Blocked) WS2812BFX_Callback();
+		}
+		if(!Blocked && Now % SYNC_RESEND == 0)
+			WS2812BFX_SetTime(SYNC_BASE + Now);
+		Hashes[Now - 1] = Fnv1a(WS2812B_GetPixels(), WS2812B_LEDS * 3);
+	}
+	return write(Fd, Hashes, Duration * sizeof(uint32_t)) != (ssize_t)(Duration * sizeof(uint32_t));
+}
+
+static uint32_t* BoardRun(long ForceMode, uint32_t PowerUp, long Ppm, long Stall)
+{
+	uint32_t *Hashes = malloc(Duration * sizeof(uint32_t));
+	size_t Got = 0;
+	ssize_t n = 1;
+	int Fd[2], Status;
+
+	if(!Hashes || pipe(Fd)) return NULL;
+	pid_t Pid = fork();
+	if(Pid == 0)
+	{
+		close(Fd[0]);
+		_exit(Board(Fd[1], ForceMode, PowerUp, Ppm, Stall));
+	}
+	close(Fd[1]);
+	while(Pid > 0 && Got < Duration * sizeof(uint32_t) && n > 0)
+	{
+		n = read(Fd[0], (uint8_t*)Hashes + Got, Duration * sizeof(uint32_t) - Got);
+		Got += (n > 0) ? n : 0;
+	}
+	close(Fd[0]);
+	if(Pid < 0 || waitpid(Pid, &Status, 0) < 0 || Status || Got != Duration * sizeof(uint32_t))
+	{
+		free(Hashes);
+		return NULL;
+	}
+	return Hashes;
+}
+
+//
+//	Two board run. Every frame after SYNC_SETTLE, board B has to show what board A
+//	shows within SYNC_TOLERANCE ms, except while B's main loop is blocked.
+//	Returns 1 on a difference, 2 if a run failed.
+//
+static int Sync(FILE *Out, long ForceMode)
+{
+	uint32_t *A = BoardRun(ForceMode, 0, 0, 0);
+	uint32_t *B = BoardRun(ForceMode, SYNC_BOARD_B_UP, SyncPpm, SyncStall);
+	long Frames = 0, Off = 0, First = -1;
+
+	if(!A || !B)
+	{
+		fprintf(stderr, "Board run failed\n");
+		free(A);
+		free(B);
+		return 2;
+	}
+
+	for(long t = SYNC_SETTLE + Frame; t <= Duration - SYNC_TOLERANCE; t += Frame)
+	{
+		uint8_t Same = 0;
+
+		if(SyncStall && t > Duration / 2 && t <= Duration / 2 + SyncStall + SYNC_TOLERANCE) continue;
+		for(long d = -SYNC_TOLERANCE; d <= SYNC_TOLERANCE; d++)
+			Same |= (B[t - 1] == A[t - 1 + d]);
+		Frames++;
+		if(!Same && !Off++) First = t;
+	}
+
+	if(ForceMode >= 0) fprintf(Out, "%2ld ", ForceMode);
+	fprintf(Out, "frames %ld  off %ld", Frames, Off);
+	if(Off) fprintf(Out, "  first at %ld ms", First);
+	fprintf(Out, "\n");
+	free(A);
+	free(B);
+	return Off != 0;
+}
+
+//
+//	Whitelist - 'mode' or 'mode tick' per line, '#' starts a comment. Tick -1 - whole mode.
+//
+static int ReadWhitelist(const char *Name, long (*List)[2])
+{
+	FILE *f = fopen(Name, "r");
+	char Line[256];
+	int Count = 0;
+
+	if(!f) return -1;
+	while(fgets(Line, sizeof(Line), f))
+	{
+		long m, t;
+		int n;
+
+		Line[strcspn(Line, "#")] = 0;
+		n = sscanf(Line, "%ld %ld", &m, &t);
+		if(n < 1) continue;
+		if(Count == GOLDEN_WHITELIST) break;
+		List[Count][0] = m;
+		List[Count][1] = (n == 2) ? t : -1;
+		Count++;
+	}
+	fclose(f);
+	return Count;
+}
+
+//
+//	Next hash line, '#' lines skipped. Mode is -1 without -A.
+//
+static int ReadHash(FILE *f, char *Line, int Size, long *Mode, long *Tick)
+{
+	while(fgets(Line, Size, f))
+	{
+		unsigned Hash;
+
+		if(Line[0] == '#') continue;
+		if(sscanf(Line, "%ld %ld %x", Mode, Tick, &Hash) == 3) return 1;
+		*Mode = -1;
+		if(sscanf(Line, "%ld %x", Tick, &Hash) == 2) return 1;
+	}
+	return 0;
+}
+
+//
+//	This run's hashes against the golden file. Returns 1 on a difference not in the whitelist.
+//
+static int Golden(FILE *Run, FILE *Out, const char *GoldenName, const char *WhiteName)
+{
+	static long White[GOLDEN_WHITELIST][2];
+	char Now[64], Was[64];
+	long Mode, Tick, NowMode, NowTick, Shown = 0, LastMode = -2;
+	long Frames = 0, Differ = 0, Allowed = 0;
+	int Whites = 0, HaveNow, HaveWas;
+	FILE *f = fopen(GoldenName, "r");
+
+	if(!f || (WhiteName && (Whites = ReadWhitelist(WhiteName, White)) < 0))
+	{
+		perror(f ? WhiteName : GoldenName);
+		if(f) fclose(f);
+		return 1;
+	}
+
+	rewind(Run);
+	for(;;)
+	{
+		HaveWas = ReadHash(f, Was, sizeof(Was), &Mode, &Tick);
+		HaveNow = ReadHash(Run, Now, sizeof(Now), &NowMode, &NowTick);
+		if(!HaveWas || !HaveNow) break;
+
+		Frames++;
+		if(Mode != NowMode || Tick != NowTick)
+		{
+			fprintf(Out, "Frame %ld is mode %ld tick %ld in the golden file - run with the options from its first line\n",
+				Frames, Mode, Tick);
+			fclose(f);
+			return 1;
+		}
+		if(!strcmp(Was, Now)) continue;
+
+		uint8_t Listed = 0;
+		for(int i = 0; i < Whites; i++)
+			Listed |= (White[i][0] == Mode && (White[i][1] < 0 || White[i][1] == Tick));
+		if(Listed)
+		{
+			Allowed++;
+			continue;
+		}
+
+		Differ++;
+		if(Mode != LastMode) Shown = 0;
+		LastMode = Mode;
+		if(Shown++ < GOLDEN_SHOWN)
+			fprintf(Out, "mode %2ld tick %6ld  golden %.8s  now %.8s\n", Mode, Tick, strrchr(Was, ' ') + 1, strrchr(Now, ' ') + 1);
+	}
+	fclose(f);
+
+	if(HaveWas || HaveNow)
+	{
+		fprintf(Out, "%s has %s frames than this run\n", GoldenName, HaveWas ? "more" : "fewer");
+		return 1;
+	}
+	fprintf(Out, "%ld frames, %ld differ, %ld more in the whitelist\n", Frames, Differ, Allowed);
+	return Differ != 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *Output = NULL, *GoldenName = NULL, *WhiteName = NULL;
+	long List[RENDER_MAX_LIST];
+	uint8_t All = 0;
+	int Opt, Status = 0;
+
+	while((Opt = getopt(argc, argv, "l:m:s:b:a:x:k:c:p:t:f:z:r:o:HAS:j:G:W:h")) != -1)
+	{
+		switch(Opt)
+		{
+		case 'l': if(!(Segments = ParseList(optarg, 10, Start, Stop))) Usage(argv[0]); break;
+		case 'm': if(!(Modes = ParseList(optarg, 10, Mode, NULL))) Usage(argv[0]); break;
+		case 's': if(!(Speeds = ParseList(optarg, 10, Speed, NULL))) Usage(argv[0]); break;
+		case 'b': if(!(Brights = ParseList(optarg, 10, Bright, NULL))) Usage(argv[0]); break;
+		case 'a': if(!(Alphas = ParseList(optarg, 10, Alpha, NULL))) Usage(argv[0]); break;
+		case 'x': if(!(Blends = ParseList(optarg, 10, Blend, NULL))) Usage(argv[0]); break;
+		case 'k':
+			if(Links == RENDER_MAX_LIST || ParseList(optarg, 10, List, NULL) != 3) Usage(argv[0]);
+			memcpy(Link[Links++], List, sizeof(Link[0]));
+			break;
+		case 'c': if(!ParseList(optarg, 16, Color, NULL)) Usage(argv[0]); break;
+		case 'p': Palette = atol(optarg); break;
+		case 't': Duration = atol(optarg); break;
+		case 'f': Frame = atol(optarg); break;
+		case 'z': Zoom = atol(optarg); break;
+		case 'r': Seed = atol(optarg); break;
+		case 'o': Output = optarg; break;
+		case 'H': Hash = 1; break;
+		case 'A': All = 1; break;
+		case 'S': SyncPpm = atol(optarg); if(SyncStall < 0) SyncStall = 0; break;
+		case 'j': SyncStall = atol(optarg); break;
+		case 'G': GoldenName = optarg; Hash = 1; break;
+		case 'W': WhiteName = optarg; break;
+		default: Usage(argv[0]);
+		}
+	}
+	if(Duration < 1 || Frame < 1 || Zoom < 1 || Palette < 0 || Palette >= PALETTE_COUNT || (All && !Hash && SyncStall < 0) ||
+		SyncPpm <= -1000000 || SyncStall >= Duration / 2) Usage(argv[0]);
+
+	FILE *Out = Output ? fopen(Output, "wb") : stdout;
+	FILE *Report = Out;
+	if(!Out)
+	{
+		perror(Output);
+		return 1;
+	}
+	if(GoldenName && (SyncStall >= 0 || !(Out = tmpfile())))	// Hashes go to a file compared at the end
+	{
+		if(SyncStall >= 0) Usage(argv[0]);
+		perror("tmpfile");
+		return 1;
+	}
+
+	if(SyncStall >= 0)
+	{
+		for(long m = All ? 0 : -1; m < (All ? MODE_COUNT : 0) && Status < 2; m++)
+			Status |= Sync(Out, m);
+	}
+	else if(!All)
+	{
+		Status = Render(Out, -1);
+	}
+	else
+	{
+		for(long m = 0; m < MODE_COUNT && !Status; m++)	// Library keeps state between Inits, every mode starts in a fresh process
+		{
+			fflush(Out);
+			pid_t Pid = fork();
+
+			if(Pid == 0)
+			{
+				Status = Render(Out, m);
+				fflush(Out);
+				_exit(Status);
+			}
+			if(Pid < 0 || waitpid(Pid, &Status, 0) < 0)
+			{
+				perror("fork");
+				Status = 1;
+			}
+		}
+	}
+
+	if(GoldenName && !Status)
+	{
+		fflush(Out);
+		Status = Golden(Out, Report, GoldenName, WhiteName);
+	}
+	if(Out != Report) fclose(Out);
+	if(Report != stdout) fclose(Report);
+	return Status ? 1 : 0;
+}
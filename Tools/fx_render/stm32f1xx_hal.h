@@ -0,0 +1,76 @@
+/*
+ * stm32f1xx_hal.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#ifndef STM32F1XX_HAL_H_HOST_
+#define STM32F1XX_HAL_H_HOST_
+
+//
+//	Host stand-in for the HAL, just what the WS2812B, FX and USB sources use.
+//	Found before the real one thanks to include order, so library files build unchanged.
+//	Flash is at its real address, a tool which saves scenes maps RAM there.
+//
+#include <stdint.h>
+#include <stddef.h>
+
+#define __weak	__attribute__((weak))
+
+#define __disable_irq()	((void)0)	// Single threaded - SysTick is called from the render loop
+#define __enable_irq()	((void)0)
+
+typedef enum
+{
+	HAL_OK		= 0x00,
+	HAL_ERROR	= 0x01,
+	HAL_BUSY	= 0x02,
+	HAL_TIMEOUT	= 0x03
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	HAL_DMA_STATE_RESET		= 0x00,
+	HAL_DMA_STATE_READY		= 0x01,
+	HAL_DMA_STATE_BUSY		= 0x02,
+	HAL_DMA_STATE_TIMEOUT	= 0x03
+} HAL_DMA_StateTypeDef;
+
+typedef struct
+{
+	HAL_DMA_StateTypeDef State;
+} DMA_HandleTypeDef;
+
+typedef struct
+{
+	DMA_HandleTypeDef *hdmatx;
+} SPI_HandleTypeDef;
+
+#define FLASH_BASE					0x08000000u
+#define FLASH_PAGE_SIZE				0x400u
+#define FLASH_TYPEERASE_PAGES		0x00u
+#define FLASH_TYPEPROGRAM_HALFWORD	0x01u
+
+typedef struct
+{
+	uint32_t TypeErase;
+	uint32_t Banks;
+	uint32_t PageAddress;
+	uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+uint32_t HAL_GetTick(void);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi);
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma);
+void HAL_SPI_TxHalfCpltCallback(SPI_HandleTypeDef *hspi);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+#endif /* STM32F1XX_HAL_H_HOST_ */
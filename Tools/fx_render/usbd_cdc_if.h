@@ -0,0 +1,26 @@
+/*
+ * usbd_cdc_if.h
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+#ifndef USBD_CDC_IF_H_HOST_
+#define USBD_CDC_IF_H_HOST_
+
+//
+//	Host stand-in for the CDC interface used by usb_parsing.c, a tool provides the functions.
+//
+#include <stdint.h>
+
+#define USBD_OK		0
+#define USBD_BUSY	1
+#define USBD_FAIL	2
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
+void CDC_ResumeReceive_FS(void);
+uint8_t CDC_TransmitBusy_FS(void);
+
+#endif /* USBD_CDC_IF_H_HOST_ */
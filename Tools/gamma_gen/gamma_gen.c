@@ -0,0 +1,100 @@
+/*
+ * gamma_gen.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Output correction tables generator
+//
+//	Every profile is a gamma and a white point scale per channel:
+//
+//		out = round(255 * Scale * (in / 255) ^ Gamma)
+//
+//	Result is Core/Src/ws2812b_correction.c with one 3 x 256 byte table per profile.
+//	Profile 0 (no correction) is built into the driver and takes no table.
+//
+//	Build and regenerate from the repository root:
+//
+//	gcc -O2 -o gamma_gen Tools/gamma_gen/gamma_gen.c -lm
+//	./gamma_gen gamma28 2.8 2.8 2.8 1 1 1 strip 2.8 2.8 2.8 1 0.69 0.94 > Core/Src/ws2812b_correction.c
+//
+//	Measure white point of a LED batch with all channels at 255 and scale down the channels
+//	which are too strong. 1 0.69 0.94 is the common correction for 5050 WS2812B strips.
+//
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROFILE_ARGS	7	// name, 3 x gamma, 3 x scale
+
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"Usage: %s name gR gG gB sR sG sB [name ...] > ws2812b_correction.c\n"
+		"  gamma 1.0 - 4.0, scale 0.0 - 1.0 per channel\n", Name);
+	exit(1);
+}
+
+static void Table(const char *Channel, double Gamma, double Scale)
+{
+	printf("\t\t.%s = {", Channel);
+	for(int i = 0; i < 256; i++)
+	{
+		long v = lround(255.0 * Scale * pow(i / 255.0, Gamma));
+
+		printf("%s%3ld,", (i % 16) ? "" : "\n\t\t\t", v);
+	}
+	printf("\n\t\t},\n");
+}
+
+int main(int argc, char **argv)
+{
+	int Profiles = (argc - 1) / PROFILE_ARGS;
+
+	if(argc < 1 + PROFILE_ARGS || (argc - 1) % PROFILE_ARGS || Profiles > 254) Usage(argv[0]);
+
+	printf("/*\n"
+		" * ws2812b_correction.c\n"
+		" *\n"
+		" *\tThe MIT License.\n"
+		" *\t\tAuthor: agent\n"
+		" *\t\tagent@local\n"
+		" *\n"
+		" *\tGenerated by Tools/gamma_gen, do not edit:\n"
+		" *\t");
+	for(int i = 0; i < argc; i++)
+		printf("%s%s", i ? " " : "gamma_gen", i ? argv[i] : "");
+	printf("\n */\n\n"
+		"#include \"stm32f1xx_hal.h\"\n\n"
+		"#include \"ws2812b.h\"\n\n"
+		"const uint8_t WS2812B_CorrectionProfiles = %d;\n\n"
+		"const ws2812b_correction WS2812B_Correction[%d] =\n"
+		"{\n", Profiles, Profiles);
+
+	for(int p = 0; p < Profiles; p++)
+	{
+		char **a = &argv[1 + p * PROFILE_ARGS];
+		double v[6];
+
+		for(int i = 0; i < 6; i++)
+		{
+			char *End;
+
+			v[i] = strtod(a[1 + i], &End);
+			if(*End || (i < 3 && (v[i] < 1.0 || v[i] > 4.0)) || (i >= 3 && (v[i] < 0.0 || v[i] > 1.0)))
+				Usage(argv[0]);
+		}
+
+		printf("\t{\t// %d - %s, gamma %g/%g/%g, scale %g/%g/%g\n", p + 1, a[0], v[0], v[1], v[2], v[3], v[4], v[5]);
+		Table("red", v[0], v[3]);
+		Table("green", v[1], v[4]);
+		Table("blue", v[2], v[5]);
+		printf("\t},\n");
+	}
+	printf("};\n");
+	return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * kernel_test.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Pixel kernel checks on a PC
+//
+//	ws2812b.c color and span kernels against the code they replaced, copied here as
+//	reference. Every check runs over the whole input domain or a fixed random set and
+//	the program exits with 1 if any of them failed. Timings are ns per pixel on the host,
+//	where division is a few cycles and the division-free HSV code times the same as the
+//	old one, within noise. They only catch a kernel becoming much slower and say nothing
+//	about the Cortex-M3, where UDIV takes 2-12 cycles. Cycles on the MCU: set
+//	WS2812B_SPAN_CYCLES to 1 in ws2812b.h and read WS2812B_GetSpanCycles().
+//
+//	Build and run from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o kernel_test Tools/kernel_test/kernel_test.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c -lm
+//	./kernel_test
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "ws2812b.h"
+
+#define BENCH_PIXELS	(1 << 22)
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+static int Failed;
+
+//
+//	HAL stand-in, refresh is never called here
+//
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+static void Check(const char *Name, int Ok, const char *Detail)
+{
+	printf("%-28s %s%s%s\n", Name, Ok ? "ok" : "FAIL", Detail[0] ? " - " : "", Detail);
+	if(!Ok) Failed = 1;
+}
+
+static double Now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+//
+//	HSV to RGB with divisions, as WS2812BFX_HSVtoRGB was before the conversion moved to ws2812b.c
+//
+static void RefHSVtoRGB(uint16_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+	uint16_t Sector, Fracts, p, q, t;
+
+	if(s == 0)
+	{
+		*r = *g = *b = v;
+		return;
+	}
+	if(h >= 360) h = 359;
+
+	Sector = h / 60;
+	Fracts = h % 60;
+	p = (v * (255 - s)) / 256;
+	q = (v * (255 - (s * Fracts)/60)) / 256;
+	t = (v * (255 - (s * (59 - Fracts))/60)) / 256;
+
+	switch(Sector)
+	{
+	case 0: *r = v; *g = t; *b = p; break;
+	case 1: *r = q; *g = v; *b = p; break;
+	case 2: *r = p; *g = v; *b = t; break;
+	case 3: *r = p; *g = q; *b = v; break;
+	case 4: *r = t; *g = p; *b = v; break;
+	default: *r = v; *g = p; *b = q; break;
+	}
+}
+
+//
+//	Exact RGB to HSV. The old integer version had wrong sector offsets, so it is no reference.
+//
+static void RefRGBtoHSV(uint8_t r, uint8_t g, uint8_t b, double *h, double *s)
+{
+	int max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+	int min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+	double d = max - min;
+
+	*h = 0;
+	*s = max ? d * 255.0 / max : 0;
+	if(d == 0) return;
+
+	if(r == max) *h = 60.0 * (g - b) / d;
+	else if(g == max) *h = 120.0 + 60.0 * (b - r) / d;
+	else *h = 240.0 + 60.0 * (r - g) / d;
+	if(*h < 0) *h += 360.0;
+}
+
+static void TestHSVtoRGB(void)
+{
+	long Diff = 0;
+	char Detail[64] = "";
+
+	for(uint16_t h = 0; h < 400; h++)	// Over 359 is clamped
+		for(int s = 0; s < 256; s++)
+			for(int v = 0; v < 256; v++)
+			{
+				uint8_t r0, g0, b0, r1, g1, b1;
+
+				RefHSVtoRGB(h, s, v, &r0, &g0, &b0);
+				WS2812B_HSVtoRGB(h, s, v, &r1, &g1, &b1);
+				if(r0 != r1 || g0 != g1 || b0 != b1)
+				{
+					if(!Diff) snprintf(Detail, sizeof(Detail), "first at h%u s%d v%d", h, s, v);
+					Diff++;
+				}
+			}
+	Check("HSVtoRGB bit-exact", Diff == 0, Detail);
+}
+
+static void TestRGBtoHSV(void)
+{
+	double HueErr = 0, SatErr = 0;
+	long VErr = 0;
+	char Detail[64];
+
+	for(int r = 0; r < 256; r++)
+		for(int g = 0; g < 256; g++)
+			for(int b = 0; b < 256; b++)
+			{
+				uint16_t h;
+				uint8_t s, v;
+				double rh, rs, e;
+
+				WS2812B_RGBtoHSV(r, g, b, &h, &s, &v);
+				RefRGBtoHSV(r, g, b, &rh, &rs);
+
+				e = fabs(h - rh);
+				if(e > 180) e = 360 - e;
+				if(e > HueErr) HueErr = e;
+				if(fabs(s - rs) > SatErr) SatErr = fabs(s - rs);
+				if(v != (r > g ? (r > b ? r : b) : (g > b ? g : b))) VErr++;
+			}
+	snprintf(Detail, sizeof(Detail), "max hue error %.2f, sat error %.2f", HueErr, SatErr);
+	Check("RGBtoHSV accuracy", HueErr <= 1.0 && SatErr <= 2.0 && VErr == 0, Detail);
+}
+
+static void TestGradient(void)
+{
+	int Ok = 1;
+
+	for(uint16_t Count = 1; Count <= WS2812B_LEDS && Ok; Count++)
+		for(uint16_t a = 0; a < 360 && Ok; a += 7)
+			for(uint16_t b = 0; b < 360 && Ok; b += 11)
+			{
+				uint32_t Range = (b >= a) ? (b - a) : (b + 360 - a);
+
+				WS2812B_SetSpanHSVGradient(0, Count, a, b, 255, 255);
+				for(uint16_t i = 0; i < Count; i++)
+				{
+					uint8_t r, g, bl;
+					uint16_t h = a + ((Count > 1) ? Range * i / (Count - 1) : 0);
+					int d0, d1;
+
+					if(h >= 360) h -= 360;
+					RefHSVtoRGB(h, 255, 255, &r, &g, &bl);	// 16.16 step may land one degree lower
+					d0 = (WS2812B_GetColor(i) == (uint32_t)((r << 16) | (g << 8) | bl));
+					RefHSVtoRGB(h ? h - 1 : 359, 255, 255, &r, &g, &bl);
+					d1 = (WS2812B_GetColor(i) == (uint32_t)((r << 16) | (g << 8) | bl));
+					if(!d0 && !d1) Ok = 0;
+				}
+			}
+	Check("SetSpanHSVGradient", Ok, "");
+}
+
+//
+//	One fade step toward target, as fade_out() did it per pixel before WS2812B_FadeSpan
+//
+static void RefFade(uint8_t *Pixels, uint16_t Start, uint16_t Stop, uint32_t Target, uint8_t rateH, uint8_t rateL)
+{
+	int t[3] = { (Target >> 16) & 0xff, (Target >> 8) & 0xff, Target & 0xff };
+
+	for(uint16_t i = Start; i <= Stop; i++)
+		for(int k = 0; k < 3; k++)
+		{
+			int c = Pixels[i * 3 + k];
+			int d = t[k] - c;
+
+			d = abs(d) < 3 ? d : (d >> rateH) + (d >> rateL);
+			Pixels[i * 3 + k] = c + d;
+		}
+}
+
+//
+//	fireworks() blur as it was, byte by byte over the segment without its ends
+//
+static void RefBlur(uint8_t *Pixels, uint16_t Start, uint16_t Stop)
+{
+	for(uint16_t i = Start * 3 + 3; i < Stop * 3; i++)
+	{
+		uint16_t v = (Pixels[i - 3] >> 2) + Pixels[i] + (Pixels[i + 3] >> 2);
+		Pixels[i] = v > 255 ? 255 : v;
+	}
+}
+
+static void RandomStrip(uint8_t *Pixels)
+{
+	for(int i = 0; i < WS2812B_LEDS * 3; i++)
+		Pixels[i] = rand();
+	memcpy(WS2812B_GetPixels(), Pixels, WS2812B_LEDS * 3);
+}
+
+static void TestFade(void)
+{
+	static const uint8_t rateMapH[] = {0, 1, 1, 1, 2, 3, 4, 6};
+	static const uint8_t rateMapL[] = {0, 2, 3, 8, 8, 8, 8, 8};
+	uint8_t Ref[WS2812B_LEDS * 3];
+	long Diff = 0;
+
+	for(int Rate = 1; Rate < 8; Rate++)
+	{
+		for(int c = 0; c < 256; c++)	// Every lane value against every target, on all word offsets
+			for(int t = 0; t < 256; t++)
+			{
+				memset(Ref, c, sizeof(Ref));
+				memcpy(WS2812B_GetPixels(), Ref, sizeof(Ref));
+				RefFade(Ref, 0, WS2812B_LEDS - 1, t * 0x010101u, rateMapH[Rate], rateMapL[Rate]);
+				WS2812B_FadeSpan(0, WS2812B_LEDS, t * 0x010101u, rateMapH[Rate], rateMapL[Rate]);
+				Diff += memcmp(Ref, WS2812B_GetPixels(), sizeof(Ref)) != 0;
+			}
+
+		for(int n = 0; n < 20000; n++)	// Mixed lanes, any span
+		{
+			uint16_t Start = rand() % WS2812B_LEDS, Stop = Start + rand() % (WS2812B_LEDS - Start);
+			uint32_t Target = rand() & 0xFFFFFF;
+
+			RandomStrip(Ref);
+			RefFade(Ref, Start, Stop, Target, rateMapH[Rate], rateMapL[Rate]);
+			WS2812B_FadeSpan(Start, Stop - Start + 1, Target, rateMapH[Rate], rateMapL[Rate]);
+			Diff += memcmp(Ref, WS2812B_GetPixels(), sizeof(Ref)) != 0;
+		}
+	}
+	Check("FadeSpan bit-exact", Diff == 0, "");
+}
+
+static void TestScale(void)
+{
+	uint8_t Ref[WS2812B_LEDS * 3];
+	long Diff = 0;
+
+	for(int n = 0; n < 20000; n++)
+	{
+		uint16_t Start = rand() % WS2812B_LEDS, Stop = Start + rand() % (WS2812B_LEDS - Start);
+		uint16_t Scale = rand() % 257;
+
+		RandomStrip(Ref);
+		for(int i = Start * 3; i < (Stop + 1) * 3; i++)
+			Ref[i] = (Ref[i] * Scale) >> 8;	// Scale 128 is the old (color >> 1) & 0x7F7F7F
+		WS2812B_ScaleSpan(Start, Stop - Start + 1, Scale);
+		Diff += memcmp(Ref, WS2812B_GetPixels(), sizeof(Ref)) != 0;
+	}
+	Check("ScaleSpan bit-exact", Diff == 0, "");
+}
+
+static void TestBlur(void)
+{
+	uint8_t Ref[WS2812B_LEDS * 3];
+	long Diff = 0;
+
+	for(int n = 0; n < 100000; n++)
+	{
+		uint16_t Start = rand() % WS2812B_LEDS, Stop = Start + rand() % (WS2812B_LEDS - Start);
+
+		RandomStrip(Ref);
+		if(n & 1)	// Dark strips too, where saturation doesn't hide carries
+			for(int i = 0; i < WS2812B_LEDS * 3; i++)
+				WS2812B_GetPixels()[i] = Ref[i] >>= 2;
+		RefBlur(Ref, Start, Stop);
+		WS2812B_BlurSpan(Start, Stop - Start + 1);
+		Diff += memcmp(Ref, WS2812B_GetPixels(), sizeof(Ref)) != 0;
+	}
+	Check("BlurSpan bit-exact", Diff == 0, "");
+}
+
+static void BenchHSV(void)
+{
+	static uint16_t Hue[BENCH_PIXELS];
+	static uint8_t Sat[BENCH_PIXELS], Val[BENCH_PIXELS];
+	volatile uint32_t Sink = 0;
+	char Detail[96];
+	double t0, t1, t2, t3;
+
+	srand(1);
+	for(int i = 0; i < BENCH_PIXELS; i++)
+	{
+		Hue[i] = rand() % 360;
+		Sat[i] = rand();
+		Val[i] = rand();
+	}
+
+	t0 = Now();
+	for(int i = 0; i < BENCH_PIXELS; i++)
+	{
+		uint8_t r, g, b;
+		RefHSVtoRGB(Hue[i], Sat[i], Val[i], &r, &g, &b);
+		Sink += r + g + b;
+	}
+	t1 = Now();
+	for(int i = 0; i < BENCH_PIXELS; i++)
+	{
+		uint8_t r, g, b;
+		WS2812B_HSVtoRGB(Hue[i], Sat[i], Val[i], &r, &g, &b);
+		Sink += r + g + b;
+	}
+	t2 = Now();
+	for(int i = 0; i < BENCH_PIXELS; i += WS2812B_LEDS)
+	{
+		uint16_t n = (BENCH_PIXELS - i < WS2812B_LEDS) ? BENCH_PIXELS - i : WS2812B_LEDS;
+		WS2812B_SetSpanHSV(0, n, &Hue[i], &Sat[i], &Val[i]);
+		Sink += WS2812B_GetPixels()[0];
+	}
+	t3 = Now();
+
+	snprintf(Detail, sizeof(Detail), "ns/pixel old %.2f, new %.2f, span %.2f",
+			(t1 - t0) / BENCH_PIXELS, (t2 - t1) / BENCH_PIXELS, (t3 - t2) / BENCH_PIXELS);
+	Check("HSVtoRGB timing", 1, Detail);
+}
+
+int main(void)
+{
+	WS2812B_Init(&Spi);
+
+	TestHSVtoRGB();
+	TestRGBtoHSV();
+	TestGradient();
+	TestFade();
+	TestScale();
+	TestBlur();
+	BenchHSV();
+
+	return Failed;
+}
@@ -0,0 +1,208 @@
+/*
+ * map_test.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Output map checks on a PC
+//
+//	Every logical diode of the real ws2812b.c gets its own color, the strip is refreshed
+//	and the SPI DMA half and complete interrupts are raised until the encoder stops. The
+//	bits it writes to the DMA buffer are decoded back to colors of physical diodes and
+//	compared with the place the map says each logical diode goes to - straight, reversed,
+//	at an offset, several ranges. Maps that don't fit have to be refused and leave the
+//	old one on the strip. Exit code is 1 on a failure.
+//
+//	Build and run from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o map_test Tools/map_test/map_test.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c
+//	./map_test
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "ws2812b.h"
+
+#define BIT_ONE		0b11111000	// SPI byte of a 1 bit, as in ws2812b.c
+#define BIT_ZERO	0b11000000
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+
+static uint8_t *DmaBuffer;
+static uint8_t DmaRunning;
+static int Failed, BadBits;
+
+//
+//	HAL stand-in, the test raises the DMA interrupts itself
+//
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)Size;
+	DmaBuffer = pData;
+	DmaRunning = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	DmaRunning = 0;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+static void Check(const char *Name, int Ok)
+{
+	printf("%-52s %s\n", Name, Ok ? "ok" : "FAIL");
+	if(!Ok)
+		Failed = 1;
+}
+
+static ws2812b_color Logical(uint16_t i)
+{
+	ws2812b_color c = { i + 1, 0x80 | i, 0xFF - i };
+	return c;
+}
+
+static uint8_t Decode(const uint8_t *Bits)
+{
+	uint8_t v = 0;
+
+	for(uint8_t k = 0; k < 8; k++)
+	{
+		if(Bits[k] != BIT_ONE && Bits[k] != BIT_ZERO)
+			BadBits++;
+		v = (v << 1) | (Bits[k] == BIT_ONE);
+	}
+	return v;
+}
+
+//
+//	Refresh and decode what goes out on the wire, GRB per diode
+//
+static void Send(ws2812b_color *Physical)
+{
+	uint16_t Led = 0;
+	uint8_t Half = 1, Reset = 1;
+
+	WS2812B_Refresh();
+	while(DmaRunning)
+	{
+		if(Half) HAL_SPI_TxHalfCpltCallback(&Spi);
+		else HAL_SPI_TxCpltCallback(&Spi);
+
+		if(Reset)
+			Reset = 0;	// First half is the reset signal
+		else if(DmaRunning && Led < WS2812B_OUTPUT_LEDS)
+		{
+			const uint8_t *b = &DmaBuffer[Half ? 0 : 24];
+
+			Physical[Led].green = Decode(&b[0]);
+			Physical[Led].red = Decode(&b[8]);
+			Physical[Led].blue = Decode(&b[16]);
+			Led++;
+		}
+		Half ^= 1;
+	}
+}
+
+//
+//	Physical diodes expected from a map, unmapped ones black
+//
+static void Place(ws2812b_color *Physical, const ws2812b_map *Map, uint8_t Ranges)
+{
+	memset(Physical, 0, WS2812B_OUTPUT_LEDS * sizeof(ws2812b_color));
+	for(uint8_t r = 0; r < Ranges; r++)
+		for(uint16_t i = 0; i < Map[r].Count; i++)
+			Physical[Map[r].Offset + i] = Logical(Map[r].Reverse ? Map[r].Start + Map[r].Count - 1 - i : Map[r].Start + i);
+}
+
+static int Shows(const ws2812b_color *Expect)
+{
+	ws2812b_color Physical[WS2812B_OUTPUT_LEDS];
+
+	Send(Physical);
+	return !memcmp(Physical, Expect, sizeof(Physical));
+}
+
+static void Mapped(const char *Name, const ws2812b_map *Map, uint8_t Ranges)
+{
+	ws2812b_color Expect[WS2812B_OUTPUT_LEDS];
+	char Text[64];
+
+	snprintf(Text, sizeof(Text), "%s: taken", Name);
+	Check(Text, WS2812B_SetMap(Map, Ranges));
+	Place(Expect, Map, Ranges);
+	snprintf(Text, sizeof(Text), "%s: placement", Name);
+	Check(Text, Shows(Expect));
+}
+
+//
+//	Map that doesn't fit, Last is the one on the strip before
+//
+static void Refused(const char *Name, const ws2812b_map *Map, uint8_t Ranges, const ws2812b_map *Last)
+{
+	ws2812b_color Expect[WS2812B_OUTPUT_LEDS];
+	char Text[64];
+
+	snprintf(Text, sizeof(Text), "%s: refused", Name);
+	Check(Text, !WS2812B_SetMap(Map, Ranges));
+	Place(Expect, Last, 1);
+	snprintf(Text, sizeof(Text), "%s: old map kept", Name);
+	Check(Text, Shows(Expect));
+}
+
+int main(void)
+{
+	const ws2812b_map Straight = { 0, WS2812B_LEDS, 0, 0, 0 };
+	const ws2812b_map Reversed = { 0, WS2812B_LEDS, 0, 0, 1 };
+	const ws2812b_map Offset = { 0, 10, 0, 5, 0 };
+	const ws2812b_map Split[] = {	// Strip folded in the middle, a gap of dark diodes
+		{ 10, 20, 0, 0, 0 },
+		{ 0, 10, 0, WS2812B_OUTPUT_LEDS - 10, 1 },
+	};
+	const ws2812b_map Twice[] = { { 3, 4, 0, 0, 0 }, { 3, 4, 0, 10, 1 } };
+	const ws2812b_map OtherOutput[] = { { 0, 10, 0, 0, 0 }, { 10, 10, 1, 0, 0 } };
+	const ws2812b_map Overlap[] = { { 0, 10, 0, 0, 0 }, { 10, 10, 0, 9, 0 } };
+	const ws2812b_map PastStrip = { WS2812B_LEDS - 5, 6, 0, 0, 0 };
+	const ws2812b_map PastOutput = { 0, 10, 0, WS2812B_OUTPUT_LEDS - 9, 0 };
+	const ws2812b_map TooMany[WS2812B_MAP_SIZE + 1] = { { 0, 1, 0, 0, 0 } };
+	ws2812b_color Expect[WS2812B_OUTPUT_LEDS];
+
+	WS2812B_Init(&Spi);
+	for(uint16_t i = 0; i < WS2812B_LEDS; i++)
+		WS2812B_SetDiodeColorStruct(i, Logical(i));
+
+	Place(Expect, &Straight, 1);
+	Check("straight map after init", Shows(Expect));
+
+	Mapped("whole strip reversed", &Reversed, 1);
+	Mapped("range at an offset", &Offset, 1);
+	Mapped("range, reversed range at the end", Split, 2);
+	Mapped("one logical range in two places", Twice, 2);
+
+	Mapped("straight", &Straight, 1);
+	Refused("range on output 1", OtherOutput, 2, &Straight);
+	Refused("overlapping ranges", Overlap, 2, &Straight);
+	Refused("range past the strip", &PastStrip, 1, &Straight);
+	Refused("range past the output", &PastOutput, 1, &Straight);
+	Refused("more ranges than WS2812B_MAP_SIZE", TooMany, WS2812B_MAP_SIZE + 1, &Straight);
+
+	Check("encoder wrote only 0 and 1 bit bytes", !BadBits);
+	return Failed;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# mode_size.sh
+#
+#	The MIT License.
+#	Created on: 19.10.2026
+#		Author: agent
+#		agent@local
+#
+
+#
+#	Per-mode flash report
+#
+#	Expands the mode list in Core/Inc/ws2812b_fx_modes.h with the C preprocessor and
+#	reads the symbol sizes of a built image, writes one line per mode - number, enum
+#	name, function, bytes - and the total, biggest mode last. Modes with FX_HAS_<mode>
+#	set to 0 are left out, so the report shows what the image really holds. Helpers shared by several modes are not
+#	counted, they stay while any mode using them is in the list.
+#
+#	Run from the repository root after a build:
+#
+#	Tools/mode_size/mode_size.sh [Debug/WS2812B_C8.elf] [report.txt]
+#
+#	NM and CC select the tools, arm-none-eabi-nm and arm-none-eabi-gcc by default.
+#	Host objects work as well for a quick comparison - sizes are then for the host CPU:
+#
+#	gcc -O2 -std=gnu11 -ffunction-sections -ITools/fx_render -ICore/Inc -c -o /tmp/fx.o Core/Src/ws2812b_fx.c
+#	NM=nm CC=gcc Tools/mode_size/mode_size.sh /tmp/fx.o
+#
+
+Elf=${1:-Debug/WS2812B_C8.elf}
+Out=${2:-/dev/stdout}
+Nm=${NM:-arm-none-eabi-nm}
+Cc=${CC:-arm-none-eabi-gcc}
+Modes=Core/Inc/ws2812b_fx_modes.h
+
+if [ ! -f "$Elf" ] || [ ! -f "$Modes" ]; then
+	echo "Usage: $0 [image.elf] [report.txt], run from the repository root" >&2
+	exit 1
+fi
+
+List=$(printf '#define FX_MODE(Name, Function) Name Function\n#include "ws2812b_fx_modes.h"\n' |
+	$Cc -E -P -ICore/Inc -x c -) || exit 1
+
+"$Nm" -S -t d "$Elf" | awk -v List="$List" '
+	NF == 4 { Size[$4] = $2 + 0 }
+	END {
+		Modes = split(List, Line, "\n")
+		for(i = 1; i <= Modes; i++)
+		{
+			if(split(Line[i], Field) != 2)
+				continue
+			if(!(Field[2] in Size))
+			{
+				printf("%s not in the image\n", Field[2]) > "/dev/stderr"
+				Missing = 1
+			}
+			printf("%3d %-36s %-32s %6d\n", Count++, Field[1], Field[2], Size[Field[2]]) | "sort -n -k4"
+			Total += Size[Field[2]]
+		}
+		close("sort -n -k4")
+		printf("%d modes, %d bytes\n", Count, Total)
+		exit Missing
+	}' > "$Out"
@@ -0,0 +1,133 @@
+/*
+ * parse_bench.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	USB command parser timing on a PC
+//
+//	Every command line goes through USB_ParsingReceive and USB_Parsing the way
+//	CDC_Receive_FS and the main loop pass it on the MCU, replies are taken by a
+//	CDC stand-in at once. Prints time per command and the first reply.
+//	Host figures only show relative cost - cycles on the MCU come from the DWT
+//	counter, see USB_PARSING_CYCLES in usb_parsing.h.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o parse_bench Tools/parse_bench/parse_bench.c Core/Src/usb_parsing.c Core/Src/usb_stream.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c Core/Src/ws2812b_matrix.c Core/Src/ws2812b_fx.c Core/Src/ws2812b_scene.c Core/Src/ws2812b_sequence.c
+//
+#include "stm32f1xx_hal.h"
+#include "usbd_cdc_if.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+#include "usb_parsing.h"
+
+#define BENCH_RUNS		200000
+
+static const char * const Commands[] = {
+	"C0,255,128,0\n",
+	"V0,2000\n",
+	"M0,5\n",
+	"M0,S\n",
+	"P0,3\n",
+	"R0,R,0,10\n",
+	"X\n",
+};
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+static char Reply[USB_TX_BUFFER_SIZE + 1];
+static uint8_t Capture;
+
+//
+//	HAL and CDC stand-ins. Flash is never written, scene commands are not timed.
+//
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { return HAL_ERROR; }
+HAL_StatusTypeDef HAL_FLASH_Lock(void) { return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) { (void)TypeProgram; (void)Address; (void)Data; return HAL_ERROR; }
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError) { (void)pEraseInit; (void)PageError; return HAL_ERROR; }
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
+{
+	if(Capture)
+	{
+		memcpy(Reply, Buf, Len);
+		Reply[Len] = 0;
+		Capture = 0;
+	}
+	return USBD_OK;
+}
+
+uint8_t CDC_TransmitBusy_FS(void)
+{
+	return 0;
+}
+
+void CDC_ResumeReceive_FS(void)
+{
+}
+
+static double Seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	WS2812B_Init(&Spi);
+	WS2812BFX_Init(3);
+	USB_Parsing();
+
+	for(uint8_t c = 0; c < sizeof(Commands) / sizeof(Commands[0]); c++)
+	{
+		const char *Line = Commands[c];
+		uint32_t Len = strlen(Line);
+
+		Reply[0] = 0;
+		Capture = 1;
+		double Start = Seconds();
+		for(uint32_t i = 0; i < BENCH_RUNS; i++)
+		{
+			USB_ParsingReceive((const uint8_t*)Line, Len);
+			USB_Parsing();
+		}
+		double Ns = (Seconds() - Start) * 1e9 / BENCH_RUNS;
+
+		Reply[strcspn(Reply, "\r\n")] = 0;
+		printf("%-14.*s %7.1f ns  %s\n", (int)(Len - 1), Line, Ns, Reply);
+	}
+	return 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * scene_test.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Scene save and load on a PC
+//
+//	The real ws2812b_scene.c and FX library run against flash kept in RAM, mapped at
+//	FLASH_BASE so record addresses are the same as on the MCU. The stand-in behaves
+//	like the F1 flash - halfword programming only into erased cells, page erase to
+//	0xFF, locking - and can cut the power after a number of halfwords.
+//
+//	Checked: round trip of a whole setup, many saves over both pages, a record with
+//	a bad CRC, records torn at every halfword, sequence numbers wrapping past 0xFFFF.
+//	Exit code is 1 on a failure.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o scene_test Tools/scene_test/scene_test.c Core/Src/ws2812b_scene.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c Core/Src/ws2812b_matrix.c Core/Src/ws2812b_fx.c
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+#include "ws2812b_scene.h"
+
+#define FLASH_SIZE		(64 * 1024)
+#define NO_CUT			0xFFFFFFFF
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+
+static uint8_t *Flash;
+static uint8_t Locked = 1;
+static uint32_t PowerLeft = NO_CUT;	// Halfwords programmed before the power goes
+static uint32_t Erases;
+static int Failed;
+
+//
+//	HAL stand-in
+//
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	Locked = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	Locked = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	uint8_t *Cell = &Flash[Address - FLASH_BASE];
+
+	if(Locked || TypeProgram != FLASH_TYPEPROGRAM_HALFWORD || (Address & 1) ||
+		Address < FLASH_BASE || Address + 2 > FLASH_BASE + FLASH_SIZE)
+		return HAL_ERROR;
+	if(!PowerLeft)
+		return HAL_ERROR;
+	if(PowerLeft != NO_CUT)
+		PowerLeft--;
+	if(Cell[0] != 0xFF || Cell[1] != 0xFF)	// Programming error on a cell not erased
+		return HAL_ERROR;
+
+	Cell[0] = Data & 0xFF;
+	Cell[1] = (Data >> 8) & 0xFF;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+	uint32_t Addr = pEraseInit->PageAddress;
+
+	*PageError = 0xFFFFFFFF;
+	if(Locked || (Addr - FLASH_BASE) % FLASH_PAGE_SIZE ||
+		Addr + pEraseInit->NbPages * FLASH_PAGE_SIZE > FLASH_BASE + FLASH_SIZE || !PowerLeft)
+		return HAL_ERROR;
+
+	memset(&Flash[Addr - FLASH_BASE], 0xFF, pEraseInit->NbPages * FLASH_PAGE_SIZE);
+	Erases++;
+	return HAL_OK;
+}
+
+static void Check(const char *Name, int Ok)
+{
+	printf("%-44s %s\n", Name, Ok ? "ok" : "FAIL");
+	if(!Ok)
+		Failed = 1;
+}
+
+//
+//	Setup number k - three segments, everything that goes into a record differs
+//
+static void Scene(uint16_t k)
+{
+	static const uint16_t Start[] = { 0, 10, 21 }, Stop[] = { 9, 20, WS2812B_LEDS - 1 };
+
+	WS2812BFX_Init(3);
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		WS2812BFX_SetSegmentSize(i, Start[i], Stop[i]);
+		WS2812BFX_SetSpeed(i, SPEED_MIN + k * 3 + i);
+		WS2812BFX_SetReverse(i, (k + i) & 1);
+		WS2812BFX_SetPalette(i, (k + i) % PALETTE_COUNT);
+		for(uint8_t j = 0; j < NUM_COLORS; j++)
+			WS2812BFX_SetColorRGB(j, k + i, k * 7 + j, 255 - k);
+		WS2812BFX_SetMode(i, (k * 5 + i) % MODE_COUNT);
+		WS2812BFX_SetTransition(i, k * 10 + i);
+		if((k + i) % 3)
+			WS2812BFX_Start(i);
+		else
+			WS2812BFX_Stop(i);
+	}
+}
+
+//
+//	Loaded setup is setup k
+//
+static int Loaded(uint16_t k)
+{
+	static uint8_t Expect[SCENE_MAX_SIZE], Got[SCENE_MAX_SIZE];
+	uint16_t Length;
+
+	Scene(k);
+	Length = WS2812BFX_SceneSerialize(Expect, 0);
+	Scene(k + 1000);	// Something else running before the load
+	if(WS2812BFX_SceneLoad() != FX_OK)
+		return 0;
+	return WS2812BFX_SceneSerialize(Got, 0) == Length && !memcmp(Expect, Got, Length);
+}
+
+static int Save(uint16_t k)
+{
+	Scene(k);
+	return WS2812BFX_SceneSave() == FX_OK;
+}
+
+//
+//	Record number Index in a page
+//
+static uint8_t *Record(uint8_t Page, uint16_t Index)
+{
+	uint8_t *p = &Flash[SCENE_FLASH_START - FLASH_BASE + Page * FLASH_PAGE_SIZE];
+
+	while(Index--)
+		p += p[2] | (p[3] << 8);
+	return p;
+}
+
+static void Wipe(void)
+{
+	memset(Flash, 0xFF, FLASH_SIZE);
+	PowerLeft = NO_CUT;
+}
+
+static void TestRoundTrip(void)
+{
+	Wipe();
+	Check("empty flash loads nothing", WS2812BFX_SceneLoad() != FX_OK);
+	Check("save and load", Save(1) && Loaded(1));
+	Check("second save wins", Save(2) && Loaded(2));
+	Check("clear", WS2812BFX_SceneClear() == FX_OK && WS2812BFX_SceneLoad() != FX_OK);
+}
+
+static void TestManySaves(void)
+{
+	uint16_t PerPage = FLASH_PAGE_SIZE / (SCENE_HEADER_SIZE + 2 + 3 * SCENE_SEGMENT_SIZE);
+	int Ok = 1;
+
+	Wipe();
+	Erases = 0;
+	for(uint16_t k = 0; k < PerPage * SCENE_FLASH_PAGES * 4 && Ok; k++)
+		Ok = Save(k) && Loaded(k);
+	Check("saves over both pages, each loads back", Ok);
+	Check("page erased once per page of records", Erases == 4 * SCENE_FLASH_PAGES - 1);	// First one was blank
+}
+
+static void TestBadCrc(void)
+{
+	Wipe();
+	Save(1);
+	Save(2);
+	uint8_t *p = Record(0, 1) + SCENE_HEADER_SIZE + 2;
+	while(!*p)
+		p++;
+	*p &= *p - 1;	// Flash bit falls to 0
+	Check("bad CRC record skipped, older one loads", Loaded(1));
+	Check("next save after a bad record", Save(3) && Loaded(3));
+}
+
+static void TestTorn(void)
+{
+	uint16_t Length = SCENE_HEADER_SIZE + 2 + 3 * SCENE_SEGMENT_SIZE;
+	int Older = 1, Next = 1;
+
+	for(uint32_t Cut = 0; Cut < Length / 2; Cut++)
+	{
+		Wipe();
+		Save(1);
+		PowerLeft = Cut;
+		Save(2);
+		PowerLeft = NO_CUT;
+		Older &= Loaded(1);
+		Next &= Save(3) && Loaded(3) && Save(4) && Loaded(4);
+	}
+	Check("torn record at every halfword, older loads", Older);
+	Check("saves after a torn record", Next);
+
+	uint16_t k = 0;	// Saves which fill the first page
+	Wipe();
+	while(Record(1, 0)[0] == 0xFF)
+		Save(k++);
+
+	Wipe();	// Second page erased, its first record torn - newest is back in the first page
+	for(uint16_t i = 0; i < k - 1; i++)
+		Save(i);
+	PowerLeft = 3;
+	Save(k - 1);
+	PowerLeft = NO_CUT;
+	Check("torn first record of the next page", Loaded(k - 2));
+}
+
+static void TestSequenceWrap(void)
+{
+	static uint8_t Buf[SCENE_MAX_SIZE];
+	uint16_t Seq[5];
+	int Ok = 1;
+
+	Wipe();
+	Scene(1);
+	uint16_t Length = WS2812BFX_SceneSerialize(Buf, 0xFFFD);
+	HAL_FLASH_Unlock();
+	for(uint16_t i = 0; i < Length; i += 2)
+		HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, SCENE_FLASH_START + i, Buf[i] | (Buf[i + 1] << 8));
+	HAL_FLASH_Lock();
+	Ok &= Loaded(1);
+
+	for(uint16_t k = 0; k < 5; k++)
+	{
+		Ok &= Save(2 + k) && Loaded(2 + k);
+		uint8_t *p = Record(0, 1 + k);
+		Seq[k] = p[4] | (p[5] << 8);
+	}
+	Check("sequence 0xFFFD..0x0002, newest loads", Ok);
+	Check("sequence numbers wrap", Seq[0] == 0xFFFE && Seq[1] == 0xFFFF && Seq[2] == 0x0000 && Seq[4] == 0x0002);
+
+	Wipe();	// Wrapped record in the other page than the older one
+	Scene(1);
+	Length = WS2812BFX_SceneSerialize(Buf, 0xFFFF);
+	HAL_FLASH_Unlock();
+	for(uint16_t i = 0; i < Length; i += 2)
+		HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, SCENE_FLASH_START + FLASH_PAGE_SIZE + i, Buf[i] | (Buf[i + 1] << 8));
+	Scene(2);
+	Length = WS2812BFX_SceneSerialize(Buf, 0x0000);
+	for(uint16_t i = 0; i < Length; i += 2)
+		HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, SCENE_FLASH_START + i, Buf[i] | (Buf[i + 1] << 8));
+	HAL_FLASH_Lock();
+	Check("0x0000 in page 0 newer than 0xFFFF in page 1", Loaded(2));
+}
+
+int main(void)
+{
+	Flash = mmap((void*)(uintptr_t)FLASH_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if(Flash != (uint8_t*)(uintptr_t)FLASH_BASE)
+	{
+		perror("Flash at FLASH_BASE");
+		return 1;
+	}
+
+	WS2812B_Init(&Spi);
+
+	TestRoundTrip();
+	TestManySaves();
+	TestBadCrc();
+	TestTorn();
+	TestSequenceWrap();
+
+	Check("flash locked after every operation", Locked);
+	return Failed;
+}
@@ -0,0 +1,702 @@
+/*
+ * seq_asm.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Show sequence assembler, disassembler and simulator
+//
+//	Source is one instruction per line, mnemonics and operands as in ws2812b_sequence.h,
+//	separated by spaces or commas. Numbers are decimal or 0x hex, modes a number or
+//	a name from ws2812b_fx_modes.h with or without FX_MODE_. '#' or ';' starts a comment.
+//
+//		COLOR 0 255 64 0
+//		MODE 0 FX_MODE_STATIC
+//		REPEAT 0
+//			WAIT 2000
+//			XFADE 0 RAINBOW_CYCLE 500
+//			WAIT 2000
+//			XFADE 0 STATIC 500
+//		ENDREPEAT
+//		END
+//
+//	Assembled program goes through the real verifier from ws2812b_sequence.c. Output is
+//	'QC', 'QW' lines which fit the USB line buffer and 'QR' - ready to send to the
+//	device - or the plain program with -b. Disassembler takes either of them.
+//	With -r the real interpreter runs the program on top of the FX library and the
+//	fx_render HAL stand-in, and prints what it changed with the time in ms.
+//	-T runs the self-test of the interpreter, exit code is 1 on a failure.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o seq_asm Tools/seq_asm/seq_asm.c Core/Src/ws2812b_sequence.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c Core/Src/ws2812b_matrix.c Core/Src/ws2812b_fx.c
+//
+//	Example:
+//
+//	./seq_asm show.seq > /dev/ttyACM0
+//	./seq_asm -r 10000 show.seq
+//
+#include "stm32f1xx_hal.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "ws2812b.h"
+#include "ws2812b_fx.h"
+#include "ws2812b_sequence.h"
+
+#define ASM_LINE_BYTES		64		// Program bytes in one 'QW' line
+#define ASM_SEGMENTS_MAX	8
+#define ASM_EVENTS_MAX		256
+
+static const char * const Mnemonic[SEQ_OPCODE_COUNT] =
+{
+	[SEQ_END] = "END",
+	[SEQ_MODE] = "MODE",
+	[SEQ_COLOR] = "COLOR",
+	[SEQ_SPEED] = "SPEED",
+	[SEQ_WAIT] = "WAIT",
+	[SEQ_REPEAT] = "REPEAT",
+	[SEQ_ENDREPEAT] = "ENDREPEAT",
+	[SEQ_XFADE] = "XFADE",
+	[SEQ_START] = "START",
+	[SEQ_STOP] = "STOP",
+};
+
+//
+//	Operands in order: s - segment, m - mode, c - color id, b - byte, w - 16 bit
+//
+static const char * const Layout[SEQ_OPCODE_COUNT] =
+{
+	[SEQ_END] = "",
+	[SEQ_MODE] = "sm",
+	[SEQ_COLOR] = "cbbb",
+	[SEQ_SPEED] = "sw",
+	[SEQ_WAIT] = "w",
+	[SEQ_REPEAT] = "b",
+	[SEQ_ENDREPEAT] = "",
+	[SEQ_XFADE] = "smw",
+	[SEQ_START] = "s",
+	[SEQ_STOP] = "s",
+};
+
+static const char * const ModeName[MODE_COUNT] =
+{
+#define FX_MODE(Name, Function) #Name,
+#include "ws2812b_fx_modes.h"
+#undef FX_MODE
+};
+
+typedef struct
+{
+	uint32_t Time;
+	uint16_t Segment;
+	char Kind;		// 'M' mode, 'V' speed, 'R' running, 'E' sequence end
+	uint32_t Value;
+} asm_event;
+
+static asm_event Events[ASM_EVENTS_MAX];
+static uint16_t EventCount;
+static uint16_t Segments = 1;
+static uint8_t Quiet;
+static int Failed;
+
+static uint32_t Tick;
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+
+//
+//	HAL stand-in, the same as in fx_render
+//
+uint32_t HAL_GetTick(void)
+{
+	return Tick;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"Usage: %s [options] file\n"
+		"  (none)            assemble to 'QC', 'QW' and 'QR' command lines\n"
+		"  -b                assemble to the plain program\n"
+		"  -o file           output, default stdout\n"
+		"  -d                disassemble a program or command lines\n"
+		"  -r ms             run in the simulator, print changes\n"
+		"  -g n              segments in the simulator 1-%d, default 1\n"
+		"  -e ms             main loop period in the simulator, default 1\n"
+		"  -T                self-test, no file\n",
+		Name, ASM_SEGMENTS_MAX);
+	exit(1);
+}
+
+static void Error(uint16_t Line, const char *Text, const char *Token)
+{
+	if(!Quiet)
+		fprintf(stderr, "line %u: %s%s%s\n", Line, Text, Token ? " " : "", Token ? Token : "");
+}
+
+static int Mode(const char *Token, long *Value)
+{
+	for(int i = 0; i < MODE_COUNT; i++)
+	{
+		if(!strcasecmp(Token, ModeName[i]) || !strcasecmp(Token, ModeName[i] + strlen("FX_MODE_")))
+		{
+			*Value = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//
+//	Source to program. Returns the length, -1 on an error.
+//
+static int Assemble(const char *Src, uint8_t *Out)
+{
+	char Line[256];
+	uint16_t Number = 0;
+	int n = 0;
+
+	while(*Src)
+	{
+		size_t Length = strcspn(Src, "\n");
+		char *Save, *Token;
+		int Op;
+
+		Number++;
+		if(Length >= sizeof(Line))
+		{
+			Error(Number, "line too long", NULL);
+			return -1;
+		}
+		memcpy(Line, Src, Length);
+		Line[Length] = 0;
+		Src += Length + (Src[Length] != 0);
+		Line[strcspn(Line, "#;")] = 0;
+
+		if(!(Token = strtok_r(Line, " \t\r,", &Save)))
+			continue;
+		for(Op = 0; Op < SEQ_OPCODE_COUNT && strcasecmp(Token, Mnemonic[Op]); Op++);
+		if(Op == SEQ_OPCODE_COUNT)
+		{
+			Error(Number, "unknown instruction", Token);
+			return -1;
+		}
+		if(n + 1 > SEQUENCE_SIZE)
+		{
+			Error(Number, "program longer than", "SEQUENCE_SIZE");
+			return -1;
+		}
+		Out[n++] = Op;
+
+		for(const char *l = Layout[Op]; *l; l++)
+		{
+			long Value, Max = (*l == 'w') ? 0xFFFF : (*l == 'c') ? NUM_COLORS - 1 : (*l == 'm') ? MODE_COUNT - 1 : 0xFF;
+			char *End;
+
+			if(!(Token = strtok_r(NULL, " \t\r,", &Save)))
+			{
+				Error(Number, "missing operand for", Mnemonic[Op]);
+				return -1;
+			}
+			Value = strtol(Token, &End, 0);
+			if((End == Token || *End) && !(*l == 'm' && Mode(Token, &Value)))
+			{
+				Error(Number, "bad operand", Token);
+				return -1;
+			}
+			if(Value < 0 || Value > Max)
+			{
+				Error(Number, "operand out of range", Token);
+				return -1;
+			}
+			if(n + 1 + (*l == 'w') > SEQUENCE_SIZE)
+			{
+				Error(Number, "program longer than", "SEQUENCE_SIZE");
+				return -1;
+			}
+			Out[n++] = Value & 0xFF;
+			if(*l == 'w')
+				Out[n++] = Value >> 8;
+		}
+		if((Token = strtok_r(NULL, " \t\r,", &Save)))
+		{
+			Error(Number, "extra operand", Token);
+			return -1;
+		}
+	}
+	return n;
+}
+
+//
+//	Program to source which assembles back to the same bytes. Returns 1 on a byte
+//	which is not an instruction or a cut operand.
+//
+static int Disassemble(const uint8_t *Code, uint16_t Length, FILE *Out)
+{
+	uint16_t Pc = 0, Depth = 0;
+
+	while(Pc < Length)
+	{
+		uint8_t Op = Code[Pc];
+		uint16_t Size = 1;
+
+		if(Op >= SEQ_OPCODE_COUNT)
+		{
+			fprintf(Out, "# %04x: bad opcode 0x%02x\n", Pc, Op);
+			return 1;
+		}
+		for(const char *l = Layout[Op]; *l; l++)
+			Size += (*l == 'w') ? 2 : 1;
+		if(Pc + Size > Length)
+		{
+			fprintf(Out, "# %04x: %s cut short\n", Pc, Mnemonic[Op]);
+			return 1;
+		}
+
+		if(Op == SEQ_ENDREPEAT && Depth)
+			Depth--;
+		fprintf(Out, "%*s%s", Depth * 2, "", Mnemonic[Op]);
+		const uint8_t *p = &Code[Pc + 1];
+		for(const char *l = Layout[Op]; *l; l++)
+		{
+			uint8_t Byte = *p++;
+
+			if(*l == 'w')
+				fprintf(Out, " %u", Byte | (*p++ << 8));
+			else if(*l == 'm' && Byte < MODE_COUNT)
+				fprintf(Out, " %s", ModeName[Byte]);
+			else
+				fprintf(Out, " %u", Byte);
+		}
+		fprintf(Out, "\t\t# %04x\n", Pc);
+		if(Op == SEQ_REPEAT)
+			Depth++;
+		Pc += Size;
+	}
+	return 0;
+}
+
+//
+//	'QW,x,hex' lines to a program, other lines are skipped
+//
+static int FromCommands(const char *Text, uint8_t *Code)
+{
+	int Length = 0;
+
+	while(*Text)
+	{
+		unsigned Offset;
+		int Used;
+
+		if(sscanf(Text, "QW,%u,%n", &Offset, &Used) == 1)
+		{
+			for(Text += Used; Offset < SEQUENCE_SIZE && isxdigit(Text[0]) && isxdigit(Text[1]); Text += 2)
+			{
+				sscanf(Text, "%2hhx", &Code[Offset++]);
+				if((int)Offset > Length)
+					Length = Offset;
+			}
+		}
+		Text += strcspn(Text, "\n");
+		Text += (*Text != 0);
+	}
+	return Length;
+}
+
+static char* ReadFile(const char *Name, size_t *Size)
+{
+	FILE *f = fopen(Name, "rb");
+	char *Data = NULL;
+	size_t n = 0, Got;
+
+	if(!f)
+		return NULL;
+	do
+	{
+		Data = realloc(Data, n + 4096 + 1);
+		Got = fread(Data + n, 1, 4096, f);
+		n += Got;
+	} while(Got);
+	fclose(f);
+	Data[n] = 0;
+	*Size = n;
+	return Data;
+}
+
+//
+//	Fresh FX setup with every segment running, program in the slot and started
+//
+static FX_STATUS Load(const uint8_t *Code, uint16_t Length)
+{
+	Tick = 0;
+	EventCount = 0;
+	WS2812BFX_Init(Segments);
+	for(uint16_t i = 0; i < Segments; i++)
+		WS2812BFX_Start(i);
+	WS2812BFX_SequenceClear();
+	if(WS2812BFX_SequenceWrite(0, Code, Length) != FX_OK)
+		return FX_ERROR;
+	return WS2812BFX_SequenceStart();
+}
+
+static void Log(uint16_t Segment, char Kind, uint32_t Value)
+{
+	if(EventCount < ASM_EVENTS_MAX)
+		Events[EventCount++] = (asm_event){ Tick, Segment, Kind, Value };
+}
+
+//
+//	Main loop every Every ms for up to Ms ms or until the sequence ends
+//
+static void Simulate(uint32_t Ms, uint32_t Every)
+{
+	fx_mode Mode[ASM_SEGMENTS_MAX];
+	uint16_t Speed[ASM_SEGMENTS_MAX];
+	uint8_t Running[ASM_SEGMENTS_MAX];
+
+	for(uint16_t i = 0; i < Segments; i++)
+	{
+		WS2812BFX_GetMode(i, &Mode[i]);
+		WS2812BFX_GetSpeed(i, &Speed[i]);
+		WS2812BFX_IsRunning(i, &Running[i]);
+	}
+
+	while(Tick < Ms && WS2812BFX_SequenceIsRunning())
+	{
+		Tick++;
+		WS2812BFX_SysTickCallback();
+		if(Tick % Every)
+			continue;
+		WS2812BFX_SequenceCallback();
+		WS2812BFX_Callback();
+
+		for(uint16_t i = 0; i < Segments; i++)
+		{
+			fx_mode m;
+			uint16_t s;
+			uint8_t r;
+
+			WS2812BFX_GetMode(i, &m);
+			WS2812BFX_GetSpeed(i, &s);
+			WS2812BFX_IsRunning(i, &r);
+			if(m != Mode[i]) Log(i, 'M', Mode[i] = m);
+			if(s != Speed[i]) Log(i, 'V', Speed[i] = s);
+			if(r != Running[i]) Log(i, 'R', Running[i] = r);
+		}
+		if(!WS2812BFX_SequenceIsRunning())
+			Log(0, 'E', 0);
+	}
+}
+
+static void PrintEvents(FILE *Out)
+{
+	for(uint16_t i = 0; i < EventCount; i++)
+	{
+		asm_event *e = &Events[i];
+
+		if(e->Kind == 'E')
+			fprintf(Out, "%8u  end\n", e->Time);
+		else if(e->Kind == 'M')
+			fprintf(Out, "%8u  seg %u  mode %s\n", e->Time, e->Segment, ModeName[e->Value]);
+		else if(e->Kind == 'V')
+			fprintf(Out, "%8u  seg %u  speed %u\n", e->Time, e->Segment, e->Value);
+		else
+			fprintf(Out, "%8u  seg %u  %s\n", e->Time, e->Segment, e->Value ? "start" : "stop");
+	}
+	if(EventCount == ASM_EVENTS_MAX)
+		fprintf(Out, "(trace full)\n");
+}
+
+//
+//	Self-test
+//
+static void Check(const char *Name, int Ok)
+{
+	printf("%-52s %s\n", Name, Ok ? "ok" : "FAIL");
+	if(!Ok)
+		Failed = 1;
+}
+
+//
+//	Assemble, load and run. Returns 0 if the program did not assemble or start.
+//
+static int Run(const char *Src, uint32_t Ms, uint32_t Every)
+{
+	uint8_t Code[SEQUENCE_SIZE];
+	int Length = Assemble(Src, Code);
+
+	if(Length < 0 || Load(Code, Length) != FX_OK)
+		return 0;
+	Simulate(Ms, Every);
+	return 1;
+}
+
+//
+//	Times of the events of one kind, 0 terminated list to compare with
+//
+static int Times(char Kind, const uint32_t *Expect)
+{
+	uint16_t n = 0;
+
+	for(uint16_t i = 0; i < EventCount; i++)
+	{
+		if(Events[i].Kind != Kind)
+			continue;
+		if(!Expect[n] || Events[i].Time != Expect[n])
+			return 0;
+		n++;
+	}
+	return !Expect[n];
+}
+
+static int Rejected(const uint8_t *Code, uint16_t Length)
+{
+	return Load(Code, Length) != FX_OK && !WS2812BFX_SequenceIsRunning();
+}
+
+static void TestAssembler(void)
+{
+	static const char Src[] =
+		"COLOR 0 255 128 0   # comment\n"
+		"MODE 0, FX_MODE_STATIC\n"
+		"speed 0 0x1234\n"
+		"REPEAT 3\n"
+		"\tWAIT 100 ; comment\n"
+		"\tXFADE 0 rainbow_cycle 300\n"
+		"ENDREPEAT\n"
+		"START 1\n"
+		"STOP 1\n"
+		"END";
+	static const uint8_t Expect[] = { 2, 0, 255, 128, 0, 1, 0, FX_MODE_STATIC, 3, 0, 0x34, 0x12, 5, 3,
+		4, 100, 0, 7, 0, FX_MODE_RAINBOW_CYCLE, 0x2C, 0x01, 6, 8, 1, 9, 1, 0 };
+	uint8_t Code[SEQUENCE_SIZE], Again[SEQUENCE_SIZE];
+	char *Text = NULL;
+	size_t Size;
+	int Length = Assemble(Src, Code), Length2 = -1;
+
+	Check("assembled bytes", Length == sizeof(Expect) && !memcmp(Code, Expect, sizeof(Expect)));
+
+	FILE *f = open_memstream(&Text, &Size);
+	int Bad = Disassemble(Code, Length, f);
+	fclose(f);
+	if(!Bad)
+		Length2 = Assemble(Text, Again);
+	Check("disassembled source assembles to the same bytes", Length2 == Length && !memcmp(Code, Again, Length));
+	free(Text);
+
+	Quiet = 1;
+	Check("unknown instruction rejected", Assemble("JUMP 0\nEND\n", Code) < 0);
+	Check("missing operand rejected", Assemble("MODE 0\nEND\n", Code) < 0);
+	Check("extra operand rejected", Assemble("START 0 1\nEND\n", Code) < 0);
+	Check("16 bit operand out of range rejected", Assemble("WAIT 65536\nEND\n", Code) < 0);
+	Check("unknown mode name rejected", Assemble("MODE 0 FX_MODE_NONE\nEND\n", Code) < 0);
+	Check("color id out of range rejected", Assemble("COLOR 3 0 0 0\nEND\n", Code) < 0);
+	Quiet = 0;
+}
+
+//
+//	REPEATs nested Depth deep, returns the length
+//
+static uint16_t Nest(uint8_t *Code, uint16_t Depth)
+{
+	uint16_t n = 0;
+
+	for(uint16_t i = 0; i < Depth; i++)
+	{
+		Code[n++] = SEQ_REPEAT;
+		Code[n++] = 1;
+	}
+	for(uint16_t i = 0; i < Depth; i++)
+		Code[n++] = SEQ_ENDREPEAT;
+	Code[n++] = SEQ_END;
+	return n;
+}
+
+static void TestVerifier(void)
+{
+	static const uint8_t BadOp[] = { SEQ_OPCODE_COUNT };
+	static const uint8_t Cut[] = { SEQ_MODE, 0 };
+	static const uint8_t NoEnd[] = { SEQ_WAIT, 10, 0 };
+	static const uint8_t Unopened[] = { SEQ_ENDREPEAT, SEQ_END };
+	static const uint8_t Unclosed[] = { SEQ_REPEAT, 2, SEQ_END };
+	static const uint8_t BadMode[] = { SEQ_MODE, 0, MODE_COUNT, SEQ_END };
+	static const uint8_t BadColor[] = { SEQ_COLOR, NUM_COLORS, 0, 0, 0, SEQ_END };
+	uint8_t Nested[3 * SEQUENCE_DEPTH + 4];
+
+	Check("bad opcode rejected", Rejected(BadOp, sizeof(BadOp)));
+	Check("operand past the end rejected", Rejected(Cut, sizeof(Cut)));
+	Check("missing END rejected", Rejected(NoEnd, sizeof(NoEnd)));
+	Check("ENDREPEAT without REPEAT rejected", Rejected(Unopened, sizeof(Unopened)));
+	Check("REPEAT without ENDREPEAT rejected", Rejected(Unclosed, sizeof(Unclosed)));
+	Check("mode past MODE_COUNT rejected", Rejected(BadMode, sizeof(BadMode)));
+	Check("color id past NUM_COLORS rejected", Rejected(BadColor, sizeof(BadColor)));
+	Check("REPEAT nested past SEQUENCE_DEPTH rejected", Rejected(Nested, Nest(Nested, SEQUENCE_DEPTH + 1)));
+	Check("REPEAT nested SEQUENCE_DEPTH deep runs", Load(Nested, Nest(Nested, SEQUENCE_DEPTH)) == FX_OK);
+}
+
+static void TestTiming(void)
+{
+	static const char Src[] = "MODE 0 1\nWAIT 100\nMODE 0 2\nWAIT 250\nMODE 0 3\nEND\n";
+	static const uint32_t Every1[] = { 1, 100, 350, 0 }, Every7[] = { 7, 105, 350, 0 }, End[] = { 350, 0 };
+
+	Check("WAIT ends on time", Run(Src, 1000, 1) && Times('M', Every1) && Times('E', End));
+	Check("late main loop does not add to the next WAIT", Run(Src, 1000, 7) && Times('M', Every7) && Times('E', End));
+}
+
+static void TestRepeat(void)
+{
+	static const uint32_t Speeds[] = { 1, 10, 20, 30, 40, 50, 0 }, End[] = { 60, 0 };
+	static const uint32_t Running[] = { 30, 35, 65, 70, 0 }, End2[] = { 70, 0 };
+
+	Check("REPEAT 3", Run("REPEAT 3\nSPEED 0 300\nWAIT 10\nSPEED 0 400\nWAIT 10\nENDREPEAT\nEND\n", 1000, 1)
+		&& Times('V', Speeds) && Times('E', End));
+	Check("nested REPEAT", Run("REPEAT 2\nREPEAT 3\nWAIT 10\nENDREPEAT\nSTOP 0\nWAIT 5\nSTART 0\nENDREPEAT\nEND\n", 1000, 1)
+		&& Times('R', Running) && Times('E', End2));
+	Check("REPEAT 0 runs forever", Run("REPEAT 0\nWAIT 10\nENDREPEAT\nEND\n", 5000, 1)
+		&& WS2812BFX_SequenceIsRunning() && !EventCount);
+}
+
+static void TestInstructions(void)
+{
+	static const uint32_t Steps[] = { 2, 0 };
+	static const uint8_t XFade[] = { SEQ_XFADE, 0, 5, 0x2C, 0x01, SEQ_END };
+	char Src[SEQUENCE_SIZE * 12];
+	uint16_t Time = 0;
+	fx_mode Mode = 0;
+	uint8_t r, g, b, Running = 1;
+	int n = 0;
+
+	Check("COLOR, XFADE and STOP", Run("COLOR 1 10 20 30\nXFADE 0 5 300\nSTOP 0\nEND\n", 1000, 1) &&
+		WS2812BFX_GetMode(0, &Mode) == FX_OK && Mode == 5 &&
+		WS2812BFX_GetColorRGB(1, &r, &g, &b) == FX_OK && r == 10 && g == 20 && b == 30 &&
+		WS2812BFX_IsRunning(0, &Running) == FX_OK && !Running);
+
+	Load(XFade, sizeof(XFade));
+	WS2812BFX_SetTransition(0, 77);
+	Simulate(10, 1);
+	Check("XFADE keeps the segment's own transition time", WS2812BFX_GetTransition(0, &Time) == FX_OK && Time == 77);
+
+	for(uint16_t i = 0; i < SEQUENCE_STEPS + 8; i++)	// No WAIT - spread over two callbacks
+		n += sprintf(&Src[n], "SPEED 0 %u\n", 100 + i);
+	sprintf(&Src[n], "END\n");
+	Check("SEQUENCE_STEPS instructions per callback", Run(Src, 1000, 1) && Times('E', Steps));
+}
+
+static int SelfTest(void)
+{
+	TestAssembler();
+	TestVerifier();
+	TestTiming();
+	TestRepeat();
+	TestInstructions();
+	return Failed;
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t Code[SEQUENCE_SIZE];
+	int Opt, Binary = 0, Dis = 0, Test = 0, Length;
+	long Ms = 0, Every = 1;
+	const char *OutName = NULL;
+	FILE *Out = stdout;
+	char *Text;
+	size_t Size;
+
+	while((Opt = getopt(argc, argv, "bo:dr:g:e:T")) != -1)
+	{
+		switch(Opt)
+		{
+		case 'b': Binary = 1; break;
+		case 'o': OutName = optarg; break;
+		case 'd': Dis = 1; break;
+		case 'r': Ms = strtol(optarg, NULL, 0); if(Ms <= 0) Usage(argv[0]); break;
+		case 'g': Segments = strtol(optarg, NULL, 0); if(Segments < 1 || Segments > ASM_SEGMENTS_MAX) Usage(argv[0]); break;
+		case 'e': Every = strtol(optarg, NULL, 0); if(Every <= 0) Usage(argv[0]); break;
+		case 'T': Test = 1; break;
+		default: Usage(argv[0]);
+		}
+	}
+
+	WS2812B_Init(&Spi);
+	if(Test)
+		return SelfTest();
+	if(optind != argc - 1)
+		Usage(argv[0]);
+
+	if(!(Text = ReadFile(argv[optind], &Size)))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	if(OutName && !(Out = fopen(OutName, Binary ? "wb" : "w")))
+	{
+		perror(OutName);
+		return 1;
+	}
+
+	if(Dis)
+	{
+		if(Text[0] == 'Q')
+			Length = FromCommands(Text, Code);
+		else
+		{
+			Length = (Size < SEQUENCE_SIZE) ? Size : SEQUENCE_SIZE;
+			memcpy(Code, Text, Length);
+		}
+		return Disassemble(Code, Length, Out);
+	}
+
+	if((Length = Assemble(Text, Code)) < 0)
+		return 1;
+	if(Load(Code, Length) != FX_OK)
+	{
+		fprintf(stderr, "%s: rejected by the sequence verifier - missing END or unbalanced REPEAT\n", argv[optind]);
+		return 1;
+	}
+
+	if(Ms)
+	{
+		Simulate(Ms, Every);
+		PrintEvents(Out);
+	}
+	else if(Binary)
+		fwrite(Code, 1, Length, Out);
+	else
+	{
+		fprintf(Out, "QC\n");
+		for(int i = 0; i < Length; i += ASM_LINE_BYTES)
+		{
+			fprintf(Out, "QW,%d,", i);
+			for(int j = i; j < Length && j < i + ASM_LINE_BYTES; j++)
+				fprintf(Out, "%02X", Code[j]);
+			fprintf(Out, "\n");
+		}
+		fprintf(Out, "QR\n");
+	}
+	return 0;
+}
@@ -0,0 +1,434 @@
+/*
+ * stream_bench.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Frames per second of USB streaming at a given LED count
+//
+//	Without -d the real usb_stream.c and ws2812b.c run against a simulated clock in
+//	microseconds. The host side keeps USB_STREAM_QUEUE_DEPTH frames unacknowledged
+//	like a real client, bytes go in 64-byte CDC packets at the -u rate, the SPI DMA
+//	interrupts come every 32 us (24 bytes per half buffer at 6 MHz) and frame notifies
+//	reach the host -r us after they are sent. After the run the strip has to hold the
+//	last frame and the stream counters have to be clean, otherwise exit code is 1.
+//
+//	With -d the same client talks to a board over its serial port and fps is measured
+//	from the frame notifies, one line per LED count.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o stream_bench Tools/stream_bench/stream_bench.c Core/Src/usb_stream.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c
+//
+//	Examples:
+//
+//	./stream_bench -n 10,35,100,300 -P tpm2
+//	./stream_bench -d /dev/ttyACM0 -n 10,35,100,300 -t 5000
+//
+//	Frames longer than the strip are cut by the device, so in the simulation a longer
+//	strip means a build with -DWS2812B_LEDS=n:
+//
+//	for n in 35 100 300; do gcc -DWS2812B_LEDS=$n ... && ./stream_bench -n $n; done
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+
+#include "ws2812b.h"
+#include "usb_stream.h"
+#include "usb_parsing.h"
+
+#define BENCH_MAX_LIST		16
+#define BENCH_MAX_LEDS		1024		// Adalight and TPM2 headers allow more, enough for a CDC link
+#define CDC_PACKET			64			// Full speed bulk packet
+#define SPI_HALF_US			32			// 24 SPI bytes at 6 MHz, one diode per DMA half buffer
+#define ACK_SIZE			7
+#define ACK_TIMEOUT_MS		500			// Device mode - notify lost, send again
+
+static long Leds[BENCH_MAX_LIST] = { WS2812B_LEDS };
+static int LedCounts = 1;
+static long Duration = 2000, Rate = 800, Latency = 1000;
+static uint8_t Tpm2 = 1;
+static const char *Device;
+
+static uint8_t Frame[BENCH_MAX_LEDS * 3 + 8];
+static uint8_t Pixels[BENCH_MAX_LEDS * 3];
+
+//
+//	Simulation. HAL stand-in driven by a microsecond clock.
+//
+static uint64_t Now;
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+static uint8_t DmaRunning, DmaHalf;
+static uint64_t DmaNext;
+static uint32_t DmaRestarts;
+
+#define ACK_QUEUE			8
+static uint16_t AckSeq[ACK_QUEUE];
+static uint64_t AckAt[ACK_QUEUE];
+static uint8_t AckHead, AckTail;
+
+// Host side of the simulation
+static uint32_t Sent, Length, Offset, Foreign;
+static uint64_t NextPacket;
+
+uint32_t HAL_GetTick(void)
+{
+	return Now / 1000;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	if(DmaRunning)	// Circular transfer keeps going, WS2812B_Refresh rewound its LED counter
+	{
+		DmaRestarts++;
+		return HAL_BUSY;
+	}
+	DmaRunning = 1;
+	DmaHalf = 1;
+	DmaNext = Now + SPI_HALF_US;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	DmaRunning = 0;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+//
+//	Frame notify from USB_StreamTask, seen by the host Latency us later
+//
+uint8_t USB_ParsingTransmit(const uint8_t *Buf, uint16_t Len)
+{
+	if(Len != ACK_SIZE || (uint8_t)(AckHead - AckTail) >= ACK_QUEUE)
+		return 0;
+	AckSeq[AckHead % ACK_QUEUE] = (Buf[4] << 8) | Buf[5];
+	AckAt[AckHead % ACK_QUEUE] = Now + Latency;
+	AckHead++;
+	return 1;
+}
+
+static void Usage(const char *Name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n leds[,...]     LEDs per frame, default %d\n"
+		"  -P ada|tpm2       frame format, default tpm2\n"
+		"  -t ms             time per LED count, default 2000\n"
+		"  -u kB/s           simulated USB payload rate, default 800\n"
+		"  -r us             simulated notify latency to the host, default 1000\n"
+		"  -d device         stream to a board instead, e.g. /dev/ttyACM0\n",
+		Name, WS2812B_LEDS);
+	exit(1);
+}
+
+static int ParseList(const char *Arg, long *Out)
+{
+	int Count = 0;
+	char *End;
+
+	while(*Arg && Count < BENCH_MAX_LIST)
+	{
+		Out[Count] = strtol(Arg, &End, 10);
+		if(End == Arg || Out[Count] < 1 || Out[Count] > BENCH_MAX_LEDS) return 0;
+		Arg = End;
+		Count++;
+
+		if(*Arg == ',') Arg++;
+		else if(*Arg) return 0;
+	}
+	return *Arg ? 0 : Count;
+}
+
+//
+//	Next frame of a moving gradient into Frame, returns its size on the wire
+//
+static uint32_t BuildFrame(uint32_t Number, long Count)
+{
+	uint32_t Size = Count * 3, n = 0;
+
+	for(uint32_t i = 0; i < Size; i++)
+		Pixels[i] = (uint8_t)(Number * 7 + i * 13);
+
+	if(Tpm2)
+	{
+		Frame[n++] = 0xC9;
+		Frame[n++] = 0xDA;
+		Frame[n++] = Size >> 8;
+		Frame[n++] = Size & 0xFF;
+	}
+	else
+	{
+		Frame[n++] = 'A';
+		Frame[n++] = 'd';
+		Frame[n++] = 'a';
+		Frame[n++] = (Count - 1) >> 8;
+		Frame[n++] = (Count - 1) & 0xFF;
+		Frame[n] = Frame[n - 2] ^ Frame[n - 1] ^ 0x55;
+		n++;
+	}
+	memcpy(&Frame[n], Pixels, Size);
+	n += Size;
+	if(Tpm2)
+		Frame[n++] = 0x36;
+	return n;
+}
+
+//
+//	One microsecond of the device - USB packet, DMA interrupt, main loop pass
+//
+static void SimStep(uint32_t PacketUs)
+{
+	if(Offset < Length && Now >= NextPacket)	// Receive callback runs in the USB interrupt
+	{
+		uint32_t Len = Length - Offset;
+		if(Len > CDC_PACKET) Len = CDC_PACKET;
+		Foreign += Len - USB_StreamReceive(&Frame[Offset], Len);
+		Offset += Len;
+		NextPacket = Now + PacketUs;
+	}
+
+	if(DmaRunning && Now >= DmaNext)
+	{
+		if(DmaHalf) HAL_SPI_TxHalfCpltCallback(&Spi);
+		else HAL_SPI_TxCpltCallback(&Spi);
+		DmaHalf ^= 1;
+		DmaNext = Now + SPI_HALF_US;
+	}
+
+	USB_StreamTask();
+}
+
+static int Simulate(long Count)
+{
+	uint32_t PacketUs = (CDC_PACKET * 1000 + Rate - 1) / Rate;
+	uint32_t Acked = 0, Frames = USB_StreamGetFrames(), Errors = USB_StreamGetErrors(), Dropped = USB_StreamGetDropped();
+	uint16_t Seq = 0, Base = 0;
+
+	Now = 0;
+	NextPacket = 0;
+	Sent = Length = Offset = Foreign = 0;
+	DmaRunning = 0;
+	DmaRestarts = 0;
+	AckTail = AckHead;
+	WS2812B_Init(&Spi);
+	USB_StreamSetNotify(1);
+
+	for(; Now < (uint64_t)Duration * 1000; Now++)
+	{
+		// Next frame once the previous one is written and the device queue has room
+		if(Offset == Length && (uint16_t)(Sent - Seq) < USB_STREAM_QUEUE_DEPTH)
+		{
+			Length = BuildFrame(Sent, Count);
+			Offset = 0;
+			Sent++;
+		}
+
+		SimStep(PacketUs);
+
+		// Notified sequence numbers are cumulative, the device counts from its own start
+		while(AckTail != AckHead && Now >= AckAt[AckTail % ACK_QUEUE])
+		{
+			uint16_t s = AckSeq[AckTail++ % ACK_QUEUE];
+			if(!Acked && !Seq) Base = s - 1;	// Sequence of the frame before our first one
+			s -= Base;
+			Acked += (uint16_t)(s - Seq);
+			Seq = s;
+		}
+	}
+
+	// Let the last frame through and compare the strip with it
+	for(uint64_t Drain = Now + 100000; Now < Drain; Now++)
+		SimStep(PacketUs);
+
+	uint32_t Shown = (Count < WS2812B_LEDS) ? Count : WS2812B_LEDS;
+	Errors = USB_StreamGetErrors() - Errors;
+	Dropped = USB_StreamGetDropped() - Dropped;
+	int Bad = Foreign || Errors || Dropped || memcmp(WS2812B_GetPixels(), Pixels, Shown * 3);
+
+	printf("%5ld LEDs %-4s %7.1f fps  presented %u  wire limit %.1f  strip limit %.1f  restarts %u  errors %u  dropped %u%s\n",
+		Count, Tpm2 ? "tpm2" : "ada", Acked * 1000.0 / Duration, USB_StreamGetFrames() - Frames,
+		Rate * 1000.0 / Length, 1e6 / ((WS2812B_OUTPUT_LEDS + 3) * SPI_HALF_US),
+		DmaRestarts, Errors, Dropped, Bad ? "  FAIL" : "");
+	return Bad;
+}
+
+//
+//	Device mode
+//
+static uint64_t Millis(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int WriteAll(int Fd, const uint8_t *Buf, uint32_t Len)
+{
+	while(Len)
+	{
+		ssize_t n = write(Fd, Buf, Len);
+		if(n <= 0) return 0;
+		Buf += n;
+		Len -= n;
+	}
+	return 1;
+}
+
+static void DrainText(int Fd)
+{
+	struct pollfd p = { Fd, POLLIN, 0 };
+	uint8_t Buf[256];
+
+	while(poll(&p, 1, 100) > 0 && read(Fd, Buf, sizeof(Buf)) > 0);
+}
+
+//
+//	Frame notify from the serial port, text replies in between are skipped
+//
+static int ReadNotify(int Fd, int Timeout, uint16_t *Seq)
+{
+	static uint8_t Ack[ACK_SIZE], Have;
+	struct pollfd p = { Fd, POLLIN, 0 };
+	uint8_t Byte;
+
+	while(poll(&p, 1, Timeout) > 0 && read(Fd, &Byte, 1) == 1)
+	{
+		if((Have == 0 && Byte != 0xC9) || (Have == 1 && Byte != 0xAA) ||
+			(Have == 6 && Byte != 0x36))
+		{
+			Have = 0;
+			continue;
+		}
+		Ack[Have++] = Byte;
+		if(Have == ACK_SIZE)
+		{
+			Have = 0;
+			*Seq = (Ack[4] << 8) | Ack[5];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int Stream(int Fd, long Count)
+{
+	uint32_t Frames = 0, Stalls = 0;
+	uint16_t Sent, Seq;
+	uint64_t Start, LastNotify;
+
+	// Device sequence runs on from earlier frames, the first notify gives the base
+	if(!WriteAll(Fd, Frame, BuildFrame(0, Count)) || !ReadNotify(Fd, ACK_TIMEOUT_MS, &Seq))
+	{
+		fprintf(stderr, "No frame notify, is the firmware streaming?\n");
+		return 1;
+	}
+	Sent = Seq;
+	Start = LastNotify = Millis();
+
+	while(Millis() - Start < (uint64_t)Duration)
+	{
+		if((uint16_t)(Sent - Seq) < USB_STREAM_QUEUE_DEPTH)
+		{
+			if(!WriteAll(Fd, Frame, BuildFrame(Sent, Count)))
+				return 1;
+			Sent++;
+			continue;
+		}
+
+		uint16_t s;
+		if(ReadNotify(Fd, 10, &s))
+		{
+			Frames += (uint16_t)(s - Seq);
+			Seq = s;
+			LastNotify = Millis();
+		}
+		else if(Millis() - LastNotify > ACK_TIMEOUT_MS)	// Frame lost, carry on from what was sent
+		{
+			Seq = Sent;
+			LastNotify = Millis();
+			Stalls++;
+		}
+	}
+
+	printf("%5ld LEDs %-4s %7.1f fps  stalls %u\n",
+		Count, Tpm2 ? "tpm2" : "ada", Frames * 1000.0 / (Millis() - Start), Stalls);
+	return Stalls != 0;
+}
+
+static int RunDevice(void)
+{
+	struct termios t;
+	int Status = 0;
+	int Fd = open(Device, O_RDWR | O_NOCTTY);
+
+	if(Fd < 0 || tcgetattr(Fd, &t))
+	{
+		perror(Device);
+		return 1;
+	}
+	cfmakeraw(&t);
+	tcsetattr(Fd, TCSANOW, &t);
+
+	WriteAll(Fd, (const uint8_t*)"F1\n", 3);
+	DrainText(Fd);
+	for(int i = 0; i < LedCounts; i++)
+	{
+		Status |= Stream(Fd, Leds[i]);
+		DrainText(Fd);
+	}
+	WriteAll(Fd, (const uint8_t*)"F0\n", 3);
+	close(Fd);
+	return Status;
+}
+
+int main(int argc, char **argv)
+{
+	int Opt, Status = 0;
+
+	while((Opt = getopt(argc, argv, "n:P:t:u:r:d:h")) != -1)
+	{
+		switch(Opt)
+		{
+		case 'n': if(!(LedCounts = ParseList(optarg, Leds))) Usage(argv[0]); break;
+		case 'P':
+			if(!strcmp(optarg, "ada")) Tpm2 = 0;
+			else if(!strcmp(optarg, "tpm2")) Tpm2 = 1;
+			else Usage(argv[0]);
+			break;
+		case 't': Duration = strtol(optarg, NULL, 10); break;
+		case 'u': Rate = strtol(optarg, NULL, 10); break;
+		case 'r': Latency = strtol(optarg, NULL, 10); break;
+		case 'd': Device = optarg; break;
+		default: Usage(argv[0]);
+		}
+	}
+	if(Duration <= 0 || Rate <= 0 || Latency < 0 || optind < argc)
+		Usage(argv[0]);
+
+	if(Device)
+		return RunDevice();
+
+	for(int i = 0; i < LedCounts; i++)
+		Status |= Simulate(Leds[i]);
+	return Status;
+}
@@ -0,0 +1,190 @@
+/*
+ * stream_test.c
+ *
+ *	The MIT License.
+ *	Created on: 19.10.2026
+ *		Author: agent
+ *		agent@local
+ */
+
+//
+//	Stream receive errors on a PC
+//
+//	The real usb_stream.c gets a good frame, then a frame broken at some point - bad
+//	Adalight checksum, reserved delta record, delta payload ending inside a record,
+//	wrong TPM2 end byte - and then a delta frame. The delta frame and the 'W' edit
+//	frame have to build on the good frame, not on what the broken one left in its
+//	queue slot. Run with the queue depth of the firmware and with depth 1, where a
+//	frame is received over the slot holding the base frame. Exit code is 1 on a failure.
+//
+//	Build from the repository root:
+//
+//	gcc -O2 -std=gnu11 -DUSB_STREAM_QUEUE_DEPTH=1 -ITools/fx_render -ICore/Inc -o stream_test Tools/stream_test/stream_test.c Core/Src/usb_stream.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c
+//	gcc -O2 -std=gnu11 -ITools/fx_render -ICore/Inc -o stream_test2 Tools/stream_test/stream_test.c Core/Src/usb_stream.c Core/Src/ws2812b.c Core/Src/ws2812b_correction.c
+//
+#include "stm32f1xx_hal.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "ws2812b.h"
+#include "usb_stream.h"
+#include "usb_parsing.h"
+
+#define DELTA_LITERAL		0x40
+#define DELTA_RESERVED		0xC0
+
+static DMA_HandleTypeDef DmaTx = { HAL_DMA_STATE_READY };
+static SPI_HandleTypeDef Spi = { &DmaTx };
+
+static uint8_t Good[WS2812B_LEDS * 3];
+static uint8_t Expect[WS2812B_LEDS * 3];
+static int Failed;
+
+//
+//	HAL stand-in. Refresh never completes, frames are read from the pixel buffer.
+//
+uint32_t HAL_GetTick(void)
+{
+	return 0;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	(void)hspi; (void)pData; (void)Size;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_DMAStop(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+uint8_t USB_ParsingTransmit(const uint8_t *Buf, uint16_t Len)
+{
+	(void)Buf; (void)Len;
+	return 1;
+}
+
+static void Check(const char *Name, int Ok)
+{
+	printf("%-52s %s\n", Name, Ok ? "ok" : "FAIL");
+	if(!Ok)
+		Failed = 1;
+}
+
+static void Receive(const uint8_t *Buf, uint32_t Len)
+{
+	USB_StreamReceive(Buf, Len);
+}
+
+//
+//	Full TPM2 frame of the pattern k, put on the strip
+//
+static void SendGood(uint8_t k)
+{
+	uint8_t Head[] = { 0xC9, 0xDA, (WS2812B_LEDS * 3) >> 8, (WS2812B_LEDS * 3) & 0xFF };
+
+	for(uint16_t i = 0; i < sizeof(Good); i++)
+		Good[i] = i * 7 + k;
+	Receive(Head, sizeof(Head));
+	Receive(Good, sizeof(Good));
+	Receive((const uint8_t*)"\x36", 1);
+	USB_StreamTask();
+}
+
+//
+//	Delta frame setting LED 2 to one color
+//
+static void SendDelta(void)
+{
+	static const uint8_t Frame[] = { 0xC9, 0xDE, 0x00, 0x05, 0x01, DELTA_LITERAL, 0x11, 0x22, 0x33, 0x36 };
+
+	Receive(Frame, sizeof(Frame));
+	memcpy(Expect, Good, sizeof(Expect));
+	memcpy(&Expect[2 * 3], &Frame[6], 3);
+}
+
+//
+//	Broken frame, then a delta frame on top of the good one
+//
+static void Broken(const char *Name, const uint8_t *Frame, uint32_t Len)
+{
+	static uint8_t Pattern;
+	char Text[80];
+	uint32_t Errors = USB_StreamGetErrors();
+
+	SendGood(++Pattern);
+	Receive(Frame, Len);
+	snprintf(Text, sizeof(Text), "%s: error counted", Name);
+	Check(Text, USB_StreamGetErrors() == Errors + 1);
+
+	snprintf(Text, sizeof(Text), "%s: edit frame is the good one", Name);
+	Check(Text, !memcmp(USB_StreamEdit(), Good, sizeof(Good)));
+	USB_StreamLatch();	// Edit frame goes out, the next one is taken afresh
+	USB_StreamTask();
+
+	SendDelta();
+	USB_StreamTask();
+	snprintf(Text, sizeof(Text), "%s: next delta builds on the good one", Name);
+	Check(Text, !memcmp(WS2812B_GetPixels(), Expect, sizeof(Expect)));
+}
+
+#if USB_STREAM_QUEUE_DEPTH > 1
+//
+//	Broken header of a frame following one still queued - the queued frame stays the base.
+//	Needs room for two frames in the queue.
+//
+static void BrokenBehindQueued(void)
+{
+	static const uint8_t BadChecksum[] = { 'A', 'd', 'a', 0x00, 0x02, 0x00 };
+	static const uint8_t Delta[] = { 0xC9, 0xDE, 0x00, 0x05, 0x01, DELTA_LITERAL, 0x44, 0x55, 0x66, 0x36 };
+	uint8_t Head[] = { 0xC9, 0xDA, (WS2812B_LEDS * 3) >> 8, (WS2812B_LEDS * 3) & 0xFF };
+
+	SendGood(1);
+	for(uint16_t i = 0; i < sizeof(Good); i++)	// Second frame not presented yet
+		Good[i] = i * 5 + 3;
+	Receive(Head, sizeof(Head));
+	Receive(Good, sizeof(Good));
+	Receive((const uint8_t*)"\x36", 1);
+	Receive(BadChecksum, sizeof(BadChecksum));
+	Receive(Delta, sizeof(Delta));
+	USB_StreamTask();
+	USB_StreamTask();
+
+	memcpy(Expect, Good, sizeof(Expect));
+	memcpy(&Expect[2 * 3], &Delta[6], 3);
+	Check("bad header behind a queued frame keeps it as base", !memcmp(WS2812B_GetPixels(), Expect, sizeof(Expect)));
+}
+#endif
+
+int main(void)
+{
+	static uint8_t Payload[4 + WS2812B_LEDS * 3 + 1] = { 0xC9, 0xDA, (WS2812B_LEDS * 3) >> 8, (WS2812B_LEDS * 3) & 0xFF };
+	static const uint8_t Reserved[] = { 0xC9, 0xDE, 0x00, 0x08, DELTA_LITERAL | 1, 1, 2, 3, 4, 5, 6, DELTA_RESERVED };
+	static const uint8_t CutRecord[] = { 0xC9, 0xDE, 0x00, 0x05, DELTA_LITERAL | 1, 9, 9, 9, 9 };
+	static const uint8_t BadChecksum[] = { 'A', 'd', 'a', 0x00, 0x02, 0x00 };
+
+	WS2812B_Init(&Spi);
+	printf("Queue depth %d\n", USB_STREAM_QUEUE_DEPTH);
+
+	Broken("reserved delta record", Reserved, sizeof(Reserved));
+	Broken("delta payload ends inside a record", CutRecord, sizeof(CutRecord));
+
+	for(uint16_t i = 4; i < sizeof(Payload) - 1; i++)
+		Payload[i] = 0xA5;
+	Payload[sizeof(Payload) - 1] = 0x00;	// Not the TPM2 end byte
+	Broken("whole payload, wrong TPM2 end", Payload, sizeof(Payload));
+
+	Broken("bad Adalight checksum", BadChecksum, sizeof(BadChecksum));
+#if USB_STREAM_QUEUE_DEPTH > 1
+	BrokenBehindQueued();
+#endif
+
+	return Failed;
+}
@@ -23,6 +23,8 @@
 #include "usbd_cdc_if.h"
 
 /* USER CODE BEGIN INCLUDE */
+#include "usb_stream.h"
+#include "usb_parsing.h"
 
 /* USER CODE END INCLUDE */
 
@@ -99,6 +101,7 @@ uint8_t UserRxBufferFS[APP_RX_DATA_SIZE];
 uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 
 /* USER CODE BEGIN PRIVATE_VARIABLES */
+static volatile uint8_t RxPaused;	// OUT endpoint not re-armed until the RX buffer drains
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -263,8 +266,19 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
+  uint32_t Stream = 0;
+
+  if(!USB_ParsingRxInLine())	// Binary frames first, unless a command line is in progress
+    Stream = USB_StreamReceive(Buf, *Len);
+
+  if(Stream < *Len)	// Rest of the packet goes to the command parser
+    USB_ParsingReceive(&Buf[Stream], *Len - Stream);
+
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  if(USB_ParsingRxFree() >= CDC_DATA_FS_OUT_PACKET_SIZE)
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  else
+    RxPaused = 1;	// NAK the host until there is room for a full packet
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -295,6 +309,32 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  CDC_ResumeReceive_FS
+  *         Re-arms the OUT endpoint held by CDC_Receive_FS
+  *         once the command buffer has room for a full packet.
+  * @retval None
+  */
+void CDC_ResumeReceive_FS(void)
+{
+  if(RxPaused && USB_ParsingRxFree() >= CDC_DATA_FS_OUT_PACKET_SIZE)
+  {
+    RxPaused = 0;
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  }
+}
+
+/**
+  * @brief  CDC_TransmitBusy_FS
+  *         IN endpoint state for polling from the main loop,
+  *         the bundled CDC class has no transmit complete callback.
+  * @retval 1 while the last CDC_Transmit_FS data is not sent, 0 when idle
+  */
+uint8_t CDC_TransmitBusy_FS(void)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  return (hcdc == NULL) || (hcdc->TxState != 0);
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 